@@ -155,6 +155,13 @@ static gboolean do_eject (Obj * obj, Invoc * invoc)
     return true;
 }
 
+static gboolean do_enable_pipeline_stats (Obj * obj, Invoc * invoc, gboolean enable)
+{
+    aud_set_bool ("pipeline_stats", enable);
+    FINISH (enable_pipeline_stats);
+    return true;
+}
+
 static gboolean do_equalizer_activate (Obj * obj, Invoc * invoc, gboolean active)
 {
     aud_set_bool ("equalizer_active", active);
@@ -294,6 +301,37 @@ static gboolean do_paused (Obj * obj, Invoc * invoc)
     return true;
 }
 
+static GVariant * int64_array (const Index<PipelineStats> & list, int64_t PipelineStats::* field)
+{
+    Index<uint64_t> values;
+    for (const PipelineStats & stats : list)
+        values.append (stats.* field);
+
+    return g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64, values.begin (),
+     values.len (), sizeof (uint64_t));
+}
+
+static gboolean do_pipeline_stats (Obj * obj, Invoc * invoc)
+{
+    auto list = aud_drct_get_pipeline_stats ();
+
+    Index<const char *> stages;
+    for (const PipelineStats & stats : list)
+        stages.append ((const char *) stats.stage);
+
+    stages.append (nullptr);
+
+    FINISH2 (pipeline_stats, stages.begin (),
+     int64_array (list, & PipelineStats::calls),
+     int64_array (list, & PipelineStats::mean_ns),
+     int64_array (list, & PipelineStats::p50_ns),
+     int64_array (list, & PipelineStats::p90_ns),
+     int64_array (list, & PipelineStats::p99_ns),
+     int64_array (list, & PipelineStats::max_ns));
+
+    return true;
+}
+
 static gboolean do_play (Obj * obj, Invoc * invoc)
 {
     aud_drct_play ();
@@ -780,6 +818,7 @@ handlers[] =
     {"handle-delete", (GCallback) do_delete},
     {"handle-delete-active-playlist", (GCallback) do_delete_active_playlist},
     {"handle-eject", (GCallback) do_eject},
+    {"handle-enable-pipeline-stats", (GCallback) do_enable_pipeline_stats},
     {"handle-equalizer-activate", (GCallback) do_equalizer_activate},
     {"handle-get-active-playlist", (GCallback) do_get_active_playlist},
     {"handle-get-active-playlist-name", (GCallback) do_get_active_playlist_name},
@@ -799,6 +838,7 @@ handlers[] =
     {"handle-open-list-to-temp", (GCallback) do_open_list_to_temp},
     {"handle-pause", (GCallback) do_pause},
     {"handle-paused", (GCallback) do_paused},
+    {"handle-pipeline-stats", (GCallback) do_pipeline_stats},
     {"handle-play", (GCallback) do_play},
     {"handle-play-active-playlist", (GCallback) do_play_active_playlist},
     {"handle-play-pause", (GCallback) do_play_pause},
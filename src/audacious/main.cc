@@ -49,12 +49,14 @@ static struct {
     int enqueue, enqueue_to_temp;
     int mainwin, show_jump_box;
     int headless, quit_after_play;
+    int render;
     int verbose;
     int gtk;
 } options;
 
 static bool initted = false;
 static Index<PlaylistAddItem> filenames;
+static String render_file;
 
 static const struct {
     const char * long_arg;
@@ -76,12 +78,23 @@ static const struct {
     {"show-jump-box", 'j', & options.show_jump_box, N_("Display the jump-to-song window")},
     {"headless", 'H', & options.headless, N_("Start without a graphical interface")},
     {"quit-after-play", 'q', & options.quit_after_play, N_("Quit on playback stop")},
+    {"render", 'R', & options.render, N_("Play files offline, as fast as possible")},
     {"verbose", 'V', & options.verbose, N_("Print debugging messages (may be used twice)")},
 #if defined(USE_QT) && defined(USE_GTK)
     {"gtk", 'G', & options.gtk, N_("Run in GTK mode")},
 #endif
 };
 
+static String make_uri (const char * cur, const char * arg)
+{
+    if (strstr (arg, "://"))
+        return String (arg);
+    else if (g_path_is_absolute (arg))
+        return String (filename_to_uri (arg));
+    else
+        return String (filename_to_uri (filename_build ({cur, arg})));
+}
+
 static bool parse_options (int argc, char * * argv)
 {
     CharPtr cur (g_get_current_dir ());
@@ -100,16 +113,7 @@ static bool parse_options (int argc, char * * argv)
 
         if (arg[0] != '-')  /* filename */
         {
-            String uri;
-
-            if (strstr (arg, "://"))
-                uri = String (arg);
-            else if (g_path_is_absolute (arg))
-                uri = String (filename_to_uri (arg));
-            else
-                uri = String (filename_to_uri (filename_build ({cur, arg})));
-
-            filenames.append (uri);
+            filenames.append (make_uri (cur, arg));
         }
         else if (! arg[1])  /* "-" (standard input) */
         {
@@ -119,6 +123,11 @@ static bool parse_options (int argc, char * * argv)
         {
             aud_set_instance (arg[1] - '0');
         }
+        else if (! strncmp (arg, "--render=", 9))  /* render to file */
+        {
+            options.render ++;
+            render_file = make_uri (cur, arg + 9);
+        }
         else if (arg[1] == '-')  /* long option */
         {
             bool found = false;
@@ -164,7 +173,19 @@ static bool parse_options (int argc, char * * argv)
         }
     }
 
+    if (options.render)
+    {
+        /* render the given files (or else the active playlist) and quit */
+        options.headless = true;
+        options.quit_after_play = true;
+        options.play = true;
+
+        if (filenames.len ())
+            options.enqueue_to_temp = true;
+    }
+
     aud_set_headless_mode (options.headless);
+    aud_set_render_mode (options.render, render_file);
 
     if (options.verbose >= 2)
         audlog::set_stderr_level (audlog::Debug);
@@ -183,6 +204,7 @@ static void print_help ()
 
     fprintf (stderr, "%s", _("Usage: audacious [OPTION] ... [FILE] ...\n\n"));
     fprintf (stderr, "  -1, -2, -3, etc.          %s\n", _("Select instance to run/control"));
+    fprintf (stderr, "  --render=FILE             %s\n", _("Play files offline and save the output as WAV"));
 
     for (auto & arg_info : arg_map)
         fprintf (stderr, "  -%c, --%s%.*s%s\n", arg_info.short_arg,
@@ -216,6 +238,13 @@ static void do_remote ()
 
     AUDINFO ("Connected to remote session.\n");
 
+    if (options.render)
+    {
+        AUDERR ("Cannot render while this instance is running.  Select "
+         "another instance (-2, -3, etc.) to render in parallel.\n");
+        exit (EXIT_FAILURE);
+    }
+
     /* if no command line options, then present running instance */
     if (! (filenames.len () || options.play || options.pause ||
      options.play_pause || options.stop || options.rew || options.fwd ||
@@ -268,7 +297,11 @@ static void do_remote ()
 
 static void do_commands ()
 {
-    bool resume = aud_get_bool ("resume_playback_on_startup");
+    bool resume = aud_get_bool ("resume_playback_on_startup") && ! options.render;
+
+    /* render the active playlist from the top */
+    if (options.render && ! filenames.len ())
+        Playlist::active_playlist ().set_position (0);
 
     if (filenames.len ())
     {
@@ -306,6 +339,27 @@ static void do_commands_at_idle (void *)
         aud_ui_show (true);
 }
 
+static void print_render_report ()
+{
+    Index<RenderStats> stats = aud_drct_get_render_stats ();
+    int64_t total_us = 0, wall_us = 0;
+
+    for (const RenderStats & s : stats)
+    {
+        int64_t length_us = aud::rescale<int64_t> (s.frames, s.rate, 1000000);
+
+        printf ("%9.3f s  %8.1fx  %s\n", length_us / 1e6, (double) length_us /
+         aud::max<int64_t> (s.time_us, 1), (const char *) uri_to_display (s.filename));
+
+        total_us += length_us;
+        wall_us = s.start_us + s.time_us;
+    }
+
+    printf (_("%d songs, %.3f s of audio in %.3f s (%.1fx realtime)\n"),
+     stats.len (), total_us / 1e6, wall_us / 1e6,
+     (double) total_us / aud::max<int64_t> (wall_us, 1));
+}
+
 static void main_cleanup ()
 {
     if (initted)
@@ -320,6 +374,7 @@ static void main_cleanup ()
     }
 
     filenames.clear ();
+    render_file = String ();
     aud_leak_check ();
 }
 
@@ -397,6 +452,9 @@ int main (int argc, char * * argv)
         hook_dissociate ("quit", (HookFunction) aud_quit);
     }
 
+    if (options.render)
+        print_render_report ();
+
 #ifdef USE_DBUS
     dbus_server_cleanup ();
 #endif
@@ -133,6 +133,8 @@ void plugin_is_enabled (int argc, char * * argv);
 void plugin_enable (int argc, char * * argv);
 void config_get (int argc, char * * argv);
 void config_set (int argc, char * * argv);
+void pipeline_stats (int argc, char * * argv);
+void pipeline_stats_enable (int argc, char * * argv);
 
 void equalizer_get_eq (int argc, char * * argv);
 void equalizer_get_eq_preamp (int argc, char * * argv);
@@ -198,3 +198,55 @@ void config_set (int argc, char * * argv)
 
     obj_audacious_call_config_set_sync (dbus_proxy, section, name, argv[2], NULL, NULL);
 }
+
+static const guint64 * get_column (GVariant * var, size_t count)
+{
+    size_t len = 0;
+
+    if (! var || ! g_variant_is_of_type (var, G_VARIANT_TYPE ("at")))
+        exit (1);
+
+    const guint64 * values = g_variant_get_fixed_array (var, & len, sizeof (guint64));
+
+    if (len != count)
+        exit (1);
+
+    return values;
+}
+
+void pipeline_stats (int argc, char * * argv)
+{
+    char * * stages = NULL;
+    GVariant * vars[6] = {NULL};
+
+    obj_audacious_call_pipeline_stats_sync (dbus_proxy, & stages, & vars[0],
+     & vars[1], & vars[2], & vars[3], & vars[4], & vars[5], NULL, NULL);
+
+    if (! stages)
+        exit (1);
+
+    size_t count = g_strv_length (stages);
+    const guint64 * columns[6];
+
+    for (int i = 0; i < 6; i ++)
+        columns[i] = get_column (vars[i], count);
+
+    /* times are shown in microseconds */
+    audtool_report ("%-32s %10s %10s %10s %10s %10s %10s", "stage", "calls",
+     "mean", "p50", "p90", "p99", "max");
+
+    for (size_t s = 0; s < count; s ++)
+        audtool_report ("%-32s %10" G_GUINT64_FORMAT " %10.1f %10.1f %10.1f %10.1f %10.1f",
+         stages[s], columns[0][s], columns[1][s] / 1000.0, columns[2][s] / 1000.0,
+         columns[3][s] / 1000.0, columns[4][s] / 1000.0, columns[5][s] / 1000.0);
+
+    for (int i = 0; i < 6; i ++)
+        g_variant_unref (vars[i]);
+
+    g_strfreev (stages);
+}
+
+void pipeline_stats_enable (int argc, char * * argv)
+{
+    generic_on_off (argc, argv, obj_audacious_call_enable_pipeline_stats_sync);
+}
@@ -136,6 +136,8 @@ const struct commandhandler handlers[] =
     {"plugin-enable", plugin_enable, "enable/disable plugin", 2},
     {"config-get", config_get, "DO NOT USE", 1},
     {"config-set", config_set, "DO NOT USE", 2},
+    {"pipeline-stats", pipeline_stats, "print time per call of each audio stage", 0},
+    {"pipeline-stats-enable", pipeline_stats_enable, "start/stop timing audio stages", 1},
     {"shutdown", shutdown_audacious_server, "shut down Audacious", 0},
 
     {"help", get_handlers_list, "print this help", 0},
@@ -187,6 +187,21 @@ void art_cache_current (const String & filename, Index<char> && data, String &&
     current_item = item;
 }
 
+/* like art_cache_current(), but loads the album art in the background */
+void art_request_current (const String & filename)
+{
+    auto mh = mutex.take ();
+    clear_current (mh);
+
+    /* takes a reference if already loaded, otherwise starts loading */
+    AudArtItem * item = art_item_get (mh, filename, nullptr);
+
+    if (! item && (item = art_items.lookup (filename)))
+        item->refcount ++;
+
+    current_item = item;
+}
+
 void art_clear_current ()
 {
     auto mh = mutex.take ();
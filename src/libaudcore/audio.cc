@@ -20,11 +20,21 @@
 #include <fenv.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 
 #define WANT_AUD_BSWAP
 #include "audio.h"
+#include "internal.h"
 #include "objects.h"
 
+#if ! defined (WORDS_BIGENDIAN) && (defined (__x86_64__) || defined (__i386__))
+#define USE_SIMD_X86
+#include <immintrin.h>
+#elif ! defined (WORDS_BIGENDIAN) && defined (__aarch64__)
+#define USE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 #define SW_VOLUME_RANGE 40 /* decibels */
 
 struct packed24_t { uint8_t b[3]; };
@@ -250,12 +260,647 @@ void to_int_loop (const float * in, void * out_, int samples)
     while (in < end)
     {
         float f = (* in ++) * neg_range (format);
+        /* NaN comes out as the negative limit; the SIMD kernels agree */
         f = aud::clamp (f, -(float) neg_range (format), (float) pos_range (format));
         * out ++ = Convert<format, Word, Int>::to_word (lrintf (f));
     }
 }
 
-EXPORT void audio_from_int (const void * in, int format, float * out, int samples)
+/* The SIMD kernels below handle every integer format in terms of a common
+ * layout: each sample is a container of 1, 2, 3, or 4 bytes, possibly
+ * byte-swapped, whose sign bit is inverted for unsigned formats and which is
+ * then sign-extended from its significant bits.  They produce output identical
+ * to the scalar loops above, which process whatever samples are left over. */
+
+struct IntLayout
+{
+    int bytes;      /* container size, 0 if not an integer format */
+    bool swap;      /* big-endian (SIMD code is only used on little-endian) */
+    int bits;       /* significant bits */
+    unsigned flip;  /* sign bit to invert (for unsigned formats) */
+    float neg, pos; /* range for conversion and clipping */
+};
+
+static IntLayout get_layout (int format)
+{
+    if (format < FMT_S8 || format > FMT_U24_3BE)
+        return IntLayout ();
+
+    int bytes = FMT_SIZEOF (format);
+    bool padded = (format >= FMT_S24_LE && format <= FMT_U24_BE);
+
+    return {
+        bytes,
+        bytes > 1 && ! is_le (format),
+        padded ? 24 : 8 * bytes,
+        is_signed (format) ? 0 : neg_range (format),
+        (float) neg_range (format),
+        (float) pos_range (format)
+    };
+}
+
+typedef int (* FromIntFunc) (const IntLayout & l, const void * in, float * out, int samples);
+typedef int (* ToIntFunc) (const IntLayout & l, const float * in, void * out, int samples);
+
+#ifdef USE_SIMD_X86
+
+#define TARGET_SSE2 __attribute__ ((target ("sse2")))
+#define TARGET_AVX2 __attribute__ ((target ("avx2")))
+
+TARGET_SSE2 static inline __m128i bswap16_sse2 (__m128i v)
+    { return _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8)); }
+
+TARGET_SSE2 static inline __m128i bswap32_sse2 (__m128i v)
+{
+    v = bswap16_sse2 (v);
+    return _mm_or_si128 (_mm_slli_epi32 (v, 16), _mm_srli_epi32 (v, 16));
+}
+
+TARGET_SSE2 static inline void store_float_sse2 (float * out, __m128i v, __m128 scale)
+    { _mm_storeu_ps (out, _mm_mul_ps (_mm_cvtepi32_ps (v), scale)); }
+
+/* relies on the MXCSR rounding mode being set to nearest */
+TARGET_SSE2 static inline __m128i load_int_sse2 (const float * in,
+ __m128 scale, __m128 low, __m128 high)
+{
+    __m128 f = _mm_mul_ps (_mm_loadu_ps (in), scale);
+    return _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (f, low), high));
+}
+
+TARGET_SSE2 static int from_int_sse2 (const IntLayout & l, const void * in_, float * out, int samples)
+{
+    auto in = (const char *) in_;
+    __m128 scale = _mm_set1_ps (1.0f / l.neg);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        __m128i flip = _mm_set1_epi8 ((char) l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m128i v = _mm_loadu_si128 ((const __m128i *) (in + i));
+            v = _mm_xor_si128 (v, flip);
+
+            __m128i lo = _mm_unpacklo_epi8 (v, v);
+            __m128i hi = _mm_unpackhi_epi8 (v, v);
+
+            store_float_sse2 (out + i, _mm_srai_epi32 (_mm_unpacklo_epi16 (lo, lo), 24), scale);
+            store_float_sse2 (out + i + 4, _mm_srai_epi32 (_mm_unpackhi_epi16 (lo, lo), 24), scale);
+            store_float_sse2 (out + i + 8, _mm_srai_epi32 (_mm_unpacklo_epi16 (hi, hi), 24), scale);
+            store_float_sse2 (out + i + 12, _mm_srai_epi32 (_mm_unpackhi_epi16 (hi, hi), 24), scale);
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        __m128i flip = _mm_set1_epi16 ((short) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i v = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+            if (l.swap)
+                v = bswap16_sse2 (v);
+            v = _mm_xor_si128 (v, flip);
+
+            store_float_sse2 (out + i, _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16), scale);
+            store_float_sse2 (out + i + 4, _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16), scale);
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        __m128i flip = _mm_set1_epi32 (l.flip);
+        __m128i shift = _mm_cvtsi32_si128 (32 - l.bits);
+
+        for (; i + 4 <= samples; i += 4)
+        {
+            __m128i v = _mm_loadu_si128 ((const __m128i *) (in + 4 * i));
+            if (l.swap)
+                v = bswap32_sse2 (v);
+            v = _mm_xor_si128 (v, flip);
+            v = _mm_sra_epi32 (_mm_sll_epi32 (v, shift), shift);
+
+            store_float_sse2 (out + i, v, scale);
+        }
+    }
+
+    /* packed 24-bit formats need SSSE3 shuffles; leave them to the scalar code */
+    return i;
+}
+
+TARGET_SSE2 static int to_int_sse2 (const IntLayout & l, const float * in, void * out_, int samples)
+{
+    auto out = (char *) out_;
+    __m128 scale = _mm_set1_ps (l.neg);
+    __m128 low = _mm_set1_ps (-l.neg);
+    __m128 high = _mm_set1_ps (l.pos);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        __m128i flip = _mm_set1_epi8 ((char) l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m128i a = load_int_sse2 (in + i, scale, low, high);
+            __m128i b = load_int_sse2 (in + i + 4, scale, low, high);
+            __m128i c = load_int_sse2 (in + i + 8, scale, low, high);
+            __m128i d = load_int_sse2 (in + i + 12, scale, low, high);
+
+            /* values are already in range, so saturation is a no-op */
+            __m128i v = _mm_packs_epi16 (_mm_packs_epi32 (a, b), _mm_packs_epi32 (c, d));
+            v = _mm_xor_si128 (v, flip);
+
+            _mm_storeu_si128 ((__m128i *) (out + i), v);
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        __m128i flip = _mm_set1_epi16 ((short) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i a = load_int_sse2 (in + i, scale, low, high);
+            __m128i b = load_int_sse2 (in + i + 4, scale, low, high);
+
+            __m128i v = _mm_xor_si128 (_mm_packs_epi32 (a, b), flip);
+            if (l.swap)
+                v = bswap16_sse2 (v);
+
+            _mm_storeu_si128 ((__m128i *) (out + 2 * i), v);
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        __m128i flip = _mm_set1_epi32 (l.flip);
+        __m128i mask = _mm_set1_epi32 ((l.bits == 24) ? 0xffffff : -1);
+
+        for (; i + 4 <= samples; i += 4)
+        {
+            __m128i v = load_int_sse2 (in + i, scale, low, high);
+            v = _mm_and_si128 (_mm_xor_si128 (v, flip), mask);
+            if (l.swap)
+                v = bswap32_sse2 (v);
+
+            _mm_storeu_si128 ((__m128i *) (out + 4 * i), v);
+        }
+    }
+
+    return i;
+}
+
+TARGET_AVX2 static inline void store_float_avx2 (float * out, __m256i v, __m256 scale)
+    { _mm256_storeu_ps (out, _mm256_mul_ps (_mm256_cvtepi32_ps (v), scale)); }
+
+TARGET_AVX2 static inline __m256i load_int_avx2 (const float * in,
+ __m256 scale, __m256 low, __m256 high)
+{
+    __m256 f = _mm256_mul_ps (_mm256_loadu_ps (in), scale);
+    f = _mm256_min_ps (_mm256_max_ps (f, low), high);
+    return _mm256_cvtps_epi32 (_mm256_round_ps (f, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+
+TARGET_AVX2 static inline __m256i load_2x128_avx2 (const char * lo, const char * hi)
+{
+    __m256i v = _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) lo));
+    return _mm256_inserti128_si256 (v, _mm_loadu_si128 ((const __m128i *) hi), 1);
+}
+
+TARGET_AVX2 static inline void store_12_avx2 (char * out, __m128i v)
+{
+    _mm_storel_epi64 ((__m128i *) out, v);
+    int32_t last = _mm_cvtsi128_si32 (_mm_srli_si128 (v, 8));
+    memcpy (out + 8, & last, 4);
+}
+
+TARGET_AVX2 static int from_int_avx2 (const IntLayout & l, const void * in_, float * out, int samples)
+{
+    auto in = (const char *) in_;
+    __m256 scale = _mm256_set1_ps (1.0f / l.neg);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        __m128i flip = _mm_set1_epi8 ((char) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i v = _mm_loadl_epi64 ((const __m128i *) (in + i));
+            v = _mm_xor_si128 (v, flip);
+
+            store_float_avx2 (out + i, _mm256_cvtepi8_epi32 (v), scale);
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        __m128i flip = _mm_set1_epi16 ((short) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m128i v = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+            if (l.swap)
+                v = bswap16_sse2 (v);
+            v = _mm_xor_si128 (v, flip);
+
+            store_float_avx2 (out + i, _mm256_cvtepi16_epi32 (v), scale);
+        }
+    }
+    else if (l.bytes == 3)
+    {
+        /* move each sample into the upper 3 bytes of a 32-bit lane, then
+         * sign-extend with an arithmetic shift */
+        __m256i shuffle = l.swap ?
+         _mm256_setr_epi8 (-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+                           -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9) :
+         _mm256_setr_epi8 (-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                           -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        __m256i flip = _mm256_set1_epi32 (l.flip << 8);
+
+        /* each iteration reads 4 bytes past the 8 samples it converts */
+        for (; i + 10 <= samples; i += 8)
+        {
+            __m256i v = load_2x128_avx2 (in + 3 * i, in + 3 * i + 12);
+            v = _mm256_xor_si256 (_mm256_shuffle_epi8 (v, shuffle), flip);
+
+            store_float_avx2 (out + i, _mm256_srai_epi32 (v, 8), scale);
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        __m256i swap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        __m256i flip = _mm256_set1_epi32 (l.flip);
+        __m128i shift = _mm_cvtsi32_si128 (32 - l.bits);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + 4 * i));
+            if (l.swap)
+                v = _mm256_shuffle_epi8 (v, swap);
+            v = _mm256_xor_si256 (v, flip);
+            v = _mm256_sra_epi32 (_mm256_sll_epi32 (v, shift), shift);
+
+            store_float_avx2 (out + i, v, scale);
+        }
+    }
+
+    return i;
+}
+
+TARGET_AVX2 static int to_int_avx2 (const IntLayout & l, const float * in, void * out_, int samples)
+{
+    auto out = (char *) out_;
+    __m256 scale = _mm256_set1_ps (l.neg);
+    __m256 low = _mm256_set1_ps (-l.neg);
+    __m256 high = _mm256_set1_ps (l.pos);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        __m256i order = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+        __m256i flip = _mm256_set1_epi8 ((char) l.flip);
+
+        for (; i + 32 <= samples; i += 32)
+        {
+            __m256i a = load_int_avx2 (in + i, scale, low, high);
+            __m256i b = load_int_avx2 (in + i + 8, scale, low, high);
+            __m256i c = load_int_avx2 (in + i + 16, scale, low, high);
+            __m256i d = load_int_avx2 (in + i + 24, scale, low, high);
+
+            /* packing works within 128-bit lanes; restore sample order after */
+            __m256i v = _mm256_packs_epi16 (_mm256_packs_epi32 (a, b), _mm256_packs_epi32 (c, d));
+            v = _mm256_permutevar8x32_epi32 (v, order);
+            v = _mm256_xor_si256 (v, flip);
+
+            _mm256_storeu_si256 ((__m256i *) (out + i), v);
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        __m256i flip = _mm256_set1_epi16 ((short) l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            __m256i a = load_int_avx2 (in + i, scale, low, high);
+            __m256i b = load_int_avx2 (in + i + 8, scale, low, high);
+
+            __m256i v = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a, b), 0xd8);
+            v = _mm256_xor_si256 (v, flip);
+            if (l.swap)
+                v = _mm256_or_si256 (_mm256_slli_epi16 (v, 8), _mm256_srli_epi16 (v, 8));
+
+            _mm256_storeu_si256 ((__m256i *) (out + 2 * i), v);
+        }
+    }
+    else if (l.bytes == 3)
+    {
+        __m256i shuffle = l.swap ?
+         _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+         _mm256_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i flip = _mm256_set1_epi32 (l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m256i v = load_int_avx2 (in + i, scale, low, high);
+            v = _mm256_shuffle_epi8 (_mm256_xor_si256 (v, flip), shuffle);
+
+            store_12_avx2 (out + 3 * i, _mm256_castsi256_si128 (v));
+            store_12_avx2 (out + 3 * i + 12, _mm256_extracti128_si256 (v, 1));
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        __m256i swap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        __m256i flip = _mm256_set1_epi32 (l.flip);
+        __m256i mask = _mm256_set1_epi32 ((l.bits == 24) ? 0xffffff : -1);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            __m256i v = load_int_avx2 (in + i, scale, low, high);
+            v = _mm256_and_si256 (_mm256_xor_si256 (v, flip), mask);
+            if (l.swap)
+                v = _mm256_shuffle_epi8 (v, swap);
+
+            _mm256_storeu_si256 ((__m256i *) (out + 4 * i), v);
+        }
+    }
+
+    return i;
+}
+
+#endif // USE_SIMD_X86
+
+#ifdef USE_SIMD_NEON
+
+static inline void store_float_neon (float * out, int32x4_t v, float32x4_t scale)
+    { vst1q_f32 (out, vmulq_f32 (vcvtq_f32_s32 (v), scale)); }
+
+/* a NaN sample comes out as the negative limit, as in the scalar loop, where
+ * aud::clamp() gives <low> since (NaN > low) is false; vmaxnmq_f32() returns
+ * the operand that is not NaN, and plain vmaxq_f32() would not */
+static inline int32x4_t load_int_neon (const float * in,
+ float32x4_t scale, float32x4_t low, float32x4_t high)
+{
+    float32x4_t f = vmulq_f32 (vld1q_f32 (in), scale);
+    return vcvtnq_s32_f32 (vminnmq_f32 (vmaxnmq_f32 (f, low), high));
+}
+
+static inline int16x8_t narrow_neon (int32x4_t a, int32x4_t b)
+    { return vcombine_s16 (vqmovn_s32 (a), vqmovn_s32 (b)); }
+
+template<int shift>
+static inline uint8x8_t bytes_neon (uint32x4_t a, uint32x4_t b)
+    { return vmovn_u16 (vcombine_u16 (vshrn_n_u32 (a, shift), vshrn_n_u32 (b, shift))); }
+
+template<>
+inline uint8x8_t bytes_neon<0> (uint32x4_t a, uint32x4_t b)
+    { return vmovn_u16 (vcombine_u16 (vmovn_u32 (a), vmovn_u32 (b))); }
+
+template<int shift>
+static inline uint8x16_t bytes_neon (const uint32x4_t v[4])
+    { return vcombine_u8 (bytes_neon<shift> (v[0], v[1]), bytes_neon<shift> (v[2], v[3])); }
+
+static int from_int_neon (const IntLayout & l, const void * in_, float * out, int samples)
+{
+    auto in = (const char *) in_;
+    float32x4_t scale = vdupq_n_f32 (1.0f / l.neg);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        int8x16_t flip = vdupq_n_s8 ((int8_t) l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            int8x16_t v = veorq_s8 (vld1q_s8 ((const int8_t *) (in + i)), flip);
+            int16x8_t lo = vmovl_s8 (vget_low_s8 (v));
+            int16x8_t hi = vmovl_s8 (vget_high_s8 (v));
+
+            store_float_neon (out + i, vmovl_s16 (vget_low_s16 (lo)), scale);
+            store_float_neon (out + i + 4, vmovl_s16 (vget_high_s16 (lo)), scale);
+            store_float_neon (out + i + 8, vmovl_s16 (vget_low_s16 (hi)), scale);
+            store_float_neon (out + i + 12, vmovl_s16 (vget_high_s16 (hi)), scale);
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        int16x8_t flip = vdupq_n_s16 ((int16_t) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            int16x8_t v = vld1q_s16 ((const int16_t *) (in + 2 * i));
+            if (l.swap)
+                v = vreinterpretq_s16_u8 (vrev16q_u8 (vreinterpretq_u8_s16 (v)));
+            v = veorq_s16 (v, flip);
+
+            store_float_neon (out + i, vmovl_s16 (vget_low_s16 (v)), scale);
+            store_float_neon (out + i + 4, vmovl_s16 (vget_high_s16 (v)), scale);
+        }
+    }
+    else if (l.bytes == 3)
+    {
+        uint8x16_t flip = vdupq_n_u8 ((uint8_t) (l.flip >> 16));
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            uint8x16x3_t b = vld3q_u8 ((const uint8_t *) (in + 3 * i));
+            uint8x16_t lo = l.swap ? b.val[2] : b.val[0];
+            uint8x16_t hi = veorq_u8 (l.swap ? b.val[0] : b.val[2], flip);
+
+            /* interleave (lo, mid) pairs with the sign-extended high byte */
+            uint8x16x2_t lm = vzipq_u8 (lo, b.val[1]);
+            int8x16_t hs = vreinterpretq_s8_u8 (hi);
+            int16x8x2_t z0 = vzipq_s16 (vreinterpretq_s16_u8 (lm.val[0]), vmovl_s8 (vget_low_s8 (hs)));
+            int16x8x2_t z1 = vzipq_s16 (vreinterpretq_s16_u8 (lm.val[1]), vmovl_s8 (vget_high_s8 (hs)));
+
+            store_float_neon (out + i, vreinterpretq_s32_s16 (z0.val[0]), scale);
+            store_float_neon (out + i + 4, vreinterpretq_s32_s16 (z0.val[1]), scale);
+            store_float_neon (out + i + 8, vreinterpretq_s32_s16 (z1.val[0]), scale);
+            store_float_neon (out + i + 12, vreinterpretq_s32_s16 (z1.val[1]), scale);
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        int32x4_t flip = vdupq_n_s32 (l.flip);
+        int32x4_t shl = vdupq_n_s32 (32 - l.bits);
+        int32x4_t shr = vdupq_n_s32 (l.bits - 32);
+
+        for (; i + 4 <= samples; i += 4)
+        {
+            int32x4_t v = vld1q_s32 ((const int32_t *) (in + 4 * i));
+            if (l.swap)
+                v = vreinterpretq_s32_u8 (vrev32q_u8 (vreinterpretq_u8_s32 (v)));
+            v = veorq_s32 (v, flip);
+            v = vshlq_s32 (vshlq_s32 (v, shl), shr);
+
+            store_float_neon (out + i, v, scale);
+        }
+    }
+
+    return i;
+}
+
+static int to_int_neon (const IntLayout & l, const float * in, void * out_, int samples)
+{
+    auto out = (char *) out_;
+    float32x4_t scale = vdupq_n_f32 (l.neg);
+    float32x4_t low = vdupq_n_f32 (-l.neg);
+    float32x4_t high = vdupq_n_f32 (l.pos);
+    int i = 0;
+
+    if (l.bytes == 1)
+    {
+        int8x16_t flip = vdupq_n_s8 ((int8_t) l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            int16x8_t ab = narrow_neon (load_int_neon (in + i, scale, low, high),
+                                        load_int_neon (in + i + 4, scale, low, high));
+            int16x8_t cd = narrow_neon (load_int_neon (in + i + 8, scale, low, high),
+                                        load_int_neon (in + i + 12, scale, low, high));
+
+            int8x16_t v = vcombine_s8 (vqmovn_s16 (ab), vqmovn_s16 (cd));
+            vst1q_s8 ((int8_t *) (out + i), veorq_s8 (v, flip));
+        }
+    }
+    else if (l.bytes == 2)
+    {
+        int16x8_t flip = vdupq_n_s16 ((int16_t) l.flip);
+
+        for (; i + 8 <= samples; i += 8)
+        {
+            int16x8_t v = narrow_neon (load_int_neon (in + i, scale, low, high),
+                                       load_int_neon (in + i + 4, scale, low, high));
+            v = veorq_s16 (v, flip);
+            if (l.swap)
+                v = vreinterpretq_s16_u8 (vrev16q_u8 (vreinterpretq_u8_s16 (v)));
+
+            vst1q_s16 ((int16_t *) (out + 2 * i), v);
+        }
+    }
+    else if (l.bytes == 3)
+    {
+        int32x4_t flip = vdupq_n_s32 (l.flip);
+
+        for (; i + 16 <= samples; i += 16)
+        {
+            uint32x4_t v[4];
+            for (int j = 0; j < 4; j ++)
+                v[j] = vreinterpretq_u32_s32 (veorq_s32 (load_int_neon
+                 (in + i + 4 * j, scale, low, high), flip));
+
+            uint8x16_t lo = bytes_neon<0> (v);
+            uint8x16_t hi = bytes_neon<16> (v);
+
+            uint8x16x3_t b;
+            b.val[0] = l.swap ? hi : lo;
+            b.val[1] = bytes_neon<8> (v);
+            b.val[2] = l.swap ? lo : hi;
+
+            vst3q_u8 ((uint8_t *) (out + 3 * i), b);
+        }
+    }
+    else if (l.bytes == 4)
+    {
+        int32x4_t flip = vdupq_n_s32 (l.flip);
+        int32x4_t mask = vdupq_n_s32 ((l.bits == 24) ? 0xffffff : -1);
+
+        for (; i + 4 <= samples; i += 4)
+        {
+            int32x4_t v = load_int_neon (in + i, scale, low, high);
+            v = vandq_s32 (veorq_s32 (v, flip), mask);
+            if (l.swap)
+                v = vreinterpretq_s32_u8 (vrev32q_u8 (vreinterpretq_u8_s32 (v)));
+
+            vst1q_s32 ((int32_t *) (out + 4 * i), v);
+        }
+    }
+
+    return i;
+}
+
+#endif // USE_SIMD_NEON
+
+static AudioSIMD simd_level = AudioSIMD::None;
+static FromIntFunc simd_from_int = nullptr;
+static ToIntFunc simd_to_int = nullptr;
+
+static bool simd_supported (AudioSIMD level)
+{
+    switch (level)
+    {
+    case AudioSIMD::None:
+        return true;
+#ifdef USE_SIMD_X86
+    case AudioSIMD::SSE2:
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("sse2");
+    case AudioSIMD::AVX2:
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("avx2");
+#endif
+#ifdef USE_SIMD_NEON
+    case AudioSIMD::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool audio_simd_select (AudioSIMD level)
+{
+    if (! simd_supported (level))
+        return false;
+
+    switch (level)
+    {
+#ifdef USE_SIMD_X86
+    case AudioSIMD::SSE2:
+        simd_from_int = from_int_sse2;
+        simd_to_int = to_int_sse2;
+        break;
+    case AudioSIMD::AVX2:
+        simd_from_int = from_int_avx2;
+        simd_to_int = to_int_avx2;
+        break;
+#endif
+#ifdef USE_SIMD_NEON
+    case AudioSIMD::NEON:
+        simd_from_int = from_int_neon;
+        simd_to_int = to_int_neon;
+        break;
+#endif
+    default:
+        simd_from_int = nullptr;
+        simd_to_int = nullptr;
+        break;
+    }
+
+    simd_level = level;
+    return true;
+}
+
+AudioSIMD audio_simd_get ()
+{
+    return simd_level;
+}
+
+/* pick the best available kernels once, at library load time */
+static bool simd_init = [] ()
+{
+    for (AudioSIMD level : {AudioSIMD::AVX2, AudioSIMD::NEON, AudioSIMD::SSE2})
+    {
+        if (audio_simd_select (level))
+            return true;
+    }
+
+    return false;
+} ();
+
+static void from_int_scalar (const void * in, int format, float * out, int samples)
 {
     switch (format)
     {
@@ -284,11 +929,22 @@ EXPORT void audio_from_int (const void * in, int format, float * out, int sample
     }
 }
 
-EXPORT void audio_to_int (const float * in, void * out, int format, int samples)
+EXPORT void audio_from_int (const void * in, int format, float * out, int samples)
 {
-    int save = fegetround ();
-    fesetround (FE_TONEAREST);
+    if (simd_from_int)
+    {
+        int done = simd_from_int (get_layout (format), in, out, samples);
+
+        in = (const char *) in + FMT_SIZEOF (format) * done;
+        out += done;
+        samples -= done;
+    }
+
+    from_int_scalar (in, format, out, samples);
+}
 
+static void to_int_scalar (const float * in, void * out, int format, int samples)
+{
     switch (format)
     {
         case FMT_S8: to_int_loop<FMT_S8, int8_t> (in, out, samples); break;
@@ -314,8 +970,28 @@ EXPORT void audio_to_int (const float * in, void * out, int format, int samples)
         case FMT_U24_3LE: to_int_loop<FMT_U24_3LE, packed24_t, int32_t> (in, out, samples); break;
         case FMT_U24_3BE: to_int_loop<FMT_U24_3BE, packed24_t, int32_t> (in, out, samples); break;
     }
+}
+
+EXPORT void audio_to_int (const float * in, void * out, int format, int samples)
+{
+    /* changing the rounding mode is expensive, so avoid it if possible */
+    int save = fegetround ();
+    if (save != FE_TONEAREST)
+        fesetround (FE_TONEAREST);
+
+    if (simd_to_int)
+    {
+        int done = simd_to_int (get_layout (format), in, out, samples);
+
+        in += done;
+        out = (char *) out + FMT_SIZEOF (format) * done;
+        samples -= done;
+    }
+
+    to_int_scalar (in, out, format, samples);
 
-    fesetround (save);
+    if (save != FE_TONEAREST)
+        fesetround (save);
 }
 
 EXPORT void audio_amplify (float * data, int channels, int frames, const float * factors)
@@ -333,16 +1009,13 @@ EXPORT void audio_amplify (float * data, int channels, int frames, const float *
     }
 }
 
-EXPORT void audio_amplify (float * data, int channels, int frames, StereoVolume volume)
+/* returns false if the volume is 100% (no change needed) */
+bool audio_volume_factors (StereoVolume volume, int channels, float * factors)
 {
-    if (channels < 1 || channels > AUD_MAX_CHANNELS)
-        return;
-
     if (volume.left == 100 && volume.right == 100)
-        return;
+        return false;
 
     float lfactor = 0, rfactor = 0;
-    float factors[AUD_MAX_CHANNELS];
 
     if (volume.left > 0)
         lfactor = powf (10, (float) SW_VOLUME_RANGE * (volume.left - 100) / 100 / 20);
@@ -360,7 +1033,17 @@ EXPORT void audio_amplify (float * data, int channels, int frames, StereoVolume
             factors[c] = aud::max (lfactor, rfactor);
     }
 
-    audio_amplify (data, channels, frames, factors);
+    return true;
+}
+
+EXPORT void audio_amplify (float * data, int channels, int frames, StereoVolume volume)
+{
+    if (channels < 1 || channels > AUD_MAX_CHANNELS)
+        return;
+
+    float factors[AUD_MAX_CHANNELS];
+    if (audio_volume_factors (volume, channels, factors))
+        audio_amplify (data, channels, frames, factors);
 }
 
 /* linear approximation of y = sin(x) */
@@ -390,3 +1073,57 @@ EXPORT void audio_soft_clip (float * data, int samples)
         * data ++ = (x > 0) ? y : -y;
     }
 }
+
+/* Applies per-channel gain (if <factors> is non-null) and soft clipping (if
+ * requested) and converts to <format>, which may be FMT_FLOAT.  The work is
+ * done in small blocks, so that the data passes through memory only once.
+ * <in> and <out> may be the same buffer. */
+void audio_amplify_convert (const float * in, void * out, int format,
+ int channels, int frames, const float * factors, bool soft_clip)
+{
+    constexpr int block_size = 1024;
+
+    float block[block_size];
+    float pattern[block_size];
+
+    int samples = channels * frames;
+    int step = block_size - block_size % channels;
+
+    /* repeat the factors so that the inner loop is a plain multiply */
+    if (factors)
+    {
+        int len = aud::min (step, samples);
+
+        for (int i = 0; i < aud::min (channels, len); i ++)
+            pattern[i] = factors[i];
+        for (int i = channels; i < len; i ++)
+            pattern[i] = pattern[i - channels];
+    }
+
+    int size = FMT_SIZEOF (format);
+    auto set = (char *) out;
+
+    for (int at = 0; at < samples; at += step)
+    {
+        int len = aud::min (step, samples - at);
+
+        /* floating point output needs no block of its own */
+        float * work = (format == FMT_FLOAT) ? (float *) set : block;
+
+        if (factors)
+        {
+            for (int i = 0; i < len; i ++)
+                work[i] = in[at + i] * pattern[i];
+        }
+        else if (work != in + at)
+            memmove (work, in + at, sizeof (float) * len);
+
+        if (soft_clip)
+            audio_soft_clip (work, len);
+
+        if (format != FMT_FLOAT)
+            audio_to_int (block, set, format, len);
+
+        set += size * len;
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ * bit-index.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "bit-index.h"
+
+#include <assert.h>
+
+static int n_words (int len)
+    { return (len + 63) >> 6; }
+
+static uint64_t low_mask (int len)
+    { return (len < 64) ? ((uint64_t) 1 << len) - 1 : ~(uint64_t) 0; }
+
+/* reads up to 64 bits starting at any position */
+uint64_t BitIndex::read_bits (int pos, int len) const
+{
+    int w = pos >> 6, shift = pos & 63;
+    uint64_t bits = m_words[w] >> shift;
+
+    if (shift && shift + len > 64)
+        bits |= m_words[w + 1] << (64 - shift);
+
+    return bits & low_mask (len);
+}
+
+void BitIndex::write_bits (int pos, uint64_t bits, int len)
+{
+    int w = pos >> 6, shift = pos & 63;
+    uint64_t mask = low_mask (len);
+
+    bits &= mask;
+    m_words[w] = (m_words[w] & ~(mask << shift)) | (bits << shift);
+
+    if (shift && shift + len > 64)
+        m_words[w + 1] = (m_words[w + 1] & ~(mask >> (64 - shift))) | (bits >> (64 - shift));
+}
+
+/* like memmove(), the ranges may overlap */
+void BitIndex::move_bits (int to, int from, int len)
+{
+    if (to < from)
+    {
+        for (int done = 0; done < len; done += 64)
+        {
+            int chunk = aud::min (len - done, 64);
+            write_bits (to + done, read_bits (from + done, chunk), chunk);
+        }
+    }
+    else if (to > from)
+    {
+        for (int left = len; left > 0; )
+        {
+            int chunk = aud::min (left, 64);
+            left -= chunk;
+            write_bits (to + left, read_bits (from + left, chunk), chunk);
+        }
+    }
+}
+
+void BitIndex::clear_tail ()
+{
+    if (m_len & 63)
+        m_words[m_len >> 6] &= low_mask (m_len & 63);
+}
+
+void BitIndex::insert (int pos, int len)
+{
+    assert (pos >= 0 && pos <= m_len && len >= 0);
+
+    int old_len = m_len;
+    m_len += len;
+
+    int add = n_words (m_len) - m_words.len ();
+    if (add > 0)
+        m_words.insert (-1, add);
+
+    move_bits (pos + len, pos, old_len - pos);
+
+    for (int done = 0; done < len; done += 64)
+        write_bits (pos + done, 0, aud::min (len - done, 64));
+}
+
+void BitIndex::remove (int pos, int len)
+{
+    assert (pos >= 0 && len >= 0 && pos + len <= m_len);
+
+    move_bits (pos, pos + len, m_len - pos - len);
+
+    m_len -= len;
+    m_words.remove (n_words (m_len), -1);
+    clear_tail ();
+}
+
+void BitIndex::clear ()
+{
+    m_words.clear ();
+    m_len = 0;
+}
+
+void BitIndex::fill (bool value)
+{
+    for (uint64_t & word : m_words)
+        word = value ? ~(uint64_t) 0 : 0;
+
+    clear_tail ();
+}
+
+void BitIndex::invert ()
+{
+    for (uint64_t & word : m_words)
+        word = ~word;
+
+    clear_tail ();
+}
+
+int BitIndex::count (int pos, int len) const
+{
+    assert (pos >= 0 && len >= 0 && pos + len <= m_len);
+
+    if (! len)
+        return 0;
+
+    int first = pos >> 6, last = (pos + len - 1) >> 6;
+    int count = 0;
+
+    for (int w = first; w <= last; w ++)
+    {
+        uint64_t word = m_words[w];
+
+        if (w == first)
+            word &= ~low_mask (pos & 63);
+        if (w == last)
+            word &= low_mask (((pos + len - 1) & 63) + 1);
+
+        count += __builtin_popcountll (word);
+    }
+
+    return count;
+}
+
+/* a word is searched for set bits; for clear bits, it is inverted first */
+int BitIndex::find_next (bool value, int pos) const
+{
+    if (pos < 0)
+        pos = 0;
+    if (pos >= m_len)
+        return -1;
+
+    uint64_t flip = value ? 0 : ~(uint64_t) 0;
+    int w = pos >> 6;
+    uint64_t word = (m_words[w] ^ flip) & ~low_mask (pos & 63);
+
+    while (! word)
+    {
+        if (++ w == m_words.len ())
+            return -1;
+
+        word = m_words[w] ^ flip;
+    }
+
+    int found = (w << 6) + __builtin_ctzll (word);
+    return (found < m_len) ? found : -1;
+}
+
+int BitIndex::find_prev (bool value, int pos) const
+{
+    if (pos >= m_len)
+        pos = m_len - 1;
+    if (pos < 0)
+        return -1;
+
+    uint64_t flip = value ? 0 : ~(uint64_t) 0;
+    int w = pos >> 6;
+    uint64_t word = (m_words[w] ^ flip) & low_mask ((pos & 63) + 1);
+
+    while (! word)
+    {
+        if (w -- == 0)
+            return -1;
+
+        word = m_words[w] ^ flip;
+    }
+
+    return (w << 6) + 63 - __builtin_clzll (word);
+}
+
+void BitIndex::reorder (int pos, const Index<int> & order)
+{
+    assert (pos >= 0 && pos + order.len () <= m_len);
+
+    int len = order.len ();
+
+    BitIndex old;
+    old.insert (0, len);
+
+    for (int done = 0; done < len; done += 64)
+    {
+        int chunk = aud::min (len - done, 64);
+        old.write_bits (done, read_bits (pos + done, chunk), chunk);
+    }
+
+    for (int i = 0; i < len; i ++)
+        set (pos + i, old.get (order[i]));
+}
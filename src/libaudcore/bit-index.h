@@ -0,0 +1,81 @@
+/*
+ * bit-index.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_BIT_INDEX_H
+#define LIBAUDCORE_BIT_INDEX_H
+
+#include <stdint.h>
+
+#include "index.h"
+
+/*
+ * BitIndex is a packed array of bits which, like Index, can grow or shrink at
+ * any position.  Bits are stored 64 to a word, so inserting or removing in the
+ * middle moves whole words at a time, and counting and searching look at a
+ * whole word at once.  Bits beyond len() are always zero.
+ */
+class BitIndex
+{
+public:
+    int len () const
+        { return m_len; }
+
+    bool get (int pos) const
+        { return (m_words[pos >> 6] >> (pos & 63)) & 1; }
+
+    void set (int pos, bool value)
+    {
+        uint64_t bit = (uint64_t) 1 << (pos & 63);
+        if (value)
+            m_words[pos >> 6] |= bit;
+        else
+            m_words[pos >> 6] &= ~bit;
+    }
+
+    /* inserted bits are zero */
+    void insert (int pos, int len);
+    void remove (int pos, int len);
+    void clear ();
+
+    void fill (bool value);
+    void invert ();
+
+    /* number of bits set from <pos> to pos + len - 1 */
+    int count (int pos, int len) const;
+
+    /* first bit at or after <pos> (or last bit at or before <pos>) that is
+     * equal to <value>, or -1 if there is none */
+    int find_next (bool value, int pos) const;
+    int find_prev (bool value, int pos) const;
+
+    /* rearranges the bits from <pos> on, so that the bit at pos + i comes
+     * from pos + order[i] */
+    void reorder (int pos, const Index<int> & order);
+
+private:
+    uint64_t read_bits (int pos, int len) const;
+    void write_bits (int pos, uint64_t bits, int len);
+    void move_bits (int to, int from, int len);
+    void clear_tail ();
+
+    Index<uint64_t> m_words;
+    int m_len = 0;
+};
+
+#endif // LIBAUDCORE_BIT_INDEX_H
@@ -0,0 +1,72 @@
+/*
+ * block-pool.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "block-pool.h"
+
+#include <assert.h>
+
+void AudioBlockPool::alloc (int blocks, int samples)
+{
+    assert (blocks > 0 && samples >= 0);
+
+    destroy ();
+
+    /* allocate the list at its full size, so that give() never has to */
+    m_free.insert (0, blocks);
+
+    for (Index<float> & block : m_free)
+    {
+        block.resize (samples);
+        block.resize (0); /* keeps the memory allocated */
+    }
+
+    m_blocks = blocks;
+}
+
+void AudioBlockPool::destroy ()
+{
+    m_free.clear ();
+    m_blocks = 0;
+    m_misses = 0;
+}
+
+Index<float> AudioBlockPool::take ()
+{
+    if (! m_free.len ())
+    {
+        m_misses ++;
+        return Index<float> ();
+    }
+
+    Index<float> block = std::move (m_free[m_free.len () - 1]);
+    m_free.remove (m_free.len () - 1, 1);
+    return block;
+}
+
+void AudioBlockPool::give (Index<float> && block)
+{
+    if (m_free.len () >= m_blocks)
+    {
+        block.clear ();
+        return;
+    }
+
+    block.resize (0);
+    m_free.append (std::move (block));
+}
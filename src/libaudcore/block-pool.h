@@ -0,0 +1,64 @@
+/*
+ * block-pool.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_BLOCK_POOL_H
+#define LIBAUDCORE_BLOCK_POOL_H
+
+#include "index.h"
+
+/*
+ * AudioBlockPool keeps a fixed number of empty blocks of audio, allocated up
+ * front, so that blocks can be handed from one thread to another without any
+ * memory being allocated or freed while playing:
+ *  - take() transfers ownership of a block to the caller.  The block is empty
+ *    but has room for the number of samples given to alloc().
+ *  - give() transfers ownership back.  A block that has grown beyond that size
+ *    keeps its larger allocation.
+ *  - If the pool runs dry, take() returns a new block (allocated as it is
+ *    filled) and counts a miss.  If the pool is already full, give() frees
+ *    the block.  Neither happens while all blocks are accounted for.
+ *  - The pool itself is not thread-safe; the caller must provide locking.
+ */
+class AudioBlockPool
+{
+public:
+    AudioBlockPool () = default;
+    ~AudioBlockPool ()
+        { destroy (); }
+
+    AudioBlockPool (const AudioBlockPool &) = delete;
+    AudioBlockPool & operator= (const AudioBlockPool &) = delete;
+
+    void alloc (int blocks, int samples);
+    void destroy ();
+
+    int available () const
+        { return m_free.len (); }
+    int misses () const
+        { return m_misses; }
+
+    Index<float> take ();
+    void give (Index<float> && block);
+
+private:
+    Index<Index<float>> m_free;
+    int m_blocks = 0, m_misses = 0;
+};
+
+#endif // LIBAUDCORE_BLOCK_POOL_H
@@ -70,18 +70,34 @@ static const char * const core_defaults[] = {
 
  /* output */
  "default_gain", "0",
+ "effect_threads", "FALSE",
  "enable_replay_gain", "TRUE",
  "enable_clipping_prevention", "TRUE",
  "output_bit_depth", "-1",
+ "output_buffer_adaptive", "FALSE",
  "output_buffer_size", "500",
+ "output_fixed_channels", "2",
+ "output_fixed_format", "FALSE",
+ "output_fixed_rate", "48000",
+ "output_thread", "FALSE",
+ "output_thread_buffer", "500",
+ "pipeline_stats", "FALSE",
+ "realtime_audio", "FALSE",
+ "realtime_cpus", "",
+ "realtime_priority", "10",
  "record", "FALSE",
+ "record_block_time", "100",
+ "record_buffer", "2000",
  "record_stream", aud::numeric_string<(int) OutputStream::AfterReplayGain>::str,
  "replay_gain_mode", aud::numeric_string<(int) ReplayGainMode::Track>::str,
  "replay_gain_preamp", "0",
+ "seek_cache_size", "0",
  "soft_clipping", "FALSE",
  "software_volume_control", "FALSE",
  "sw_volume_left", "100",
  "sw_volume_right", "100",
+ "vis_export", "FALSE",
+ "vis_export_name", "",
  "volume_delta", "5",
 
  /* playback */
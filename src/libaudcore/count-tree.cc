@@ -0,0 +1,107 @@
+/*
+ * count-tree.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "count-tree.h"
+
+#include <assert.h>
+
+static int lowbit (int i)
+    { return i & -i; }
+
+void CountTree::build (Index<int> && counts)
+{
+    m_tree = std::move (counts);
+    m_total = 0;
+
+    int n = m_tree.len ();
+
+    /* add each node into its parent, working upwards */
+    for (int i = 1; i <= n; i ++)
+    {
+        assert (m_tree[i - 1] >= 0);
+
+        int parent = i + lowbit (i);
+        if (parent <= n)
+            m_tree[parent - 1] += m_tree[i - 1];
+    }
+
+    m_total = sum (n);
+}
+
+void CountTree::append (int count)
+{
+    assert (count >= 0);
+
+    /* the new node covers the <lowbit> positions up to and including itself */
+    int i = m_tree.len () + 1;
+    m_tree.append (count + sum (i - 1) - sum (i - lowbit (i)));
+    m_total += count;
+}
+
+void CountTree::clear ()
+{
+    m_tree.clear ();
+    m_total = 0;
+}
+
+void CountTree::add (int pos, int delta)
+{
+    assert (pos >= 0 && pos < m_tree.len ());
+
+    for (int i = pos + 1; i <= m_tree.len (); i += lowbit (i))
+        m_tree[i - 1] += delta;
+
+    m_total += delta;
+}
+
+int CountTree::sum (int pos) const
+{
+    int sum = 0;
+
+    for (int i = pos; i > 0; i -= lowbit (i))
+        sum += m_tree[i - 1];
+
+    return sum;
+}
+
+int CountTree::find (int n) const
+{
+    assert (n >= 0 && n < m_total);
+
+    int len = m_tree.len ();
+    int step = 1;
+
+    while (step * 2 <= len)
+        step *= 2;
+
+    /* descend from the root, skipping whole subtrees whose counts add up to
+     * no more than n */
+    int pos = 0;
+
+    for (; step; step /= 2)
+    {
+        if (pos + step <= len && m_tree[pos + step - 1] <= n)
+        {
+            pos += step;
+            n -= m_tree[pos - 1];
+        }
+    }
+
+    return pos;
+}
@@ -0,0 +1,61 @@
+/*
+ * count-tree.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_COUNT_TREE_H
+#define LIBAUDCORE_COUNT_TREE_H
+
+#include "index.h"
+
+/*
+ * CountTree holds a list of non-negative counts as a Fenwick tree (binary
+ * indexed tree), so that a count can be changed, the sum of the counts before
+ * a position found, or a position found by sum, all in O(log n) time.  The
+ * list can only be grown at the end; anything else means building it again.
+ */
+class CountTree
+{
+public:
+    int len () const
+        { return m_tree.len (); }
+    int total () const
+        { return m_total; }
+
+    /* takes over <counts>, in O(n) time */
+    void build (Index<int> && counts);
+    void append (int count);
+    void clear ();
+
+    int get (int pos) const
+        { return sum (pos + 1) - sum (pos); }
+
+    void add (int pos, int delta);
+
+    /* sum of the counts before <pos> */
+    int sum (int pos) const;
+
+    /* returns the position that contains unit <n> (counting from zero) of the
+     * total, that is, the last position for which sum() is <= n */
+    int find (int n) const;
+
+private:
+    Index<int> m_tree;  /* node i (from zero) covers positions i + 1 - lowbit (i + 1) to i */
+    int m_total = 0;
+};
+
+#endif // LIBAUDCORE_COUNT_TREE_H
@@ -19,6 +19,7 @@
 
 #include "drct.h"
 
+#include "audstrings.h"
 #include "hook.h"
 #include "i18n.h"
 #include "interface.h"
@@ -70,6 +71,45 @@ EXPORT String aud_drct_get_filename ()
     return playlist.entry_filename (playlist.get_position ());
 }
 
+EXPORT Index<PipelineStats> aud_drct_get_pipeline_stats ()
+{
+    static const char * const names[] = {
+        "decoder",
+        "process-audio",
+        "equalizer",
+        "convert",
+        "device-write",
+        "period-wait"
+    };
+
+    Index<PipelineStats> list;
+    PipelineStats stats {};
+
+    for (int s = 0; s < aud::n_elems (names); s ++)
+    {
+        if (pipeline_stats_summary ((PipelineStage) s, 0, stats))
+        {
+            stats.stage = String (names[s]);
+            list.append (std::move (stats));
+        }
+    }
+
+    /* effects are recorded by their position in the plugin list */
+    auto & effects = aud_plugin_list (PluginType::Effect);
+
+    for (int e = 0; e < aud::min (effects.len (), PIPELINE_MAX_EFFECTS); e ++)
+    {
+        if (pipeline_stats_summary (PipelineStage::Effect, e, stats))
+        {
+            stats.stage = String (str_concat ({"effect: ",
+             aud_plugin_get_name (effects[e])}));
+            list.append (std::move (stats));
+        }
+    }
+
+    return list;
+}
+
 /* --- RECORDING CONTROL --- */
 
 /* The recording plugin is currently hard-coded to FileWriter.  Someday
@@ -77,9 +117,21 @@ EXPORT String aud_drct_get_filename ()
 
 static PluginHandle * record_plugin;
 
+/* true if FileWriter or any other plugin has been selected for recording */
+static bool record_possible ()
+{
+    for (PluginHandle * plugin : aud_plugin_list (PluginType::Output))
+    {
+        if (plugin_get_enabled (plugin) == PluginEnabled::Secondary)
+            return true;
+    }
+
+    return false;
+}
+
 static bool record_plugin_watcher (PluginHandle *, void *)
 {
-    if (! aud_drct_get_record_enabled ())
+    if (! record_possible ())
         aud_set_bool ("record", false);
 
     hook_call ("enable record", nullptr);
@@ -88,7 +140,7 @@ static bool record_plugin_watcher (PluginHandle *, void *)
 
 static void validate_record_setting (void *, void *)
 {
-    if (aud_get_bool ("record") && ! aud_drct_get_record_enabled ())
+    if (aud_get_bool ("record") && ! record_possible ())
     {
         /* User attempted to start recording without a recording plugin enabled.
          * This is probably not the best response, but better than nothing. */
@@ -111,7 +163,7 @@ void record_init ()
         aud_plugin_add_watch (plugin, record_plugin_watcher, nullptr);
     }
 
-    if (! aud_drct_get_record_enabled ())
+    if (! record_possible ())
         aud_set_bool ("record", false);
 
     hook_associate ("set record", validate_record_setting, nullptr);
@@ -150,6 +202,21 @@ EXPORT bool aud_drct_enable_record (bool enable)
     return plugin_enable_secondary (record_plugin, enable);
 }
 
+EXPORT bool aud_drct_enable_record_plugin (PluginHandle * plugin, bool enable)
+{
+    if (aud_plugin_get_type (plugin) != PluginType::Output ||
+     plugin_get_enabled (plugin) == PluginEnabled::Primary)
+        return false;
+
+    bool success = plugin_enable_secondary (plugin, enable);
+
+    if (! record_possible ())
+        aud_set_bool ("record", false);
+
+    hook_call ("enable record", nullptr);
+    return success;
+}
+
 /* --- VOLUME CONTROL --- */
 
 EXPORT int aud_drct_get_volume_main ()
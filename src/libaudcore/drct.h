@@ -20,6 +20,8 @@
 #ifndef LIBAUDCORE_DRCT_H
 #define LIBAUDCORE_DRCT_H
 
+#include <stdint.h>
+
 #include <libaudcore/audio.h>
 #include <libaudcore/index.h>
 #include <libaudcore/tuple.h>
@@ -57,9 +59,64 @@ Tuple aud_drct_get_tuple ();
 void aud_drct_get_info (int & bitrate, int & samplerate, int & channels);
 
 int aud_drct_get_time ();
+
+/* Lock-free variants of aud_drct_get_time(), which may be called from any
+ * thread as often as needed.  The position is extrapolated from the last
+ * update by the audio thread and is precise to well below a millisecond.
+ * aud_drct_get_time_frames() counts frames at the sample rate of the song.
+ * Both return 0 if no song is playing. */
+int64_t aud_drct_get_time_us ();
+int64_t aud_drct_get_time_frames ();
 int aud_drct_get_length ();
 void aud_drct_seek (int time);
 
+struct GapStats {
+    int transitions;   /* song changes measured */
+    int64_t last_gap;  /* frames of silence at the last song change */
+    int64_t max_gap;   /* largest gap so far, in frames */
+    int64_t total_gap; /* sum of all gaps, in frames */
+    int rate;          /* output sample rate at the last song change */
+};
+
+/* Returns statistics about the silence between consecutive songs.  A gap is
+ * counted whenever the output runs out of audio from one song before audio
+ * from the next song arrives; frames are counted at the output sample rate. */
+GapStats aud_drct_get_gap_stats ();
+
+struct UnderrunStats {
+    int underruns; /* times the output ran dry while a song was playing */
+    int buffer_ms; /* current size of the decode-ahead buffer, or 0 if the
+                    * output is closed or not threaded */
+};
+
+/* Returns the number of output underruns so far; the "output underrun" hook
+ * is also called after each one.  With "output_buffer_adaptive" enabled, the
+ * decode-ahead buffer grows after underruns and shrinks again while there are
+ * none. */
+UnderrunStats aud_drct_get_underrun_stats ();
+
+/* Counts the seeks (including A-B and song repeats) that were served from the
+ * seek-back cache of recently decoded audio, and those that were not.  Seeks
+ * are not counted if the cache is disabled ("seek_cache_size" set to 0). */
+void aud_drct_get_seek_cache_stats (int & hits, int & misses);
+
+struct PipelineStats {
+    String stage;     /* "decoder", "equalizer", "effect: <plugin name>", etc. */
+    int64_t calls;
+    int64_t mean_ns;
+    int64_t p50_ns;   /* percentiles are accurate to within 1/16 */
+    int64_t p90_ns;
+    int64_t p99_ns;
+    int64_t max_ns;
+};
+
+/* Returns the time taken per call by each stage of the audio pipeline, from
+ * the decoder through the effects, equalizer, and format conversion to the
+ * output plugin.  Times are recorded only while "pipeline_stats" is enabled;
+ * enabling it clears the previous results.  Stages not yet called since then
+ * are left out. */
+Index<PipelineStats> aud_drct_get_pipeline_stats ();
+
 /* "A-B repeat": when playback reaches point B, it returns to point A (where A
  * and B are in milliseconds).  The value -1 is interpreted as the beginning of
  * the song (for A) or the end of the song (for B).  A-B repeat is disabled
@@ -85,6 +142,37 @@ bool aud_drct_get_record_enabled ();
  * Returns true on success, otherwise false. */
 bool aud_drct_enable_record (bool enable);
 
+/* Enables or disables an additional output plugin for recording, alongside the
+ * one returned by aud_drct_get_record_plugin().  Any number of plugins (other
+ * than the current output plugin) may record at the same time.  Each records
+ * from the point given by the "record_stream" setting in its own config
+ * section, if set, otherwise by the global one.  Returns true on success. */
+bool aud_drct_enable_record_plugin (PluginHandle * plugin, bool enable);
+
+struct RecordStats {
+    int64_t dropped_frames; /* audio lost because the plugin fell behind */
+    int lag, max_lag;       /* milliseconds of audio queued for the plugin */
+};
+
+/* Retrieves statistics for a plugin that is currently recording.  The counters
+ * are reset when recording (re)starts.  Returns false if the plugin is not
+ * recording. */
+bool aud_drct_get_record_stats (PluginHandle * plugin, RecordStats & stats);
+
+/* --- OFFLINE RENDERING --- */
+
+struct RenderStats {
+    String filename;
+    int64_t frames;   /* audio frames decoded */
+    int rate;         /* sample rate as decoded */
+    int64_t start_us; /* wall-clock time from the start of rendering */
+    int64_t time_us;  /* wall-clock time taken for this song */
+};
+
+/* Returns statistics for each song played so far in render mode (see
+ * aud_set_render_mode()). */
+Index<RenderStats> aud_drct_get_render_stats ();
+
 /* --- VOLUME CONTROL --- */
 
 StereoVolume aud_drct_get_volume ();
@@ -19,13 +19,29 @@
 
 #include "internal.h"
 
+#include "block-pool.h"
 #include "drct.h"
 #include "list.h"
 #include "plugin.h"
 #include "plugins.h"
+#include "ringbuf.h"
 #include "runtime.h"
 #include "threads.h"
 
+/* With "effect_threads" enabled, each effect runs on its own thread as one
+ * stage of a pipeline.  Blocks of audio are passed from stage to stage through
+ * bounded queues, so effect_process() returns the output of earlier blocks
+ * while later ones are still being processed.
+ *  - flush() and finish() are called only while all stages are idle.  Before
+ *    finish(), the blocks in flight are first processed to the end.
+ *  - The audio held in the queues is included in effect_adjust_delay().
+ *  - Effects added or removed during playback do not take part until the
+ *    next call to effect_process(), which then rebuilds the pipeline.
+ *  - The blocks come from a pool, allocated when the pipeline is built with
+ *    enough blocks to fill every queue.  The caller's buffer is exchanged for
+ *    an empty block from the pool, and blocks out of the last stage are
+ *    returned to it, so no memory is allocated or freed while playing. */
+
 struct Effect : public ListNode
 {
     PluginHandle * plugin;
@@ -33,18 +49,275 @@ struct Effect : public ListNode
     EffectPlugin * header;
     int channels_returned, rate_returned;
     bool remove_flag;
+
+    /* pipeline stage (protected by the main mutex) */
+    bool is_stage, busy;
+    Effect * next_stage;
+    int stage_channels, stage_rate;
+    RingBuf<Index<float>> queue;
+    int64_t queued_samples;
+    std::thread thread;
+
+    /* held by the stage thread while calling process() */
+    aud::mutex plugin_mutex;
+    int delay_added; /* last result of adjust_delay(), as a difference */
 };
 
+static constexpr int QUEUE_DEPTH = 2; /* blocks */
+static constexpr int POOL_BLOCK_MS = 100; /* blocks grow if needed */
+
 static aud::mutex mutex;
 static List<Effect> effects;
 static int input_channels, input_rate;
 
+static aud::condvar cond;
+static bool use_threads, pipelined, stopping, holding;
+static Effect * first_stage;
+static RingBuf<Index<float>> finished; /* blocks out of the last stage */
+static int64_t finished_samples;
+static int output_channels, output_rate;
+static Index<float> result;
+static AudioBlockPool pool;
+
+static void push_block (aud::mutex::holder &, Effect * stage, Index<float> && block)
+{
+    int samples = block.len ();
+
+    if (stage)
+    {
+        stage->queue.push (std::move (block));
+        stage->queued_samples += samples;
+    }
+    else
+    {
+        finished.push (std::move (block));
+        finished_samples += samples;
+    }
+
+    cond.notify_all ();
+}
+
+static void stage_thread (Effect * e)
+{
+    realtime_setup_thread (aud_plugin_get_name (e->plugin));
+
+    auto mh = mutex.take ();
+
+    while (! stopping)
+    {
+        auto & out = e->next_stage ? e->next_stage->queue : finished;
+
+        if (holding || ! e->queue.len () || ! out.space ())
+        {
+            cond.wait (mh);
+            continue;
+        }
+
+        Index<float> block = std::move (e->queue.head ());
+        e->queue.pop ();
+        e->busy = true;
+
+        mh.unlock ();
+
+        int samples = block.len ();
+
+        {
+            auto ph = e->plugin_mutex.take ();
+            StageTimer timer (PipelineStage::Effect, e->position);
+            Index<float> & processed = e->header->process (block);
+
+            /* the plugin may keep our (used) input buffer as its new working
+             * buffer, which saves a copy and an allocation */
+            if (& processed != & block)
+                std::swap (processed, block);
+        }
+
+        mh.lock ();
+
+        e->busy = false;
+        e->queued_samples -= samples;
+
+        if (block.len ())
+            push_block (mh, e->next_stage, std::move (block));
+        else
+        {
+            pool.give (std::move (block));
+            cond.notify_all ();
+        }
+    }
+}
+
+static void start_stages (aud::mutex::holder &)
+{
+    if (! use_threads || ! effects.head ())
+        return;
+
+    Effect * prev = nullptr;
+    int channels = input_channels, rate = input_rate;
+    int max_channels = channels, max_rate = rate;
+    int stages = 0;
+
+    for (Effect * e = effects.head (); e; e = effects.next (e), stages ++)
+    {
+        e->is_stage = true;
+        e->next_stage = nullptr;
+        e->stage_channels = channels;
+        e->stage_rate = rate;
+        e->queue.alloc (QUEUE_DEPTH);
+
+        if (prev)
+            prev->next_stage = e;
+        else
+            first_stage = e;
+
+        channels = e->channels_returned;
+        rate = e->rate_returned;
+        max_channels = aud::max (max_channels, channels);
+        max_rate = aud::max (max_rate, rate);
+        prev = e;
+    }
+
+    output_channels = channels;
+    output_rate = rate;
+    finished.alloc (QUEUE_DEPTH);
+
+    /* one block in each queue slot and in each process() call, plus one
+     * exchanged for the caller's buffer */
+    int blocks = stages * (QUEUE_DEPTH + 1) + QUEUE_DEPTH + 1;
+    int block_samples = max_channels * aud::rescale (POOL_BLOCK_MS, 1000, max_rate);
+    pool.alloc (blocks, block_samples);
+
+    /* every block in flight may be collected into the result at once */
+    result.resize (blocks * block_samples);
+    result.resize (0); /* keeps the memory allocated */
+
+    stopping = false;
+    holding = false;
+
+    for (Effect * e = first_stage; e; e = e->next_stage)
+        e->thread = std::thread (stage_thread, e);
+
+    AUDINFO ("Running effects in a %d-stage pipeline.\n", stages);
+    pipelined = true;
+}
+
+/* stops the stage threads and discards any blocks still in flight */
+static void stop_stages (aud::mutex::holder & mh)
+{
+    if (! pipelined)
+        return;
+
+    stopping = true;
+    cond.notify_all ();
+
+    /* the stages are not removed from the list while their threads exist */
+    mh.unlock ();
+
+    for (Effect * e = first_stage; e; e = e->next_stage)
+        e->thread.join ();
+
+    mh.lock ();
+
+    for (Effect * e = first_stage; e; e = e->next_stage)
+    {
+        e->queue.destroy ();
+        e->queued_samples = 0;
+        e->is_stage = false;
+    }
+
+    finished.destroy ();
+    finished_samples = 0;
+    pool.destroy ();
+
+    first_stage = nullptr;
+    pipelined = false;
+}
+
+/* waits until no stage is running process() and keeps them from starting */
+static void hold_stages (aud::mutex::holder & mh)
+{
+    holding = true;
+
+    for (Effect * e = first_stage; e; e = e->next_stage)
+    {
+        while (e->busy)
+            cond.wait (mh);
+    }
+}
+
+static void release_stages (aud::mutex::holder &)
+{
+    holding = false;
+    cond.notify_all ();
+}
+
+/* returns the blocks in a queue to the pool, unprocessed */
+static void discard_blocks (aud::mutex::holder &, RingBuf<Index<float>> & queue)
+{
+    while (queue.len ())
+    {
+        pool.give (std::move (queue.head ()));
+        queue.pop ();
+    }
+}
+
+/* appends the blocks out of the last stage to the result buffer */
+static void collect_blocks (aud::mutex::holder &)
+{
+    if (! finished.len ())
+        return;
+
+    while (finished.len ())
+    {
+        result.move_from (finished.head (), 0, -1, -1, true, true);
+        pool.give (std::move (finished.head ()));
+        finished.pop ();
+    }
+
+    finished_samples = 0;
+    cond.notify_all ();
+}
+
+/* waits until all blocks in flight have been through the last stage */
+static void drain_stages (aud::mutex::holder & mh)
+{
+    while (1)
+    {
+        collect_blocks (mh);
+
+        bool idle = true;
+        for (Effect * e = first_stage; e; e = e->next_stage)
+        {
+            if (e->busy || e->queue.len ())
+                idle = false;
+        }
+
+        if (idle)
+            break;
+
+        cond.wait (mh);
+    }
+}
+
+/* effects added or removed since the pipeline was built */
+static bool chain_changed (aud::mutex::holder &)
+{
+    for (Effect * e = effects.head (); e; e = effects.next (e))
+    {
+        if (e->remove_flag || ! e->is_stage)
+            return true;
+    }
+
+    return false;
+}
+
 void effect_start (int & channels, int & rate)
 {
     auto mh = mutex.take ();
 
     AUDDBG ("Starting effects.\n");
 
+    stop_stages (mh);
     effects.clear ();
 
     input_channels = channels;
@@ -76,11 +349,13 @@ void effect_start (int & channels, int & rate)
 
         effects.append (effect);
     }
+
+    use_threads = aud_get_bool ("effect_threads");
+    start_stages (mh);
 }
 
-Index<float> & effect_process (Index<float> & data)
+static Index<float> & process_serial (aud::mutex::holder &, Index<float> & data)
 {
-    auto mh = mutex.take ();
     Index<float> * cur = & data;
 
     Effect * e = effects.head ();
@@ -105,7 +380,10 @@ Index<float> & effect_process (Index<float> & data)
             delete e;
         }
         else
+        {
+            StageTimer timer (PipelineStage::Effect, e->position);
             cur = & e->header->process (* cur);
+        }
 
         e = next;
     }
@@ -113,11 +391,54 @@ Index<float> & effect_process (Index<float> & data)
     return * cur;
 }
 
+Index<float> & effect_process (Index<float> & data)
+{
+    auto mh = mutex.take ();
+
+    if (! pipelined && ! (use_threads && effects.head ()))
+        return process_serial (mh, data);
+
+    result.resize (0);
+
+    if (! pipelined || chain_changed (mh))
+    {
+        /* finish the blocks in flight, then process this one serially so that
+         * removed effects can pass on their remaining output */
+        drain_stages (mh);
+        stop_stages (mh);
+
+        result.move_from (process_serial (mh, data), 0, -1, -1, true, true);
+
+        start_stages (mh);
+        return result;
+    }
+
+    if (data.len ())
+    {
+        /* wait for room in the first queue */
+        while (! first_stage->queue.space ())
+        {
+            collect_blocks (mh);
+            cond.wait (mh);
+        }
+
+        /* the caller keeps an empty block in place of its buffer */
+        Index<float> block = pool.take ();
+        std::swap (block, data);
+        push_block (mh, first_stage, std::move (block));
+    }
+
+    collect_blocks (mh);
+    return result;
+}
+
 bool effect_flush (bool force)
 {
     auto mh = mutex.take ();
     bool flushed = true;
 
+    hold_stages (mh);
+
     for (Effect * e = effects.head (); e; e = effects.next (e))
     {
         if (! e->header->flush (force) && ! force)
@@ -125,8 +446,23 @@ bool effect_flush (bool force)
             flushed = false;
             break;
         }
+
+        /* audio queued ahead of an effect counts as buffered in it, so it is
+         * kept if the effect declined to flush */
+        if (e->is_stage)
+        {
+            discard_blocks (mh, e->queue);
+            e->queued_samples = 0;
+        }
     }
 
+    if (flushed)
+    {
+        discard_blocks (mh, finished);
+        finished_samples = 0;
+    }
+
+    release_stages (mh);
     return flushed;
 }
 
@@ -135,22 +471,69 @@ Index<float> & effect_finish (Index<float> & data, bool end_of_playlist)
     auto mh = mutex.take ();
     Index<float> * cur = & data;
 
+    if (pipelined)
+    {
+        result.resize (0);
+        drain_stages (mh);
+        hold_stages (mh);
+    }
+
     for (Effect * e = effects.head (); e; e = effects.next (e))
         cur = & e->header->finish (* cur, end_of_playlist);
 
+    if (pipelined)
+    {
+        result.move_from (* cur, 0, -1, -1, true, true);
+        release_stages (mh);
+        return result;
+    }
+
     return * cur;
 }
 
+static int queued_ms (int64_t samples, int channels, int rate)
+{
+    return aud::rescale<int64_t> (samples / channels, rate, 1000);
+}
+
 int effect_adjust_delay (int delay)
 {
     auto mh = mutex.take ();
 
+    if (pipelined)
+        delay += queued_ms (finished_samples, output_channels, output_rate);
+
     for (Effect * e = effects.tail (); e; e = effects.prev (e))
-        delay = e->header->adjust_delay (delay);
+    {
+        if (e->is_stage)
+        {
+            /* don't wait for process() to return; the latency of an effect
+             * changes little from one block to the next */
+            if (e->plugin_mutex.try_lock ())
+            {
+                e->delay_added = e->header->adjust_delay (delay) - delay;
+                e->plugin_mutex.unlock ();
+            }
+
+            delay += e->delay_added;
+            delay += queued_ms (e->queued_samples, e->stage_channels, e->stage_rate);
+        }
+        else
+            delay = e->header->adjust_delay (delay);
+    }
 
     return delay;
 }
 
+void effect_cleanup ()
+{
+    auto mh = mutex.take ();
+
+    stop_stages (mh);
+    effects.clear ();
+    result.clear ();
+}
+
 static void effect_insert (aud::mutex::holder &, PluginHandle * plugin, EffectPlugin * header)
 {
     int position = aud_plugin_list (PluginType::Effect).find (plugin);
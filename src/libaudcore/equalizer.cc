@@ -47,13 +47,43 @@
 static const float CF[AUD_EQ_NBANDS] = {31.25f, 62.5f, 125, 250, 500, 1000,
  2000, 4000, 8000, 16000};
 
+/* Channels are filtered in parallel, LANES at a time, using the compiler's
+ * generic vector types (which map to SSE, NEON, etc.).  The filter state is
+ * therefore stored "transposed", with each vector holding one value for each
+ * of LANES consecutive channels. */
+#define LANES 4
+#define GROUPS ((AUD_MAX_CHANNELS + LANES - 1) / LANES)
+
+typedef float Lanes __attribute__ ((vector_size (LANES * sizeof (float))));
+
+/* The gains are computed in the main thread and passed to the audio thread
+ * through a lock-free triple buffer: the main thread fills in the "back" set
+ * and swaps it with the "middle" one, flagging it as fresh; the audio thread
+ * swaps the middle set with its "front" one when it sees the flag, at the start
+ * of the next buffer.  The new gains are faded in over that buffer. */
+#define FRESH 4
+
+struct EqGains {
+    bool active;
+    float gains[AUD_EQ_NBANDS]; /* Gain factor for each band */
+};
+
+static EqGains gain_sets[3];
+static int middle_set = 1; /* index and FRESH flag, accessed atomically */
+
+/* main thread state, protected by mutex */
 static aud::mutex mutex;
+static int back_set = 0;
+
+/* audio thread state; eq_set_format() and eq_filter() are called only by
+ * output.cc, which serializes them */
+static int front_set = 2;
 static bool active;
 static int channels, rate;
 static float a[AUD_EQ_NBANDS][2]; /* A weights */
 static float b[AUD_EQ_NBANDS][2]; /* B weights */
-static float wqv[AUD_MAX_CHANNELS][AUD_EQ_NBANDS][2]; /* Circular buffer for W data */
-static float gv[AUD_MAX_CHANNELS][AUD_EQ_NBANDS]; /* Gain factor for each channel and band */
+static Lanes wqv[GROUPS][AUD_EQ_NBANDS][2]; /* Circular buffer for W data */
+static float gv[AUD_EQ_NBANDS]; /* Gain factor currently applied */
 static int K; /* Number of used EQ bands */
 
 /* 2nd order band-pass filter design */
@@ -70,8 +100,6 @@ static void bp2 (float *a, float *b, float fc)
 
 void eq_set_format (int new_channels, int new_rate)
 {
-    auto mh = mutex.take ();
-
     channels = new_channels;
     rate = new_rate;
 
@@ -90,54 +118,168 @@ void eq_set_format (int new_channels, int new_rate)
     memset (wqv[0][0], 0, sizeof wqv);
 }
 
-static void eq_set_bands_real (aud::mutex::holder &, double preamp, double *values)
+/* Runs the filter cascade over all frames of <data> for one group of up to
+ * LANES channels.  Lanes beyond the last channel just carry zeros.  If <fade>
+ * is set, the gains are stepped by <dg> after each frame. */
+template<bool fade>
+static void eq_filter_group (float *data, int frames, int group, const float *dg)
 {
-    float adj[AUD_EQ_NBANDS];
+    int first = group * LANES;
+    int n = aud::min (LANES, channels - first);
+    Lanes (*wq)[2] = wqv[group];
 
-    for (int i = 0; i < AUD_EQ_NBANDS; i ++)
-        adj[i] = preamp + values[i];
+    float g[AUD_EQ_NBANDS]; /* Gain factor */
+    memcpy (g, gv, sizeof g);
+
+    for (float *f = data + first; frames --; f += channels)
+    {
+        Lanes yt = {0}; /* Current input samples */
+
+        if (n == LANES)
+            memcpy (&yt, f, sizeof yt);
+        else
+        {
+            for (int l = 0; l < n; l ++)
+                yt[l] = f[l];
+        }
+
+        for (int k = 0; k < K; k ++)
+        {
+            /* Calculate output from AR part of current filter */
+            Lanes w = yt * b[k][0] + wq[k][0] * a[k][0] + wq[k][1] * a[k][1];
+
+            /* Calculate output from MA part of current filter */
+            yt += (w + wq[k][1] * b[k][1]) * g[k];
+
+            /* Update circular buffer */
+            wq[k][1] = wq[k][0];
+            wq[k][0] = w;
+        }
+
+        /* Calculate output */
+        if (n == LANES)
+            memcpy (f, &yt, sizeof yt);
+        else
+        {
+            for (int l = 0; l < n; l ++)
+                f[l] = yt[l];
+        }
+
+        if (fade)
+        {
+            for (int k = 0; k < K; k ++)
+                g[k] += dg[k];
+        }
+    }
+}
+
+/* Runs the filter cascade for a single channel, as eq_filter_group() does for a
+ * whole group.  Used when a group would leave most of its lanes empty: the
+ * cascade is bound by its recursion latency either way, and the scalar loop
+ * avoids packing and unpacking partial vectors on each frame. */
+template<bool fade>
+static void eq_filter_channel (float *data, int frames, int channel, const float *dg)
+{
+    Lanes (*wq)[2] = wqv[channel / LANES];
+    int lane = channel % LANES;
+
+    float g[AUD_EQ_NBANDS]; /* Gain factor */
+    memcpy (g, gv, sizeof g);
+
+    float w0[AUD_EQ_NBANDS], w1[AUD_EQ_NBANDS]; /* Circular buffer for W data */
+    for (int k = 0; k < K; k ++)
+    {
+        w0[k] = wq[k][0][lane];
+        w1[k] = wq[k][1][lane];
+    }
+
+    for (float *f = data + channel; frames --; f += channels)
+    {
+        float yt = *f; /* Current input sample */
 
-    for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+        for (int k = 0; k < K; k ++)
+        {
+            float w = yt * b[k][0] + w0[k] * a[k][0] + w1[k] * a[k][1];
+            yt += (w + w1[k] * b[k][1]) * g[k];
+            w1[k] = w0[k];
+            w0[k] = w;
+        }
+
+        *f = yt;
+
+        if (fade)
+        {
+            for (int k = 0; k < K; k ++)
+                g[k] += dg[k];
+        }
+    }
+
+    for (int k = 0; k < K; k ++)
     {
-        for (int i = 0; i < AUD_EQ_NBANDS; i ++)
-            gv[c][i] = powf (10, adj[i] / 20) - 1;
+        wq[k][0][lane] = w0[k];
+        wq[k][1][lane] = w1[k];
     }
 }
 
 void eq_filter (float *data, int samples)
 {
-    auto mh = mutex.take ();
+    bool fresh = __atomic_load_n (&middle_set, __ATOMIC_ACQUIRE) & FRESH;
 
-    if (! active)
+    if (! fresh && ! active)
         return;
 
-    for (int channel = 0; channel < channels; channel ++)
+    StageTimer timer (PipelineStage::Equalizer);
+
+    int frames = samples / channels;
+    float target[AUD_EQ_NBANDS], dg[AUD_EQ_NBANDS];
+
+    if (fresh)
     {
-        float *g = gv[channel]; /* Gain factor */
-        float *end = data + samples;
+        front_set = __atomic_exchange_n (&middle_set, front_set, __ATOMIC_ACQ_REL) & ~FRESH;
+        const EqGains &set = gain_sets[front_set];
 
-        for (float *f = data + channel; f < end; f += channels)
+        /* fade in from (or out to) a flat response */
+        if (set.active && ! active)
         {
-            float yt = *f; /* Current input sample */
+            memset (gv, 0, sizeof gv);
+            memset (wqv, 0, sizeof wqv);
+        }
 
-            for (int k = 0; k < K; k ++)
-            {
-                /* Pointer to circular buffer wq */
-                float *wq = wqv[channel][k];
-                /* Calculate output from AR part of current filter */
-                float w = yt * b[k][0] + wq[0] * a[k][0] + wq[1] * a[k][1];
+        for (int k = 0; k < AUD_EQ_NBANDS; k ++)
+        {
+            target[k] = set.active ? set.gains[k] : 0;
+            dg[k] = frames ? (target[k] - gv[k]) / frames : 0;
+        }
 
-                /* Calculate output from MA part of current filter */
-                yt += (w + wq[1] * b[k][1]) * g[k];
+        active = active || set.active;
+    }
 
-                /* Update circular buffer */
-                wq[1] = wq[0];
-                wq[0] = w;
-            }
+    for (int group = 0; group * LANES < channels; group ++)
+    {
+        int first = group * LANES;
+        int n = aud::min (LANES, channels - first);
 
-            /* Calculate output */
-            *f = yt;
+        if (n <= LANES / 2)
+        {
+            for (int channel = first; channel < first + n; channel ++)
+            {
+                if (fresh)
+                    eq_filter_channel<true> (data, frames, channel, dg);
+                else
+                    eq_filter_channel<false> (data, frames, channel, nullptr);
+            }
         }
+        else if (fresh)
+            eq_filter_group<true> (data, frames, group, dg);
+        else
+            eq_filter_group<false> (data, frames, group, nullptr);
+    }
+
+    if (fresh)
+    {
+        /* finish the fade exactly on target */
+        memcpy (gv, target, sizeof gv);
+        active = gain_sets[front_set].active;
     }
 }
 
@@ -145,11 +287,18 @@ static void eq_update (void *, void *)
 {
     auto mh = mutex.take ();
 
-    active = aud_get_bool ("equalizer_active");
-
     double values[AUD_EQ_NBANDS];
     aud_eq_get_bands (values);
-    eq_set_bands_real (mh, aud_get_double ("equalizer_preamp"), values);
+    double preamp = aud_get_double ("equalizer_preamp");
+
+    EqGains &set = gain_sets[back_set];
+    set.active = aud_get_bool ("equalizer_active");
+
+    for (int i = 0; i < AUD_EQ_NBANDS; i ++)
+        set.gains[i] = powf (10, (float) (preamp + values[i]) / 20) - 1;
+
+    /* publish the new gains and take back the previous middle set */
+    back_set = __atomic_exchange_n (&middle_set, back_set | FRESH, __ATOMIC_ACQ_REL) & ~FRESH;
 }
 
 void eq_init ()
@@ -1,6 +1,7 @@
 /*
  * fft.c
  * Copyright 2011 John Lindgren
+ * Copyright 2026 Audacious developers
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are met:
@@ -17,106 +18,267 @@
  * the use of this software.
  */
 
+#include "fft.h"
 #include "internal.h"
 
-#include <complex>
+#include <assert.h>
 #include <math.h>
+#include <string.h>
 
-#define TWO_PI 6.2831853f
+#include "threads.h"
 
-#define N 512                         /* size of the DFT */
-#define LOGN 9                        /* log N (base 2) */
+/* A real input of N samples is treated as a complex input of N/2 samples (even
+ * samples as the real part, odd samples as the imaginary part), transformed
+ * with a radix-2 Cooley-Tukey FFT, and then separated again into the N/2+1
+ * bins of the real spectrum.
+ *
+ * The complex values are stored "split", with real and imaginary parts in
+ * separate arrays, so that LANES butterflies at a time can be computed using
+ * the compiler's generic vector types (see equalizer.cc).  The twiddle factors
+ * for each step are stored contiguously for the same reason. */
+#define LANES 4
+
+#define MIN_LOG 8  /* log2 (FFT::MinSize) */
+#define MAX_LOG 14 /* log2 (FFT::MaxSize) */
 
-typedef std::complex<float> Complex;
+typedef float Lanes __attribute__ ((vector_size (LANES * sizeof (float))));
 
-static float hamming[N];              /* hamming window, scaled to sum to 1 */
-static int reversed[N];               /* bit-reversal table */
-static Complex roots[N / 2];          /* N-th roots of unity */
-static char generated = 0;            /* set if tables have been generated */
+struct FFTPlan
+{
+    int half;                  /* N/2, size of the complex FFT */
+    Index<int> reversed;       /* bit-reversal table for N/2 */
+    Index<float> step_re;      /* twiddle factors, at offset (span - 1) for */
+    Index<float> step_im;      /* the step with butterflies of a given span */
+    Index<float> split_re;     /* N-th roots of unity, used to separate the */
+    Index<float> split_im;     /* real spectrum from the complex one */
+};
 
-/* Reverse the order of the lowest LOGN bits in an integer. */
+/* Plans are built on first use and then kept until exit.  Once published, a
+ * plan is never changed, so it can be used without locking. */
+static aud::mutex mutex;
+static FFTPlan * plans[MAX_LOG + 1];
 
-static int bit_reverse (int x)
+static FFTPlan * build_plan (int log)
 {
-    int y = 0;
+    auto plan = new FFTPlan;
+    int half = 1 << (log - 1);
+
+    plan->half = half;
 
-    for (int n = LOGN; n --; )
+    plan->reversed.insert (0, half);
+    for (int n = 0; n < half; n ++)
     {
-        y = (y << 1) | (x & 1);
-        x >>= 1;
+        int y = 0;
+        for (int x = n, b = log - 1; b --; x >>= 1)
+            y = (y << 1) | (x & 1);
+
+        plan->reversed[n] = y;
     }
 
-    return y;
-}
+    plan->step_re.insert (0, half);
+    plan->step_im.insert (0, half);
+    for (int span = 1; span < half; span <<= 1)
+    {
+        for (int b = 0; b < span; b ++)
+        {
+            double angle = -M_PI * b / span;
+            plan->step_re[span - 1 + b] = cos (angle);
+            plan->step_im[span - 1 + b] = sin (angle);
+        }
+    }
 
-/* Generate lookup tables. */
+    plan->split_re.insert (0, half + 1);
+    plan->split_im.insert (0, half + 1);
+    for (int k = 0; k <= half; k ++)
+    {
+        double angle = -M_PI * k / half;
+        plan->split_re[k] = cos (angle);
+        plan->split_im[k] = sin (angle);
+    }
+
+    return plan;
+}
 
-static void generate_tables ()
+static const FFTPlan * get_plan (int log)
 {
-    if (generated)
-        return;
+    FFTPlan * plan = __atomic_load_n (& plans[log], __ATOMIC_ACQUIRE);
+    if (plan)
+        return plan;
 
-    for (int n = 0; n < N; n ++)
-        hamming[n] = 1 - 0.85f * cosf (n * (TWO_PI / N));
-    for (int n = 0; n < N; n ++)
-        reversed[n] = bit_reverse (n);
-    for (int n = 0; n < N / 2; n ++)
-        roots[n] = exp (Complex (0, n * (TWO_PI / N)));
+    auto mh = mutex.take ();
 
-    generated = 1;
+    if (! plans[log])
+        __atomic_store_n (& plans[log], build_plan (log), __ATOMIC_RELEASE);
+
+    return plans[log];
 }
 
-/* Perform the DFT using the Cooley-Tukey algorithm.  At each step s, where
- * s=1..log N (base 2), there are N/(2^s) groups of intertwined butterfly
- * operations.  Each group contains (2^s)/2 butterflies, and each butterfly has
- * a span of (2^s)/2.  The twiddle factors are nth roots of unity where n = 2^s. */
+static double window_value (FFTWindow window, double x /* 0 to 1 */)
+{
+    switch (window)
+    {
+    case FFTWindow::Hann:
+        return 0.5 - 0.5 * cos (2 * M_PI * x);
+    case FFTWindow::Hamming:
+        return 0.54 - 0.46 * cos (2 * M_PI * x);
+    case FFTWindow::Blackman:
+        return 0.42 - 0.5 * cos (2 * M_PI * x) + 0.08 * cos (4 * M_PI * x);
+    case FFTWindow::BlackmanHarris:
+        return 0.35875 - 0.48829 * cos (2 * M_PI * x) +
+         0.14128 * cos (4 * M_PI * x) - 0.01168 * cos (6 * M_PI * x);
+    default:
+        return 1;
+    }
+}
 
-static void do_fft (Complex a[N])
+/* Performs the butterflies of each step in place.  At each step, the array is
+ * divided into groups of 2 * span values, and each butterfly combines values
+ * <span> apart within a group. */
+static void run_steps (const FFTPlan * plan, float * re, float * im)
 {
-    int half = 1;       /* (2^s)/2 */
-    int inv = N / 2;    /* N/(2^s) */
+    int half = plan->half;
 
-    /* loop through steps */
-    while (inv)
+    for (int span = 1; span < half; span <<= 1)
     {
-        /* loop through groups */
-        for (int g = 0; g < N; g += half << 1)
+        const float * wr = & plan->step_re[span - 1];
+        const float * wi = & plan->step_im[span - 1];
+
+        for (int g = 0; g < half; g += 2 * span)
         {
-            /* loop through butterflies */
-            for (int b = 0, r = 0; b < half; b ++, r += inv)
+            float * ar = re + g, * ai = im + g;
+            float * br = ar + span, * bi = ai + span;
+
+            if (span < LANES)
             {
-                Complex even = a[g + b];
-                Complex odd = roots[r] * a[g + half + b];
-                a[g + b] = even + odd;
-                a[g + half + b] = even - odd;
+                for (int b = 0; b < span; b ++)
+                {
+                    float tr = wr[b] * br[b] - wi[b] * bi[b];
+                    float ti = wr[b] * bi[b] + wi[b] * br[b];
+
+                    br[b] = ar[b] - tr;
+                    bi[b] = ai[b] - ti;
+                    ar[b] += tr;
+                    ai[b] += ti;
+                }
             }
-        }
+            else
+            {
+                for (int b = 0; b < span; b += LANES)
+                {
+                    Lanes vwr, vwi, var, vai, vbr, vbi;
+                    memcpy (& vwr, wr + b, sizeof vwr);
+                    memcpy (& vwi, wi + b, sizeof vwi);
+                    memcpy (& var, ar + b, sizeof var);
+                    memcpy (& vai, ai + b, sizeof vai);
+                    memcpy (& vbr, br + b, sizeof vbr);
+                    memcpy (& vbi, bi + b, sizeof vbi);
 
-        half <<= 1;
-        inv >>= 1;
+                    Lanes tr = vwr * vbr - vwi * vbi;
+                    Lanes ti = vwr * vbi + vwi * vbr;
+
+                    vbr = var - tr;
+                    vbi = vai - ti;
+                    var += tr;
+                    vai += ti;
+
+                    memcpy (ar + b, & var, sizeof var);
+                    memcpy (ai + b, & vai, sizeof vai);
+                    memcpy (br + b, & vbr, sizeof vbr);
+                    memcpy (bi + b, & vbi, sizeof vbi);
+                }
+            }
+        }
     }
 }
 
-/* Input is N=512 PCM samples.
- * Output is intensity of frequencies from 1 to N/2=256. */
+EXPORT FFT::FFT (int size, FFTWindow window) :
+    m_size (size)
+{
+    int log = 0;
+    while ((1 << log) < size)
+        log ++;
+
+    assert (size == (1 << log) && log >= MIN_LOG && log <= MAX_LOG);
+
+    m_plan = get_plan (log);
+
+    /* scale the window to an average of 1 */
+    m_window.insert (0, size);
+
+    double sum = 0;
+    for (int n = 0; n < size; n ++)
+        sum += (m_window[n] = window_value (window, (double) n / size));
+    for (int n = 0; n < size; n ++)
+        m_window[n] *= size / sum;
+
+    m_work.insert (0, size);
+    m_bins.insert (0, size + 2);
+}
+
+EXPORT void FFT::transform (const float * in, float * re, float * im)
+{
+    int half = m_plan->half;
+    const int * reversed = m_plan->reversed.begin ();
+    const float * window = m_window.begin ();
+
+    float * zr = m_work.begin ();
+    float * zi = zr + half;
+
+    /* pack pairs of real samples as complex values, in bit-reversed order */
+    for (int n = 0; n < half; n ++)
+    {
+        zr[reversed[n]] = in[2 * n] * window[2 * n];
+        zi[reversed[n]] = in[2 * n + 1] * window[2 * n + 1];
+    }
+
+    run_steps (m_plan, zr, zi);
 
-void calc_freq (const float data[N], float freq[N / 2])
+    /* separate the spectra of the even and odd samples and combine them:
+     *   E[k] = (Z[k] + conj (Z[half - k])) / 2
+     *   O[k] = (Z[k] - conj (Z[half - k])) / 2i
+     *   X[k] = E[k] + exp (-2 pi i k / N) O[k] */
+    const float * sr = m_plan->split_re.begin ();
+    const float * si = m_plan->split_im.begin ();
+
+    for (int k = 0; k <= half; k ++)
+    {
+        int a = k & (half - 1);
+        int b = (half - k) & (half - 1);
+
+        float er = (zr[a] + zr[b]) / 2;
+        float ei = (zi[a] - zi[b]) / 2;
+        float orr = (zi[a] + zi[b]) / 2;
+        float oi = (zr[b] - zr[a]) / 2;
+
+        re[k] = er + sr[k] * orr - si[k] * oi;
+        im[k] = ei + sr[k] * oi + si[k] * orr;
+    }
+}
+
+EXPORT void FFT::magnitudes (const float * in, float * out)
 {
-    generate_tables ();
+    int half = m_plan->half;
+    float * re = m_bins.begin ();
+    float * im = re + half + 1;
+
+    transform (in, re, im);
 
-    /* input is filtered by a Hamming window */
-    /* input values are in bit-reversed order */
-    Complex a[N];
-    for (int n = 0; n < N; n ++)
-        a[reversed[n]] = data[n] * hamming[n];
+    /* bins below the Nyquist frequency also have a mirror image, so their
+     * amplitude is doubled */
+    float scale = 2.0f / m_size;
 
-    do_fft (a);
+    for (int k = 1; k < half; k ++)
+        out[k - 1] = scale * sqrtf (re[k] * re[k] + im[k] * im[k]);
 
-    /* output values are divided by N */
-    /* frequencies from 1 to N/2-1 are doubled */
-    for (int n = 0; n < N / 2 - 1; n ++)
-        freq[n] = 2 * abs (a[1 + n]) / N;
+    out[half - 1] = (scale / 2) * fabsf (re[half]);
+}
+
+/* Input is 512 PCM samples.
+ * Output is intensity of frequencies from 1 to 256.
+ * Called only from the vis-runner analysis thread (see vis_analyze). */
 
-    /* frequency N/2 is not doubled */
-    freq[N / 2 - 1] = abs (a[N / 2]) / N;
+void calc_freq (const float data[512], float freq[256])
+{
+    static FFT fft (512, FFTWindow::Hamming);
+    fft.magnitudes (data, freq);
 }
@@ -0,0 +1,74 @@
+/*
+ * fft.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_FFT_H
+#define LIBAUDCORE_FFT_H
+
+#include <libaudcore/index.h>
+
+struct FFTPlan;
+
+/* All windows are scaled to an average value of 1, so that the magnitude of a
+ * sine wave does not depend on the window chosen. */
+enum class FFTWindow {
+    Rectangular,
+    Hann,
+    Hamming,
+    Blackman,
+    BlackmanHarris
+};
+
+/*
+ * FFT computes the spectrum of a block of real-valued samples:
+ *  - The size (the number of input samples) must be a power of two between
+ *    MinSize and MaxSize.
+ *  - The tables for each size are computed once and then shared, so creating
+ *    an FFT object is cheap, and any number of objects may be used in parallel
+ *    from different threads.  A single object, however, has its own work
+ *    buffers and must not be used by two threads at once.
+ */
+class FFT
+{
+public:
+    static constexpr int MinSize = 256;
+    static constexpr int MaxSize = 16384;
+
+    FFT (int size, FFTWindow window = FFTWindow::Hann);
+
+    FFT (const FFT &) = delete;
+    FFT & operator= (const FFT &) = delete;
+
+    int size () const
+        { return m_size; }
+
+    /* computes the <size> / 2 + 1 frequency bins from DC to the Nyquist
+     * frequency, unscaled, with real and imaginary parts in separate arrays */
+    void transform (const float * in, float * re, float * im);
+
+    /* computes the amplitudes of frequency bins 1 to <size> / 2; a full-scale
+     * sine wave centered on a bin gives an amplitude of 1 */
+    void magnitudes (const float * in, float * out);
+
+private:
+    int m_size;
+    const FFTPlan * m_plan;
+    Index<float> m_window, m_work, m_bins;
+};
+
+#endif // LIBAUDCORE_FFT_H
@@ -27,11 +27,14 @@
 #include "objects.h"
 
 class InputPlugin;
+class OutputPlugin;
 class Plugin;
 class PluginHandle;
 class VFSFile;
 class Tuple;
 
+struct StereoVolume;
+
 typedef bool (* DirForeachFunc) (const char * path, const char * basename, void * user);
 
 /* adder.cc */
@@ -39,12 +42,28 @@ void adder_cleanup ();
 
 /* art.cc */
 void art_cache_current (const String & filename, Index<char> && data, String && art_file);
+void art_request_current (const String & filename);
 void art_clear_current ();
 void art_cleanup ();
 
 /* art-search.cc */
 String art_search (const char * filename);
 
+/* audio.cc */
+enum class AudioSIMD {
+    None,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+AudioSIMD audio_simd_get ();
+bool audio_simd_select (AudioSIMD level);
+
+bool audio_volume_factors (StereoVolume volume, int channels, float * factors);
+void audio_amplify_convert (const float * in, void * out, int format,
+ int channels, int frames, const float * factors, bool soft_clip);
+
 /* charset.cc */
 void chardet_init ();
 void chardet_cleanup ();
@@ -64,6 +83,7 @@ Index<float> & effect_process (Index<float> & data);
 bool effect_flush (bool force);
 Index<float> & effect_finish (Index<float> & data, bool end_of_playlist);
 int effect_adjust_delay (int delay);
+void effect_cleanup ();
 
 bool effect_plugin_start (PluginHandle * plugin);
 void effect_plugin_stop (PluginHandle * plugin);
@@ -90,6 +110,54 @@ bool iface_plugin_set_current (PluginHandle * plugin);
 
 void interface_run ();
 
+/* pipeline-stats.cc */
+struct PipelineStats;
+
+enum class PipelineStage {
+    Decoder,      /* input plugin, between calls to write_audio() */
+    ProcessAudio, /* output_write_audio(), including all of the below */
+    Equalizer,
+    Convert,      /* software volume, clipping, and format conversion */
+    DeviceWrite,  /* OutputPlugin::write_audio() */
+    PeriodWait,   /* OutputPlugin::period_wait() */
+    Effect        /* EffectPlugin::process(), by position in the plugin list */
+};
+
+static constexpr int PIPELINE_MAX_EFFECTS = 16;
+
+void pipeline_stats_init ();
+void pipeline_stats_cleanup ();
+void pipeline_stats_reset ();
+
+/* returns 0 if timing is disabled, in which case pipeline_stats_finish() does
+ * nothing; this keeps the cost of a disabled timer to one atomic load */
+int64_t pipeline_stats_start ();
+void pipeline_stats_finish (PipelineStage stage, int64_t start, int effect = 0);
+void pipeline_stats_record (PipelineStage stage, int64_t ns, int effect = 0);
+
+/* fills in all but the name; returns false if nothing has been recorded */
+bool pipeline_stats_summary (PipelineStage stage, int effect, PipelineStats & stats);
+
+class StageTimer
+{
+public:
+    explicit StageTimer (PipelineStage stage, int effect = 0) :
+        m_stage (stage),
+        m_effect (effect),
+        m_start (pipeline_stats_start ()) {}
+
+    ~StageTimer ()
+        { pipeline_stats_finish (m_stage, m_start, m_effect); }
+
+    StageTimer (const StageTimer &) = delete;
+    StageTimer & operator= (const StageTimer &) = delete;
+
+private:
+    PipelineStage m_stage;
+    int m_effect;
+    int64_t m_start;
+};
+
 /* playback.cc */
 /* do not call these; use aud_drct_play/stop() instead */
 void playback_play (int seek_time, bool pause);
@@ -107,6 +175,20 @@ InputPlugin * load_input_plugin (PluginHandle * decoder, String * error = nullpt
 #define PROBE_FLAG_MIGHT_HAVE_SUBTUNES (1 << 1)
 int probe_by_filename (const char * filename);
 
+/* realtime.cc */
+bool realtime_enabled ();
+void realtime_setup_thread (const char * name);
+
+/* locked regions are remembered until realtime_unlock_memory() */
+bool realtime_lock_memory (void * data, size_t size);
+void realtime_unlock_memory ();
+
+/* render.cc */
+OutputPlugin * render_get_output ();
+void render_track_begin ();
+void render_track_end (const char * filename, int64_t frames, int rate);
+void render_cleanup ();
+
 /* runtime.cc */
 extern size_t misc_bytes_allocated;
 
@@ -144,16 +226,29 @@ struct IntHashKey
         { return int32_hash (val); }
 };
 
+/* vis-export.cc */
+void vis_export_init ();
+void vis_export_cleanup ();
+
+/* these are normally called by the exporter itself, as a visualizer; a frame
+ * with zero channels tells readers to clear their display */
+bool vis_export_open (const char * name);
+void vis_export_close ();
+void vis_export_publish (const float * pcm, int channels, const float * mono,
+ const float * freq, int64_t position_us);
+
 /* vis-runner.cc */
 void vis_runner_start_stop (bool playing, bool paused);
 void vis_runner_pass_audio (int time, const Index<float> & data, int channels, int rate);
 void vis_runner_flush ();
 void vis_runner_enable (bool enable);
+void vis_runner_cleanup ();
 
 /* visualization.cc */
 void vis_activate (bool activate);
 void vis_send_clear ();
-void vis_send_audio (const float * data, int channels);
+void vis_analyze (const float * data, int channels, float mono[512], float freq[256]);
+void vis_send_audio (const float * data, int channels, const float * mono, const float * freq);
 
 bool vis_plugin_start (PluginHandle * plugin);
 void vis_plugin_stop (PluginHandle * plugin);
@@ -20,10 +20,14 @@
 #include "output.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "audstrings.h"
+#include "drct.h"
 #include "equalizer.h"
 #include "hook.h"
 #include "i18n.h"
@@ -31,20 +35,67 @@
 #include "internal.h"
 #include "plugin.h"
 #include "plugins.h"
+#include "resampler.h"
+#include "ringbuf.h"
 #include "runtime.h"
+#include "spsc-ring.h"
 #include "threads.h"
 
 /* With Audacious 3.7, there is some support for secondary output plugins.
  * Notes and limitations:
- *  - Only one secondary output can be in use at a time.
+ *  - Any number of secondary outputs ("sinks") can be in use at a time.  Each
+ *    one records from the point in the audio chain given by "record_stream"
+ *    in the plugin's own config section, or else by the global setting.
  *  - A reduced API is used, consisting of only open_audio(), close_audio(), and
  *    write_audio().
- *  - The primary and secondary outputs are run from the same thread, with
- *    timing controlled by the primary's period_wait().  To avoid dropouts in
- *    the primary output, the secondary's write_audio() must be able to process
- *    audio faster than realtime.
- *  - The secondary's write_audio() is called in a tight loop until it has
- *    caught up to the primary, and should never return a zero byte count. */
+ *  - Each sink has its own thread, fed from a lock-free ring buffer.  A slow
+ *    sink therefore does not hold up the primary output directly.  Once its
+ *    ring buffer is full, the input thread waits up to "record_block_time"
+ *    milliseconds for space and then drops audio, counting the lost frames.
+ *  - The sink's write_audio() is called in a tight loop until it has caught
+ *    up with the ring buffer, and should never return a zero byte count.
+ *  - When a sink is closed, the audio still queued for it is written out
+ *    first. */
+
+/* With threaded output enabled, the input thread does not write to the primary
+ * output plugin directly.  Processed audio is instead queued in a lock-free
+ * ring buffer, which is emptied either by a separate output thread (using the
+ * normal write_audio() and period_wait() calls) or, for plugins that opt in to
+ * "pull" mode, by the plugin's own audio callback.  A slow decoder or effect
+ * plugin then only causes a dropout once the ring buffer has run empty.
+ *  - The output thread follows the same locking sequence as the input thread
+ *    (see below); the input thread releases the major mutex while it waits for
+ *    space in the ring buffer.
+ *  - The pull callback takes no locks at all.  Pausing, flushing, and closing
+ *    the stream are signaled through atomic variables instead. */
+
+/* An underrun is counted whenever the primary output runs dry while a song is
+ * still being decoded: in push mode, when the plugin reports no delay just
+ * before it is written to again; in pull mode, when the plugin's callback asks
+ * for more audio than is queued.  Each one triggers the "output underrun" hook.
+ *
+ * The device's own buffer ("output_buffer_size") is set up by the output
+ * plugin when it is opened and cannot be changed by us afterward.  With
+ * "output_buffer_adaptive" enabled, the decode-ahead buffer of threaded output
+ * is instead sized dynamically: it grows by half after each underrun, up to
+ * four times "output_thread_buffer", and shrinks back toward that size by an
+ * eighth after each minute without one.  The ring buffer is allocated at the
+ * largest size, and only the level to which it is filled changes. */
+
+/* Normally the primary output is reopened whenever the effect chain produces a
+ * different sample rate or channel count (for example, between songs).  With
+ * "output_fixed_format" enabled, the output instead stays open at the
+ * configured rate and channel count, and the audio is converted to it after
+ * the equalizer (see resampler.cc).  The visualizer and the secondary outputs
+ * still see the unconverted audio. */
+
+/* The most recently decoded audio (as floating point, before ReplayGain) is
+ * kept in a "seek-back cache" of "seek_cache_size" KiB (off by default).  The
+ * cache always ends at the decoder's current position, so a seek to any point
+ * within it can be served by playing the cached audio again, after which the
+ * decoder's output follows on without a break.  The decoder is not asked to
+ * seek at all.  This serves short backward seeks, A-B repeat (without even
+ * flushing the output), and repeats of a whole song that fits in the cache. */
 
 /* Locking in this module is complicated by the fact that some of the
  * output plugin functions (specifically period_wait() and drain()) are
@@ -112,11 +163,17 @@ public:
 
     void await_change (SafeLock & lock)
         { cond.wait (lock.minor); }
+    void await_change (SafeLock & lock, int ms)
+        { cond.wait_for (lock.minor, std::chrono::milliseconds (ms)); }
+
+    /* wake any thread waiting for space or data in the ring buffer */
+    void notify (SafeLock &)
+        { cond.notify_all (); }
 
 private:
     static constexpr int INPUT     = (1 << 0);  /* input plugin connected */
     static constexpr int OUTPUT    = (1 << 1);  /* primary output plugin connected */
-    static constexpr int SECONDARY = (1 << 2);  /* secondary output plugin connected */
+    static constexpr int SECONDARY = (1 << 2);  /* any secondary output plugin connected */
     static constexpr int PAUSED    = (1 << 3);  /* paused */
     static constexpr int FLUSHED   = (1 << 4);  /* flushed, writes ignored until resume */
     static constexpr int RESETTING = (1 << 5);  /* resetting output system */
@@ -139,24 +196,173 @@ private:
 static OutputState state;
 
 static OutputPlugin * cop; /* current (primary) output plugin */
-static OutputPlugin * sop; /* secondary output plugin */
+static PluginHandle * render_handle; /* plugin replaced by the render sink */
+
+struct RecordSink
+{
+    OutputPlugin * op;
+    PluginHandle * handle;
+
+    /* protected by the minor mutex; changed only with the major mutex held */
+    bool open = false;
+    OutputStream stream = OutputStream::AsDecoded;
+    int channels = 0, rate = 0;
+    RecordStats stats = RecordStats ();
 
-static OutputStream record_stream;
+    SPSCRing ring;
+    std::thread thread;
+
+    /* used only to sleep and wake up; the ring buffer itself is lock-free */
+    aud::mutex mutex;
+    aud::condvar cond;
+    bool quit = false;
+
+    RecordSink (OutputPlugin * op, PluginHandle * handle) :
+        op (op), handle (handle) {}
+};
+
+static Index<SmartPtr<RecordSink>> sinks;
 
 static int seek_time;
 static String in_filename;
 static Tuple in_tuple;
 static int in_format, in_channels, in_rate;
 static int effect_channels, effect_rate;
-static int sec_channels, sec_rate;
 static int out_format, out_channels, out_rate;
 static int out_bytes_per_sec, out_bytes_held;
 static int64_t in_frames, out_bytes_written;
 static ReplayGainInfo gain_info;
 static bool gain_info_valid;
 
+/* gain settings are cached to keep config lookups and powf() calls off the
+ * audio thread; they are recomputed only when the settings change */
+static float replay_gain_factor = 1;
+static bool sw_volume_active, soft_clip_active;
+static float sw_volume_factors[AUD_MAX_CHANNELS];
+
 static Index<float> buffer1;
 static Index<char> buffer2;
+static Index<float> buffer3, buffer4, buffer5;
+
+/* seek-back cache */
+static RingBuf<float> cache;
+static int64_t cache_end;       /* decoder position (in frames) at the end of the cache */
+static int64_t replay_pos = -1; /* position being played from the cache, or -1 */
+static int cache_hits, cache_misses;
+
+/* conversion to a fixed output format */
+static Remixer remixer;
+static Resampler resampler;
+static int conv_channels, conv_rate; /* effect format the converter is set up for */
+static bool remix_first;
+
+/* threaded output */
+static bool out_threaded, out_pull, out_pull_active;
+static SPSCRing out_ring;
+static int out_serial; /* incremented when the output is closed or reset */
+static int64_t out_bytes_pulled; /* atomic, written by pull callback */
+
+static std::thread out_thread;
+static bool out_thread_running, out_thread_quit;
+
+/* pull callbacks never block, so waits for them are done by polling */
+static constexpr int PULL_POLL_MS = 10;
+
+/* underrun accounting */
+static bool out_primed;       /* device known to be holding audio for this song */
+static bool out_pull_feeding; /* atomic, tells the pull callback to count underruns */
+static int pull_underruns;    /* atomic, written by pull callback */
+static int pull_underruns_seen;
+static UnderrunStats underrun_stats;
+
+/* adaptive decode-ahead buffer */
+static constexpr int ADAPT_MAX_FACTOR = 4;
+static constexpr int64_t ADAPT_STABLE_TIME = 60000000; /* us */
+
+static bool adaptive;
+static int base_buffer_ms, max_buffer_ms;
+static int buffer_ms;          /* current size; kept from song to song */
+static int ring_limit;         /* bytes up to which the ring buffer is filled */
+static int64_t stable_since;   /* monotonic time (us) of the last change */
+
+/* The playback clock is published by whichever thread holds the minor mutex
+ * after anything affecting it changes (normally the audio thread, after each
+ * write).  Readers take no locks: a sequence counter, odd while an update is
+ * in progress, tells them to retry if they raced with one.  Between updates,
+ * the position is extrapolated from the timestamp. */
+struct PlaybackClock
+{
+    int64_t stamp;        /* monotonic time of the update (us) */
+    int64_t in_time;      /* end of the audio received from the decoder (us) */
+    int64_t seek_time;    /* start of the audio received from the decoder (us) */
+    int64_t device_delay; /* reported by the output plugin (us) */
+    int64_t buffer_delay; /* audio queued in the output system (us) */
+    int64_t effect_delay; /* latency added by effect plugins (us) */
+    int64_t out_time;     /* end of the audio written to the output plugin (us) */
+    int64_t rate;         /* sample rate of the decoded audio */
+    int64_t flags;
+};
+
+static constexpr int CLOCK_INPUT = (1 << 0);
+static constexpr int CLOCK_OUTPUT = (1 << 1);
+static constexpr int CLOCK_RUNNING = (1 << 2);
+
+static unsigned clock_seq;
+static PlaybackClock clock_data;
+
+/* When a song ends normally, the time at which the output will run out of its
+ * audio is noted; when the next song's audio arrives, any time past that point
+ * is counted as a gap between the songs. */
+static int64_t gap_start = -1; /* monotonic time (us), or -1 */
+static GapStats gap_stats;
+
+/* Asking the effect plugins for their latency takes the effect mutex and calls
+ * into each plugin, which is too costly to do after every write.  The result
+ * changes little from one write to the next, so it is kept for a while, or
+ * until the effects are started, flushed, or finished. */
+static constexpr int64_t EFFECT_DELAY_REFRESH = 50000; /* us */
+
+static int64_t effect_delay;            /* us */
+static int64_t effect_delay_stamp = -1; /* monotonic time (us), or -1 */
+
+static int64_t monotonic_time ()
+{
+    auto now = std::chrono::steady_clock::now ().time_since_epoch ();
+    return std::chrono::duration_cast<std::chrono::microseconds> (now).count ();
+}
+
+static void write_clock (const PlaybackClock & c)
+{
+    unsigned seq = clock_seq;
+    __atomic_store_n (& clock_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    const int64_t * src = (const int64_t *) & c;
+    int64_t * dest = (int64_t *) & clock_data;
+    for (unsigned i = 0; i < sizeof c / sizeof (int64_t); i ++)
+        __atomic_store_n (& dest[i], src[i], __ATOMIC_RELAXED);
+
+    __atomic_store_n (& clock_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void read_clock (PlaybackClock & c)
+{
+    const int64_t * src = (const int64_t *) & clock_data;
+    int64_t * dest = (int64_t *) & c;
+
+    while (1)
+    {
+        unsigned seq = __atomic_load_n (& clock_seq, __ATOMIC_ACQUIRE);
+
+        for (unsigned i = 0; i < sizeof c / sizeof (int64_t); i ++)
+            dest[i] = __atomic_load_n (& src[i], __ATOMIC_RELAXED);
+
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+        if (! (seq & 1) && __atomic_load_n (& clock_seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+}
 
 static inline int get_format (bool & automatic)
 {
@@ -174,6 +380,295 @@ static inline int get_format (bool & automatic)
     }
 }
 
+static void update_replay_gain (SafeLock &)
+{
+    if (! aud_get_bool ("enable_replay_gain"))
+    {
+        replay_gain_factor = 1;
+        return;
+    }
+
+    float factor = powf (10, aud_get_double ("replay_gain_preamp") / 20);
+
+    if (gain_info_valid)
+    {
+        float peak;
+
+        auto mode = (ReplayGainMode) aud_get_int ("replay_gain_mode");
+        if ((mode == ReplayGainMode::Album) ||
+            (mode == ReplayGainMode::Automatic &&
+             (! aud_get_bool ("shuffle") || aud_get_bool ("album_shuffle"))))
+        {
+            factor *= powf (10, gain_info.album_gain / 20);
+            peak = gain_info.album_peak;
+        }
+        else
+        {
+            factor *= powf (10, gain_info.track_gain / 20);
+            peak = gain_info.track_peak;
+        }
+
+        if (aud_get_bool ("enable_clipping_prevention") && peak * factor > 1)
+            factor = 1 / peak;
+    }
+    else
+        factor *= powf (10, aud_get_double ("default_gain") / 20);
+
+    replay_gain_factor = (factor < 0.99 || factor > 1.01) ? factor : 1;
+}
+
+static void update_volume (SafeLock &)
+{
+    sw_volume_active = false;
+    soft_clip_active = aud_get_bool ("soft_clipping");
+
+    if (aud_get_bool ("software_volume_control") && state.output ())
+    {
+        StereoVolume v = {aud_get_int ("sw_volume_left"), aud_get_int ("sw_volume_right")};
+        sw_volume_active = audio_volume_factors (v, out_channels, sw_volume_factors);
+    }
+}
+
+static int64_t get_bytes_written ()
+{
+    return out_bytes_written + __atomic_load_n (& out_bytes_pulled, __ATOMIC_RELAXED);
+}
+
+/* device_delay is passed in (in milliseconds) if it is already known */
+static void publish_clock (SafeLock &, int device_delay = -1)
+{
+    PlaybackClock c = PlaybackClock ();
+
+    c.stamp = monotonic_time ();
+
+    if (state.input ())
+    {
+        c.flags |= CLOCK_INPUT;
+        c.rate = in_rate;
+        c.seek_time = (int64_t) seek_time * 1000;
+        c.in_time = c.seek_time + aud::rescale<int64_t> (in_frames, in_rate, 1000000);
+    }
+
+    if (state.output ())
+    {
+        c.flags |= CLOCK_OUTPUT;
+        if (! state.paused ())
+            c.flags |= CLOCK_RUNNING;
+
+        if (device_delay < 0)
+            device_delay = cop->get_delay ();
+
+        c.device_delay = (int64_t) device_delay * 1000;
+        c.buffer_delay = aud::rescale<int64_t> (out_bytes_held + out_ring.len (),
+         out_bytes_per_sec, 1000000);
+        c.out_time = aud::rescale<int64_t> (get_bytes_written (), out_bytes_per_sec, 1000000);
+
+        if (! resampler.passthrough ())
+            c.buffer_delay += aud::rescale<int64_t> (resampler.latency (), conv_rate, 1000000);
+    }
+
+    if (state.input ())
+    {
+        if (effect_delay_stamp < 0 || c.stamp - effect_delay_stamp >= EFFECT_DELAY_REFRESH)
+        {
+            /* effect plugins work in whole milliseconds */
+            int delay = (c.device_delay + c.buffer_delay) / 1000;
+            effect_delay = (int64_t) (effect_adjust_delay (delay) - delay) * 1000;
+            effect_delay_stamp = c.stamp;
+        }
+
+        c.effect_delay = effect_delay;
+    }
+
+    write_clock (c);
+}
+
+static void update_pull (SafeLock &)
+{
+    bool active = state.output () && out_pull && ! state.paused ();
+    __atomic_store_n (& out_pull_active, active, __ATOMIC_RELEASE);
+
+    if (! active)
+        __atomic_store_n (& out_pull_feeding, false, __ATOMIC_RELAXED);
+}
+
+/* sets the size of the decode-ahead buffer, within the allowed range */
+static void set_buffer_size (SafeLock &, int ms)
+{
+    buffer_ms = aud::clamp (ms, base_buffer_ms, max_buffer_ms);
+    stable_since = monotonic_time ();
+
+    int frame_size = FMT_SIZEOF (out_format) * out_channels;
+    int frames = aud::max (aud::rescale (buffer_ms, 1000, out_rate), 1);
+    ring_limit = aud::min (frame_size * frames, out_ring.size ());
+}
+
+static void note_underruns (SafeLock & lock, int count)
+{
+    underrun_stats.underruns += count;
+    event_queue ("output underrun", nullptr);
+
+    if (adaptive && buffer_ms < max_buffer_ms)
+    {
+        set_buffer_size (lock, buffer_ms + buffer_ms / 2);
+        AUDINFO ("Output underrun, buffer increased to %d ms.\n", buffer_ms);
+    }
+    else
+    {
+        stable_since = monotonic_time ();
+        AUDINFO ("Output underrun.\n");
+    }
+}
+
+/* called by the input thread before queuing audio for threaded output */
+static void adapt_buffer (SafeLock & lock)
+{
+    if (out_pull)
+    {
+        int count = __atomic_load_n (& pull_underruns, __ATOMIC_RELAXED);
+        if (count != pull_underruns_seen)
+        {
+            note_underruns (lock, count - pull_underruns_seen);
+            pull_underruns_seen = count;
+        }
+    }
+
+    if (adaptive && buffer_ms > base_buffer_ms &&
+     monotonic_time () - stable_since > ADAPT_STABLE_TIME)
+    {
+        set_buffer_size (lock, buffer_ms - aud::max (buffer_ms / 8, 1));
+        AUDINFO ("No output underruns, buffer decreased to %d ms.\n", buffer_ms);
+    }
+}
+
+/* the output plugin is called through these so that its time is recorded;
+ * before each write, we check whether the device has run dry (push mode) */
+static int device_write (SafeLock & lock, const void * data, int len, int & delay_after)
+{
+    int delay = cop->get_delay ();
+
+    if (! delay && out_primed && state.input () && ! state.paused ())
+        note_underruns (lock, 1);
+
+    StageTimer timer (PipelineStage::DeviceWrite);
+    int written = cop->write_audio (data, len);
+
+    /* plugins that never report a delay (such as the render sink) are never
+     * considered to have run dry */
+    if (written > 0 && delay > 0)
+        out_primed = true;
+
+    /* saves asking the plugin again for the playback clock */
+    delay_after = delay + aud::rescale (aud::max (written, 0), out_bytes_per_sec, 1000);
+
+    return written;
+}
+
+static void device_wait ()
+{
+    StageTimer timer (PipelineStage::PeriodWait);
+    cop->period_wait ();
+}
+
+/* passes queued audio to the output plugin (push mode only);
+ * returns false if the plugin could not take all of it */
+static bool write_from_ring (SafeLock & lock)
+{
+    const void * data;
+    int len = out_ring.peek (& data);
+    int delay;
+    int written = device_write (lock, data, len, delay);
+
+    out_ring.consume (written);
+    out_bytes_written += written;
+    publish_clock (lock, delay);
+
+    return written == len;
+}
+
+/* waits until the ring buffer has been emptied; since the major mutex is held,
+ * the output thread is not running and the queued data is written here */
+static void drain_ring (UnsafeLock & lock)
+{
+    while (out_ring.len () && ! state.paused ())
+    {
+        if (out_pull)
+            state.await_change (lock, PULL_POLL_MS);
+        else if (! write_from_ring (lock))
+        {
+            lock.minor.unlock ();
+            device_wait ();
+            lock.minor.lock ();
+        }
+    }
+}
+
+static void output_thread ()
+{
+    realtime_setup_thread ("Output");
+
+    auto lock = state.lock_safe ();
+
+    while (! out_thread_quit)
+    {
+        if (! state.output () || ! out_threaded || out_pull ||
+         state.paused () || ! out_ring.len ())
+        {
+            state.await_change (lock);
+            continue;
+        }
+
+        /* the major mutex must be locked first */
+        lock.minor.unlock ();
+
+        {
+            auto lock2 = state.lock_unsafe ();
+
+            /* recheck; the output may have changed meanwhile */
+            if (state.output () && out_threaded && ! out_pull &&
+             ! state.paused () && out_ring.len ())
+            {
+                bool done = write_from_ring (lock2);
+                state.notify (lock2);
+
+                if (! done)
+                {
+                    lock2.minor.unlock ();
+                    device_wait ();
+                    lock2.minor.lock ();
+                }
+            }
+        }
+
+        lock.minor.lock ();
+    }
+}
+
+static void start_output_thread (SafeLock &)
+{
+    if (out_thread_running)
+        return;
+
+    out_thread_quit = false;
+    out_thread = std::thread (output_thread);
+    out_thread_running = true;
+}
+
+static void stop_output_thread ()
+{
+    auto lock = state.lock_safe ();
+
+    if (! out_thread_running)
+        return;
+
+    out_thread_quit = true;
+    state.notify (lock);
+    lock.minor.unlock ();
+
+    out_thread.join ();
+    out_thread_running = false;
+}
+
 static void setup_effects (SafeLock &)
 {
     assert (state.input ());
@@ -183,6 +678,7 @@ static void setup_effects (SafeLock &)
 
     effect_start (effect_channels, effect_rate);
     eq_set_format (effect_channels, effect_rate);
+    effect_delay_stamp = -1;
 }
 
 static void cleanup_output (UnsafeLock & lock)
@@ -190,9 +686,12 @@ static void cleanup_output (UnsafeLock & lock)
     if (! state.output ())
         return;
 
+    if (out_threaded)
+        drain_ring (lock);
+
     // avoid locking up if the input thread reaches close_audio() while
     // paused (unlikely but possible with perfect timing)
-    if (out_bytes_written && ! state.paused ())
+    if (get_bytes_written () && ! state.paused ())
     {
         lock.minor.unlock ();
         cop->drain ();
@@ -200,21 +699,86 @@ static void cleanup_output (UnsafeLock & lock)
     }
 
     state.set_output (lock, false);
+    update_pull (lock);
+    publish_clock (lock);
+    out_serial ++;
+
+    realtime_unlock_memory ();
 
     buffer1.clear ();
     buffer2.clear ();
+    buffer3.clear ();
+    buffer4.clear ();
+    buffer5.clear ();
+    conv_channels = conv_rate = 0;
 
     cop->close_audio ();
+    out_ring.destroy ();
     vis_runner_start_stop (false, false);
 }
 
-static void cleanup_secondary (SafeLock & lock)
+static void sink_thread (RecordSink * sink)
+{
+    int frame_size = sizeof (float) * sink->channels;
+    auto mh = sink->mutex.take ();
+
+    while (1)
+    {
+        const void * data;
+        int len;
+
+        while (! (len = sink->ring.peek (& data)) && ! sink->quit)
+            sink->cond.wait (mh);
+
+        /* when closing, exit only once all queued audio is written */
+        if (! len)
+            break;
+
+        mh.unlock ();
+
+        /* offer whole frames; only if the plugin took part of a frame last
+         * time can less than a frame be left before the end of the ring */
+        if (len >= frame_size)
+            len -= len % frame_size;
+
+        int written = sink->op->write_audio (data, len);
+        sink->ring.consume (written);
+
+        mh.lock ();
+        sink->cond.notify_all ();
+    }
+}
+
+static void close_sink (UnsafeLock &, RecordSink * sink)
+{
+    if (! sink->open)
+        return;
+
+    {
+        auto mh = sink->mutex.take ();
+        sink->quit = true;
+        sink->cond.notify_all ();
+    }
+
+    sink->thread.join ();
+    sink->op->close_audio ();
+    sink->ring.destroy ();
+    sink->open = false;
+
+    if (sink->stats.dropped_frames)
+        AUDWARN ("%s fell behind, %" PRId64 " frames dropped.\n",
+         aud_plugin_get_name (sink->handle), sink->stats.dropped_frames);
+}
+
+static void cleanup_secondary (UnsafeLock & lock)
 {
     if (! state.secondary ())
         return;
 
+    for (auto & sink : sinks)
+        close_sink (lock, sink.get ());
+
     state.set_secondary (lock, false);
-    sop->close_audio ();
 }
 
 static void apply_pause (SafeLock & lock, bool pause, bool new_output = false)
@@ -228,7 +792,13 @@ static void apply_pause (SafeLock & lock, bool pause, bool new_output = false)
         vis_runner_start_stop (true, pause);
     }
 
+    /* some plugins discard their buffer when paused */
+    if (pause != state.paused ())
+        out_primed = false;
+
     state.set_paused (lock, pause);
+    update_pull (lock);
+    publish_clock (lock);
 }
 
 static bool open_audio_with_info (OutputPlugin * op, const char * filename,
@@ -238,6 +808,64 @@ static bool open_audio_with_info (OutputPlugin * op, const char * filename,
     return op->open_audio (format, rate, chans, error);
 }
 
+static void setup_conversion (SafeLock &)
+{
+    /* keep the filter history across songs in the same format */
+    if (effect_channels == conv_channels && effect_rate == conv_rate)
+        return;
+
+    conv_channels = effect_channels;
+    conv_rate = effect_rate;
+
+    /* downmix before resampling, or upmix after, to resample fewer channels */
+    remix_first = (out_channels < effect_channels);
+    remixer.setup (effect_channels, out_channels);
+    resampler.setup (remix_first ? out_channels : effect_channels, effect_rate, out_rate);
+
+    if (! remixer.passthrough () || ! resampler.passthrough ())
+        AUDINFO ("Converting %d channels, %d Hz to %d channels, %d Hz.\n",
+         effect_channels, effect_rate, out_channels, out_rate);
+}
+
+/* The work buffers are allocated up front at a size that should be enough for
+ * any block of audio, so that they need not be reallocated while playing.  In
+ * real-time mode, they are also locked into memory along with the ring buffer
+ * (see realtime.cc).  A buffer that must grow later will be moved to unlocked
+ * memory, but that should be rare. */
+static constexpr int RESERVED_BUFFER_MS = 500;
+
+template<class T>
+static size_t reserve_buffer (Index<T> & buffer, int len, bool lock)
+{
+    buffer.resize (len);
+
+    bool locked = lock && realtime_lock_memory (buffer.begin (), sizeof (T) * len);
+    buffer.resize (0); /* keeps the memory allocated */
+
+    return locked ? sizeof (T) * len : 0;
+}
+
+static void reserve_buffers (SafeLock &)
+{
+    bool lock = realtime_enabled ();
+
+    int channels = aud::max (in_channels, aud::max (effect_channels, out_channels));
+    int rate = aud::max (in_rate, aud::max (effect_rate, out_rate));
+    int samples = channels * aud::rescale (RESERVED_BUFFER_MS, 1000, rate);
+
+    size_t locked = reserve_buffer (buffer1, samples, lock) +
+     reserve_buffer (buffer2, samples * FMT_SIZEOF (out_format), lock) +
+     reserve_buffer (buffer3, samples, lock) +
+     reserve_buffer (buffer4, samples, lock) +
+     reserve_buffer (buffer5, samples, lock);
+
+    if (lock && out_threaded && realtime_lock_memory (out_ring.buffer (), out_ring.size ()))
+        locked += out_ring.size ();
+
+    if (locked)
+        AUDINFO ("Locked %d KiB of audio buffers in memory.\n", (int) (locked >> 10));
+}
+
 static void setup_output (UnsafeLock & lock, bool new_input, bool pause)
 {
     assert (state.input ());
@@ -248,21 +876,35 @@ static void setup_output (UnsafeLock & lock, bool new_input, bool pause)
     bool automatic;
     int format = get_format (automatic);
 
-    if (state.output () && effect_channels == out_channels &&
-     effect_rate == out_rate && ! (new_input && cop->force_reopen))
+    int channels = effect_channels;
+    int rate = effect_rate;
+
+    if (aud_get_bool ("output_fixed_format"))
+    {
+        channels = aud::clamp (aud_get_int ("output_fixed_channels"), 1, AUD_MAX_CHANNELS);
+        rate = aud::clamp (aud_get_int ("output_fixed_rate"), 8000, 384000);
+    }
+
+    if (state.output () && channels == out_channels && rate == out_rate &&
+     ! (new_input && cop->force_reopen))
     {
-        AUDINFO ("Reuse output, %d channels, %d Hz.\n", effect_channels, effect_rate);
+        AUDINFO ("Reuse output, %d channels, %d Hz.\n", channels, rate);
+        setup_conversion (lock);
         apply_pause (lock, pause);
         return;
     }
 
-    AUDINFO ("Setup output, format %d, %d channels, %d Hz.\n", format, effect_channels, effect_rate);
+    AUDINFO ("Setup output, format %d, %d channels, %d Hz.\n", format, channels, rate);
 
     cleanup_output (lock);
 
+    out_threaded = aud_get_bool ("output_thread");
+    bool pull = (cop->version >= 49 && cop->use_pull_mode (out_threaded));
+    out_pull = out_threaded && pull;
+
     String error;
     while (! open_audio_with_info (cop, in_filename, in_tuple, format,
-     effect_rate, effect_channels, error))
+     rate, channels, error))
     {
         if (automatic && format == FMT_FLOAT)
             format = FMT_S32_NE;
@@ -282,27 +924,59 @@ static void setup_output (UnsafeLock & lock, bool new_input, bool pause)
     state.set_output (lock, true);
 
     out_format = format;
-    out_channels = effect_channels;
-    out_rate = effect_rate;
+    out_channels = channels;
+    out_rate = rate;
+
+    setup_conversion (lock);
 
     out_bytes_per_sec = FMT_SIZEOF (format) * out_channels * out_rate;
     out_bytes_held = 0;
     out_bytes_written = 0;
+    __atomic_store_n (& out_bytes_pulled, 0, __ATOMIC_RELAXED);
+
+    out_primed = false;
+
+    if (out_threaded)
+    {
+        adaptive = aud_get_bool ("output_buffer_adaptive");
+        base_buffer_ms = aud::max (aud_get_int ("output_thread_buffer"), 1);
+        max_buffer_ms = adaptive ? base_buffer_ms * ADAPT_MAX_FACTOR : base_buffer_ms;
+
+        /* keep the ring buffer a whole number of frames */
+        int frame_size = FMT_SIZEOF (format) * out_channels;
+        int frames = aud::rescale (max_buffer_ms, 1000, out_rate);
+        out_ring.alloc (frame_size * aud::max (frames, 1));
+
+        set_buffer_size (lock, buffer_ms ? buffer_ms : base_buffer_ms);
+
+        AUDINFO ("Threaded output (%s mode), %d ms buffer%s.\n", out_pull ?
+         "pull" : "push", buffer_ms, adaptive ? " (adaptive)" : "");
+
+        if (! out_pull)
+            start_output_thread (lock);
+    }
+
+    reserve_buffers (lock);
 
+    update_volume (lock);
     apply_pause (lock, pause, true);
 }
 
-static void setup_secondary (SafeLock & lock, bool new_input)
+static OutputStream get_record_stream (PluginHandle * handle)
 {
-    assert (state.input ());
+    /* a per-plugin setting overrides the global one */
+    const char * section = aud_plugin_get_basename (handle);
+    String stream = aud_get_str (section, "record_stream");
 
-    if (! sop)
-        return;
+    return (OutputStream) (stream[0] ? str_to_int (stream) : aud_get_int ("record_stream"));
+}
 
+static void setup_sink (UnsafeLock & lock, RecordSink * sink, bool new_input)
+{
     int rate, channels;
-    record_stream = (OutputStream) aud_get_int ("record_stream");
+    auto stream = get_record_stream (sink->handle);
 
-    if (record_stream < OutputStream::AfterEffects)
+    if (stream < OutputStream::AfterEffects)
     {
         rate = in_rate;
         channels = in_channels;
@@ -313,120 +987,291 @@ static void setup_secondary (SafeLock & lock, bool new_input)
         channels = effect_channels;
     }
 
-    if (state.secondary () && channels == sec_channels && rate == sec_rate &&
-     ! (new_input && sop->force_reopen))
+    /* switching to another point with the same format needs no reopen */
+    if (sink->open && channels == sink->channels && rate == sink->rate &&
+     ! (new_input && sink->op->force_reopen))
+    {
+        sink->stream = stream;
         return;
+    }
 
-    cleanup_secondary (lock);
+    close_sink (lock, sink);
 
     String error;
-    if (! open_audio_with_info (sop, in_filename, in_tuple, FMT_FLOAT, rate, channels, error))
+    if (! open_audio_with_info (sink->op, in_filename, in_tuple, FMT_FLOAT, rate, channels, error))
     {
         aud_ui_show_error (error ? (const char *) error : _("Error recording output stream"));
         return;
     }
 
-    state.set_secondary (lock, true);
+    sink->open = true;
+    sink->stream = stream;
+    sink->channels = channels;
+    sink->rate = rate;
+    sink->stats = RecordStats ();
+
+    /* keep the ring buffer a whole number of frames */
+    int frames = aud::rescale (aud_get_int ("record_buffer"), 1000, rate);
+    sink->ring.alloc (sizeof (float) * channels * aud::max (frames, 1));
 
-    sec_channels = channels;
-    sec_rate = rate;
+    sink->quit = false;
+    sink->thread = std::thread (sink_thread, sink);
 }
 
-static void flush_output (SafeLock &)
+static void setup_secondary (UnsafeLock & lock, bool new_input)
+{
+    assert (state.input ());
+
+    bool any = false;
+
+    for (auto & sink : sinks)
+    {
+        setup_sink (lock, sink.get (), new_input);
+        any = any || sink->open;
+    }
+
+    state.set_secondary (lock, any);
+}
+
+static void flush_output (SafeLock & lock)
 {
     assert (state.output ());
 
     out_bytes_held = 0;
     out_bytes_written = 0;
+    __atomic_store_n (& out_bytes_pulled, 0, __ATOMIC_RELAXED);
+
+    out_primed = false;
+    __atomic_store_n (& out_pull_feeding, false, __ATOMIC_RELAXED);
+
+    if (out_threaded)
+    {
+        out_ring.discard ();
+        /* in push mode the ring buffer is only read with the minor mutex
+         * held, so the discarded space can be reclaimed right away */
+        if (! out_pull)
+            out_ring.consume (0);
+    }
+
+    resampler.reset ();
 
     cop->flush ();
     vis_runner_flush ();
+
+    /* the effects have been flushed along with the output */
+    effect_delay_stamp = -1;
+    publish_clock (lock);
 }
 
 static void apply_replay_gain (SafeLock &, Index<float> & data)
 {
-    if (! aud_get_bool ("enable_replay_gain"))
-        return;
+    if (replay_gain_factor != 1)
+        audio_amplify (data.begin (), 1, data.len (), & replay_gain_factor);
+}
 
-    float factor = powf (10, aud_get_double ("replay_gain_preamp") / 20);
+/* writes as many whole frames as there is space for */
+static int write_sink_frames (RecordSink * sink, const char * data, int len)
+{
+    int frame_size = sizeof (float) * sink->channels;
+    int space = sink->ring.space () / frame_size * frame_size;
 
-    if (gain_info_valid)
+    return sink->ring.write (data, aud::min (len, space));
+}
+
+static void write_sink (UnsafeLock & lock, RecordSink * sink, const Index<float> & data)
+{
+    auto begin = (const char *) data.begin ();
+    int size = sizeof (float) * data.len ();
+    int written = write_sink_frames (sink, begin, size);
+
+    if (written < size)
     {
-        float peak;
+        int block_time = aud_get_int ("record_block_time");
 
-        auto mode = (ReplayGainMode) aud_get_int ("replay_gain_mode");
-        if ((mode == ReplayGainMode::Album) ||
-            (mode == ReplayGainMode::Automatic &&
-             (! aud_get_bool ("shuffle") || aud_get_bool ("album_shuffle"))))
-        {
-            factor *= powf (10, gain_info.album_gain / 20);
-            peak = gain_info.album_peak;
-        }
-        else
+        if (block_time > 0)
         {
-            factor *= powf (10, gain_info.track_gain / 20);
-            peak = gain_info.track_peak;
+            /* safe operations can proceed while we wait; the sink cannot go
+             * away since the major mutex is held */
+            lock.minor.unlock ();
+
+            auto deadline = std::chrono::steady_clock::now () +
+             std::chrono::milliseconds (block_time);
+            auto mh = sink->mutex.take ();
+
+            while (1)
+            {
+                written += write_sink_frames (sink, begin + written, size - written);
+                if (written == size)
+                    break;
+
+                sink->cond.notify_all ();
+
+                if (sink->cond.wait_until (mh, deadline) == std::cv_status::timeout)
+                {
+                    /* use whatever space was freed by the time we gave up */
+                    written += write_sink_frames (sink, begin + written, size - written);
+                    break;
+                }
+            }
+
+            mh.unlock ();
+            lock.minor.lock ();
         }
+    }
 
-        if (aud_get_bool ("enable_clipping_prevention") && peak * factor > 1)
-            factor = 1 / peak;
+    if (written)
+    {
+        auto mh = sink->mutex.take ();
+        sink->cond.notify_all ();
     }
-    else
-        factor *= powf (10, aud_get_double ("default_gain") / 20);
 
-    if (factor < 0.99 || factor > 1.01)
-        audio_amplify (data.begin (), 1, data.len (), & factor);
+    int frame_size = sizeof (float) * sink->channels;
+    int bytes_per_sec = frame_size * sink->rate;
+    int lag = aud::rescale (sink->ring.len (), bytes_per_sec, 1000);
+
+    sink->stats.dropped_frames += (size - written) / frame_size;
+    sink->stats.max_lag = aud::max (sink->stats.max_lag, lag);
 }
 
-static void write_secondary (SafeLock &, const Index<float> & data)
+static void write_secondary (UnsafeLock & lock, OutputStream stream, const Index<float> & data)
 {
     assert (state.secondary ());
 
-    auto begin = (const char *) data.begin ();
-    auto end = (const char *) data.end ();
+    for (auto & sink : sinks)
+    {
+        if (sink->open && sink->stream == stream)
+            write_sink (lock, sink.get (), data);
+    }
+}
+
+static void queue_output (UnsafeLock & lock, const void * out_data)
+{
+    int serial = out_serial;
+
+    adapt_buffer (lock);
+
+    while (out_bytes_held && ! state.resetting ())
+    {
+        int room = aud::max (ring_limit - out_ring.len (), 0);
+        int written = out_ring.write (out_data, aud::min (out_bytes_held, room));
+
+        out_data = (const char *) out_data + written;
+        out_bytes_held -= written;
+
+        if (written)
+        {
+            state.notify (lock);
+            publish_clock (lock);
+
+            /* the callback may count underruns once the song is underway */
+            if (out_pull && state.input () && ! state.paused ())
+                __atomic_store_n (& out_pull_feeding, true, __ATOMIC_RELAXED);
+        }
+
+        if (! out_bytes_held)
+            break;
+
+        // avoid locking up if the input thread reaches close_audio() while
+        // paused (unlikely but possible with perfect timing)
+        if (state.paused () && ! state.input ())
+            break;
+
+        /* wait for space without holding up the output thread */
+        lock.major.unlock ();
+
+        if (out_pull)
+            state.await_change (lock, PULL_POLL_MS);
+        else
+            state.await_change (lock);
+
+        lock.minor.unlock ();
+        lock.major.lock ();
+        lock.minor.lock ();
+
+        /* the data queued so far is gone if the output was closed or reset */
+        if (! state.output () || out_serial != serial)
+            break;
+    }
+}
+
+static Index<float> & convert_output (SafeLock &, Index<float> & data)
+{
+    Index<float> * cur = & data;
+
+    if (remix_first && ! remixer.passthrough ())
+    {
+        remixer.process (cur->begin (), cur->len () / effect_channels, buffer3);
+        cur = & buffer3;
+    }
+
+    if (! resampler.passthrough ())
+    {
+        int channels = remix_first ? out_channels : effect_channels;
+        resampler.process (cur->begin (), cur->len () / channels, buffer4);
+        cur = & buffer4;
+    }
+
+    if (! remix_first && ! remixer.passthrough ())
+    {
+        remixer.process (cur->begin (), cur->len () / effect_channels, buffer3);
+        cur = & buffer3;
+    }
 
-    while (begin < end)
-        begin += sop->write_audio (begin, end - begin);
+    return * cur;
 }
 
-static void write_output (UnsafeLock & lock, Index<float> & data)
+static void write_output (UnsafeLock & lock, Index<float> & in_data)
 {
     assert (state.output ());
 
-    if (! data.len ())
-        return;
+    int serial = out_serial;
 
-    if (state.secondary () && record_stream == OutputStream::AfterEffects)
-        write_secondary (lock, data);
+    if (! in_data.len ())
+        return;
 
-    int out_time = aud::rescale<int64_t> (out_bytes_written, out_bytes_per_sec, 1000);
-    vis_runner_pass_audio (out_time, data, out_channels, out_rate);
+    if (state.secondary ())
+        write_secondary (lock, OutputStream::AfterEffects, in_data);
 
-    eq_filter (data.begin (), data.len ());
+    int64_t out_bytes = get_bytes_written () + out_ring.len ();
+    int out_time = aud::rescale<int64_t> (out_bytes, out_bytes_per_sec, 1000);
+    vis_runner_pass_audio (out_time, in_data, effect_channels, effect_rate);
 
-    if (state.secondary () && record_stream == OutputStream::AfterEqualizer)
-        write_secondary (lock, data);
+    eq_filter (in_data.begin (), in_data.len ());
 
-    if (aud_get_bool ("software_volume_control"))
-    {
-        StereoVolume v = {aud_get_int ("sw_volume_left"), aud_get_int ("sw_volume_right")};
-        audio_amplify (data.begin (), out_channels, data.len () / out_channels, v);
-    }
+    if (state.secondary ())
+        write_secondary (lock, OutputStream::AfterEqualizer, in_data);
 
-    if (aud_get_bool ("soft_clipping"))
-        audio_soft_clip (data.begin (), data.len ());
+    Index<float> & data = convert_output (lock, in_data);
+    if (! data.len ())
+        return;
 
     const void * out_data = data.begin ();
+    const float * factors = sw_volume_active ? sw_volume_factors : nullptr;
 
+    /* software volume, soft clipping, and format conversion in one pass */
     if (out_format != FMT_FLOAT)
     {
+        StageTimer timer (PipelineStage::Convert);
         buffer2.resize (FMT_SIZEOF (out_format) * data.len ());
-        audio_to_int (data.begin (), buffer2.begin (), out_format, data.len ());
+        audio_amplify_convert (data.begin (), buffer2.begin (), out_format,
+         out_channels, data.len () / out_channels, factors, soft_clip_active);
         out_data = buffer2.begin ();
     }
+    else if (factors || soft_clip_active)
+    {
+        StageTimer timer (PipelineStage::Convert);
+        audio_amplify_convert (data.begin (), data.begin (), FMT_FLOAT,
+         out_channels, data.len () / out_channels, factors, soft_clip_active);
+    }
 
     out_bytes_held = FMT_SIZEOF (out_format) * data.len ();
 
+    if (out_threaded)
+    {
+        queue_output (lock, out_data);
+        return;
+    }
+
     while (out_bytes_held && ! state.resetting ())
     {
         if (state.paused ())
@@ -436,30 +1281,121 @@ static void write_output (UnsafeLock & lock, Index<float> & data)
             if (! state.input ())
                 break;
 
+            /* wait without holding the major mutex, so that the secondary
+             * outputs can still be changed from the main thread */
+            lock.major.unlock ();
             state.await_change (lock);
+
+            lock.minor.unlock ();
+            lock.major.lock ();
+            lock.minor.lock ();
+
+            /* the data held so far is gone if the output was closed or reset */
+            if (! state.output () || out_serial != serial)
+                break;
+
             continue;
         }
 
-        int written = cop->write_audio (out_data, out_bytes_held);
+        int delay;
+        int written = device_write (lock, out_data, out_bytes_held, delay);
 
         out_data = (const char *) out_data + written;
         out_bytes_held -= written;
         out_bytes_written += written;
+        publish_clock (lock, delay);
 
         if (! out_bytes_held)
             break;
 
         lock.minor.unlock ();
-        cop->period_wait ();
+        device_wait ();
         lock.minor.lock ();
     }
 }
 
-static bool process_audio (UnsafeLock & lock, const void * data, int size, int stop_time)
+static void mark_gap_start (SafeLock &)
 {
-    assert (state.input () && state.output ());
+    PlaybackClock c;
+    read_clock (c);
 
-    int samples = size / FMT_SIZEOF (in_format);
+    if (! (c.flags & CLOCK_RUNNING) || aud_get_render_mode ())
+        return;
+
+    gap_start = c.stamp + c.device_delay + c.buffer_delay;
+}
+
+static void measure_gap (SafeLock &)
+{
+    int64_t gap = aud::max ((int64_t) 0, monotonic_time () - gap_start);
+    int64_t frames = aud::rescale<int64_t> (gap, 1000000, out_rate);
+
+    gap_stats.transitions ++;
+    gap_stats.last_gap = frames;
+    gap_stats.max_gap = aud::max (gap_stats.max_gap, frames);
+    gap_stats.total_gap += frames;
+    gap_stats.rate = out_rate;
+
+    AUDINFO ("Gap between songs: %d frames (%d ms).\n", (int) frames, (int) (gap / 1000));
+
+    gap_start = -1;
+}
+
+/* chunk size used when replaying from the cache */
+static constexpr int REPLAY_FRAMES = 4096;
+
+static void setup_cache (SafeLock &)
+{
+    /* keep the cache a whole number of frames */
+    int64_t bytes = (int64_t) aud::max (aud_get_int ("seek_cache_size"), 0) * 1024;
+    int size = aud::min<int64_t> (bytes / sizeof (float), INT_MAX) / in_channels * in_channels;
+
+    cache.discard ();
+
+    if (size != cache.size ())
+    {
+        if (size)
+            cache.alloc (size);
+        else
+            cache.destroy ();
+    }
+
+    cache_end = aud::rescale<int64_t> (seek_time, 1000, in_rate);
+    replay_pos = -1;
+}
+
+static void reset_cache (SafeLock &, int time)
+{
+    cache.discard ();
+    cache_end = aud::rescale<int64_t> (time, 1000, in_rate);
+    replay_pos = -1;
+}
+
+static void cache_audio (SafeLock &, const Index<float> & data)
+{
+    cache_end += data.len () / in_channels;
+
+    if (! cache.size ())
+        return;
+
+    int len = aud::min (data.len (), cache.size ());
+    int excess = cache.len () + len - cache.size ();
+
+    if (excess > 0)
+        cache.discard (excess);
+
+    cache.copy_in (& data[data.len () - len], len);
+
+    /* an interrupted replay may have lost its place */
+    int64_t start = cache_end - cache.len () / in_channels;
+    if (replay_pos >= 0 && replay_pos < start)
+        replay_pos = start;
+}
+
+/* audio is in buffer1 or buffer5, already converted to floating point */
+static bool process_float (UnsafeLock & lock, Index<float> & data, int stop_time)
+{
+    int samples = data.len ();
     bool stopped = false;
 
     if (stop_time != -1)
@@ -476,6 +1412,69 @@ static bool process_audio (UnsafeLock & lock, const void * data, int size, int s
 
     in_frames += samples / in_channels;
 
+    data.resize (samples);
+
+    if (state.secondary ())
+        write_secondary (lock, OutputStream::AsDecoded, data);
+
+    apply_replay_gain (lock, data);
+
+    if (state.secondary ())
+        write_secondary (lock, OutputStream::AfterReplayGain, data);
+
+    write_output (lock, effect_process (data));
+    publish_clock (lock);
+
+    return ! stopped;
+}
+
+/* plays the cache from replay_pos to the end; returns false if stop_time was
+ * reached or the output was flushed, and leaves replay_pos set if the output
+ * went away before the replay was finished */
+static bool replay_cache (UnsafeLock & lock, int stop_time)
+{
+    while (replay_pos >= 0)
+    {
+        if (state.flushed ())
+            return false;
+        if (! state.output () || state.resetting ())
+            break;
+
+        int64_t start = cache_end - cache.len () / in_channels;
+        int frames = aud::min (cache_end - replay_pos, (int64_t) REPLAY_FRAMES);
+
+        if (frames <= 0)
+        {
+            replay_pos = -1;
+            break;
+        }
+
+        buffer5.resize (frames * in_channels);
+        cache.copy_out ((replay_pos - start) * in_channels, buffer5.begin (), buffer5.len ());
+
+        replay_pos += frames;
+
+        if (! process_float (lock, buffer5, stop_time))
+        {
+            replay_pos = -1;
+            return false;
+        }
+    }
+
+    return ! state.flushed ();
+}
+
+static bool process_audio (UnsafeLock & lock, const void * data, int size, int stop_time)
+{
+    assert (state.input () && state.output ());
+
+    StageTimer timer (PipelineStage::ProcessAudio);
+
+    if (gap_start >= 0)
+        measure_gap (lock);
+
+    int samples = size / FMT_SIZEOF (in_format);
+
     buffer1.resize (samples);
 
     if (in_format == FMT_FLOAT)
@@ -483,17 +1482,25 @@ static bool process_audio (UnsafeLock & lock, const void * data, int size, int s
     else
         audio_from_int (data, in_format, buffer1.begin (), samples);
 
-    if (state.secondary () && record_stream == OutputStream::AsDecoded)
-        write_secondary (lock, buffer1);
+    /* a seek into the cache is pending; the new audio follows the cached
+     * audio, so it is added to the cache and played afterward */
+    if (replay_pos >= 0)
+    {
+        bool more = replay_cache (lock, stop_time);
 
-    apply_replay_gain (lock, buffer1);
+        /* after a normal seek, the new audio is no longer wanted */
+        if (state.flushed ())
+            return false;
 
-    if (state.secondary () && record_stream == OutputStream::AfterReplayGain)
-        write_secondary (lock, buffer1);
+        cache_audio (lock, buffer1);
 
-    write_output (lock, effect_process (buffer1));
+        if (! more || replay_pos >= 0)
+            return more;
+    }
+    else
+        cache_audio (lock, buffer1);
 
-    return ! stopped;
+    return process_float (lock, buffer1, stop_time);
 }
 
 static void finish_effects (UnsafeLock & lock, bool end_of_playlist)
@@ -502,6 +1509,7 @@ static void finish_effects (UnsafeLock & lock, bool end_of_playlist)
 
     buffer1.resize (0);
     write_output (lock, effect_finish (buffer1, end_of_playlist));
+    effect_delay_stamp = -1;
 }
 
 bool output_open_audio (const String & filename, const Tuple & tuple,
@@ -518,6 +1526,7 @@ bool output_open_audio (const String & filename, const Tuple & tuple,
 
     seek_time = start_time;
     gain_info_valid = false;
+    update_replay_gain (lock);
 
     in_filename = filename;
     in_tuple = tuple.ref ();
@@ -526,12 +1535,18 @@ bool output_open_audio (const String & filename, const Tuple & tuple,
     in_rate = rate;
     in_frames = 0;
 
+    setup_cache (lock);
+
+    if (aud_get_render_mode ())
+        render_track_begin ();
+
     setup_effects (lock);
     setup_output (lock, true, pause);
 
     if (aud_get_bool ("record"))
         setup_secondary (lock, true);
 
+    publish_clock (lock);
     return true;
 }
 
@@ -551,6 +1566,7 @@ void output_set_replay_gain (const ReplayGainInfo & info)
     {
         gain_info = info;
         gain_info_valid = true;
+        update_replay_gain (lock);
 
         AUDINFO ("Replay Gain info:\n");
         AUDINFO (" album gain: %f dB\n", info.album_gain);
@@ -595,7 +1611,13 @@ void output_flush (int time, bool force)
         state.set_flushed (lock, true);
         seek_time = time;
         in_frames = 0;
+
+        /* the decoder will start over at the new position */
+        reset_cache (lock, time);
     }
+
+    gap_start = -1;
+    publish_clock (lock);
 }
 
 void output_resume ()
@@ -614,39 +1636,133 @@ void output_pause (bool pause)
         apply_pause (lock, pause);
 }
 
-int output_get_time ()
+/* checks whether a seek to <time> can be served from the cache */
+static bool check_cache (SafeLock &, int time, int64_t & frame)
 {
-    auto lock = state.lock_safe ();
-    int time = 0, delay = 0;
+    if (! cache.size ())
+        return false;
 
-    if (state.input ())
-    {
-        if (state.output ())
-        {
-            delay = cop->get_delay ();
-            delay += aud::rescale<int64_t> (out_bytes_held, out_bytes_per_sec, 1000);
-        }
+    frame = aud::rescale<int64_t> (time, 1000, in_rate);
+    int64_t start = cache_end - cache.len () / in_channels;
 
-        delay = effect_adjust_delay (delay);
-        time = aud::rescale<int64_t> (in_frames, in_rate, 1000);
-        time = seek_time + aud::max (time - delay, 0);
+    if (! state.output () || state.flushed () || state.resetting () ||
+     frame < start || frame > cache_end)
+    {
+        cache_misses ++;
+        return false;
     }
 
-    return time;
+    cache_hits ++;
+    return true;
 }
 
-int output_get_raw_time ()
+static void start_replay (SafeLock & lock, int time, int64_t frame)
+{
+    seek_time = time;
+    in_frames = 0;
+    replay_pos = frame;
+
+    publish_clock (lock);
+}
+
+/* Seeks within the cache, if possible.  The cached audio is played from the
+ * new position on the next write.  If <flush> is false, audio already queued
+ * is played out first (used for A-B repeat). */
+bool output_seek_cached (int time, bool flush)
 {
     auto lock = state.lock_safe ();
-    int time = 0;
+    int64_t frame;
 
-    if (state.output ())
-    {
-        time = aud::rescale<int64_t> (out_bytes_written, out_bytes_per_sec, 1000);
-        time = aud::max (time - cop->get_delay (), 0);
-    }
+    if (! state.input () || ! check_cache (lock, time, frame))
+        return false;
+
+    // allow effect plugins to prevent the flush, but
+    // always flush if paused to prevent locking up
+    if (flush && effect_flush (state.paused ()))
+        flush_output (lock);
+
+    start_replay (lock, time, frame);
+    return true;
+}
+
+/* Plays the current song again from <time> to its end, if possible, once the
+ * decoder has finished (used for repeats).  Returns false if that part of the
+ * song is not cached or if the replay was interrupted by a seek. */
+bool output_replay_cached (int time, int stop_time)
+{
+    auto lock = state.lock_unsafe ();
+    int64_t frame;
+
+    if (! state.input () || ! check_cache (lock, time, frame))
+        return false;
+
+    start_replay (lock, time, frame);
+
+    replay_cache (lock, stop_time);
+    bool done = ! state.flushed () && replay_pos < 0;
+
+    replay_pos = -1;
+    return done;
+}
+
+EXPORT void aud_drct_get_seek_cache_stats (int & hits, int & misses)
+{
+    auto lock = state.lock_safe ();
+
+    hits = cache_hits;
+    misses = cache_misses;
+}
+
+/* position in the song, extrapolated from the last clock update */
+static int64_t get_time_us (const PlaybackClock & c)
+{
+    int64_t delay = c.device_delay + c.buffer_delay + c.effect_delay;
+    int64_t time = c.in_time - delay;
+
+    if (c.flags & CLOCK_RUNNING)
+        time += monotonic_time () - c.stamp;
+
+    return aud::clamp (time, c.seek_time, aud::max (c.in_time, c.seek_time));
+}
+
+int output_get_time ()
+{
+    PlaybackClock c;
+    read_clock (c);
+
+    return (c.flags & CLOCK_INPUT) ? get_time_us (c) / 1000 : 0;
+}
+
+int output_get_raw_time ()
+{
+    PlaybackClock c;
+    read_clock (c);
+
+    if (! (c.flags & CLOCK_OUTPUT))
+        return 0;
+
+    int64_t time = c.out_time - c.device_delay;
+
+    if (c.flags & CLOCK_RUNNING)
+        time += monotonic_time () - c.stamp;
 
-    return time;
+    return aud::clamp (time, (int64_t) 0, c.out_time) / 1000;
+}
+
+EXPORT int64_t aud_drct_get_time_us ()
+{
+    PlaybackClock c;
+    read_clock (c);
+
+    return (c.flags & CLOCK_INPUT) ? get_time_us (c) : 0;
+}
+
+EXPORT int64_t aud_drct_get_time_frames ()
+{
+    PlaybackClock c;
+    read_clock (c);
+
+    return (c.flags & CLOCK_INPUT) ? aud::rescale<int64_t> (get_time_us (c), 1000000, c.rate) : 0;
 }
 
 void output_close_audio ()
@@ -655,12 +1771,27 @@ void output_close_audio ()
 
     if (state.input ())
     {
+        if (aud_get_render_mode ())
+            render_track_end (in_filename, in_frames, in_rate);
+
         state.set_input (lock, false);
         in_filename = String ();
         in_tuple = Tuple ();
 
+        cache.destroy ();
+        replay_pos = -1;
+
+        /* running out of audio between songs is counted as a gap instead */
+        out_primed = false;
+        __atomic_store_n (& out_pull_feeding, false, __ATOMIC_RELAXED);
+
         if (state.output ())
             finish_effects (lock, false); /* first time for end of song */
+
+        publish_clock (lock);
+
+        if (state.output () && ! state.flushed ())
+            mark_gap_start (lock);
     }
 }
 
@@ -670,6 +1801,8 @@ void output_drain ()
 
     if (! state.input ())
     {
+        gap_start = -1;
+
         if (state.output ())
             finish_effects (lock, true); /* second time for end of playlist */
 
@@ -678,6 +1811,54 @@ void output_drain ()
     }
 }
 
+EXPORT GapStats aud_drct_get_gap_stats ()
+{
+    auto lock = state.lock_safe ();
+    return gap_stats;
+}
+
+EXPORT UnderrunStats aud_drct_get_underrun_stats ()
+{
+    auto lock = state.lock_safe ();
+    UnderrunStats stats = underrun_stats;
+
+    /* count underruns not yet picked up by the input thread */
+    stats.underruns += __atomic_load_n (& pull_underruns, __ATOMIC_RELAXED) -
+     pull_underruns_seen;
+    stats.buffer_ms = (state.output () && out_threaded) ? buffer_ms : 0;
+
+    return stats;
+}
+
+static int find_sink (OutputPlugin * op)
+{
+    for (int i = 0; i < sinks.len (); i ++)
+    {
+        if (sinks[i]->op == op)
+            return i;
+    }
+
+    return -1;
+}
+
+/* removes the sink (without calling cleanup()), returns false if not found */
+static bool remove_sink (UnsafeLock & lock, OutputPlugin * op)
+{
+    int i = find_sink (op);
+    if (i < 0)
+        return false;
+
+    close_sink (lock, sinks[i].get ());
+    sinks.remove (i, 1);
+
+    bool any = false;
+    for (auto & sink : sinks)
+        any = any || sink->open;
+
+    state.set_secondary (lock, any);
+    return true;
+}
+
 static void output_reset (OutputReset type, OutputPlugin * op)
 {
     auto lock1 = state.lock_safe ();
@@ -690,6 +1871,9 @@ static void output_reset (OutputReset type, OutputPlugin * op)
     lock1.minor.unlock ();
     auto lock2 = state.lock_unsafe ();
 
+    /* any audio still being queued by the input thread is stale */
+    out_serial ++;
+
     if (type != OutputReset::EffectsOnly)
         cleanup_output (lock2);
 
@@ -702,12 +1886,7 @@ static void output_reset (OutputReset type, OutputPlugin * op)
         if (op)
         {
             /* secondary plugin may become primary */
-            if (op == sop)
-            {
-                cleanup_secondary (lock2);
-                sop = nullptr;
-            }
-            else if (! op->init ())
+            if (! remove_sink (lock2, op) && ! op->init ())
                 op = nullptr;
         }
 
@@ -726,6 +1905,25 @@ static void output_reset (OutputReset type, OutputPlugin * op)
     }
 
     state.set_resetting (lock2, false);
+    publish_clock (lock2);
+}
+
+EXPORT int OutputPlugin::pull_audio (void * data, int size)
+{
+    if (! __atomic_load_n (& out_pull_active, __ATOMIC_ACQUIRE))
+        return 0;
+
+    int len = out_ring.read (data, size);
+    __atomic_add_fetch (& out_bytes_pulled, len, __ATOMIC_RELAXED);
+
+    if (len < size && __atomic_load_n (& out_pull_feeding, __ATOMIC_RELAXED))
+    {
+        /* count only the first short read until more audio is queued */
+        __atomic_store_n (& out_pull_feeding, false, __ATOMIC_RELAXED);
+        __atomic_add_fetch (& pull_underruns, 1, __ATOMIC_RELAXED);
+    }
+
+    return len;
 }
 
 EXPORT void aud_output_reset (OutputReset type)
@@ -764,42 +1962,75 @@ EXPORT void aud_drct_set_volume (StereoVolume volume)
 
 PluginHandle * output_plugin_get_current ()
 {
-    return cop ? aud_plugin_by_header (cop) : nullptr;
-}
+    if (aud_get_render_mode ())
+        return render_handle;
 
-PluginHandle * output_plugin_get_secondary ()
-{
-    return sop ? aud_plugin_by_header (sop) : nullptr;
+    return cop ? aud_plugin_by_header (cop) : nullptr;
 }
 
 bool output_plugin_set_current (PluginHandle * plugin)
 {
-    output_reset (OutputReset::ResetPlugin, plugin ?
-     (OutputPlugin *) aud_plugin_get_header (plugin) : nullptr);
+    /* in render mode, the selected plugin is never actually used */
+    if (aud_get_render_mode ())
+    {
+        render_handle = plugin;
+        output_reset (OutputReset::ResetPlugin, plugin ? render_get_output () : nullptr);
+    }
+    else
+        output_reset (OutputReset::ResetPlugin, plugin ?
+         (OutputPlugin *) aud_plugin_get_header (plugin) : nullptr);
+
     return (! plugin || cop);
 }
 
-bool output_plugin_set_secondary (PluginHandle * plugin)
+bool output_plugin_add_secondary (PluginHandle * plugin)
 {
-    auto lock = state.lock_safe ();
+    auto lock = state.lock_unsafe ();
+    auto op = (OutputPlugin *) aud_plugin_get_header (plugin);
+
+    if (! op || find_sink (op) >= 0)
+        return (bool) op;
 
-    cleanup_secondary (lock);
-    if (sop)
-        sop->cleanup ();
+    if (! op->init ())
+        return false;
 
-    sop = plugin ? (OutputPlugin *) aud_plugin_get_header (plugin) : nullptr;
-    if (sop && ! sop->init ())
-        sop = nullptr;
+    sinks.append (SmartNew<RecordSink> (op, plugin));
 
     if (state.input () && aud_get_bool ("record"))
         setup_secondary (lock, false);
 
-    return (! plugin || sop);
+    return true;
 }
 
-static void record_settings_changed (void *, void *)
+void output_plugin_remove_secondary (PluginHandle * plugin)
+{
+    auto lock = state.lock_unsafe ();
+    auto op = (OutputPlugin *) aud_plugin_get_header (plugin);
+
+    if (op && remove_sink (lock, op))
+        op->cleanup ();
+}
+
+EXPORT bool aud_drct_get_record_stats (PluginHandle * plugin, RecordStats & stats)
 {
     auto lock = state.lock_safe ();
+    int i = find_sink ((OutputPlugin *) aud_plugin_get_header (plugin));
+
+    if (i < 0 || ! sinks[i]->open)
+        return false;
+
+    auto sink = sinks[i].get ();
+    int bytes_per_sec = sizeof (float) * sink->channels * sink->rate;
+
+    stats = sink->stats;
+    stats.lag = aud::rescale (sink->ring.len (), bytes_per_sec, 1000);
+
+    return true;
+}
+
+static void record_settings_changed (void *, void *)
+{
+    auto lock = state.lock_unsafe ();
 
     if (state.input () && aud_get_bool ("record"))
         setup_secondary (lock, false);
@@ -807,14 +2038,59 @@ static void record_settings_changed (void *, void *)
         cleanup_secondary (lock);
 }
 
+static void gain_settings_changed (void *, void *)
+{
+    auto lock = state.lock_safe ();
+    update_replay_gain (lock);
+}
+
+static void volume_settings_changed (void *, void *)
+{
+    auto lock = state.lock_safe ();
+    update_volume (lock);
+}
+
+static const char * const gain_settings[] = {
+    "set album_shuffle",
+    "set default_gain",
+    "set enable_clipping_prevention",
+    "set enable_replay_gain",
+    "set replay_gain_mode",
+    "set replay_gain_preamp",
+    "set shuffle"
+};
+
+static const char * const volume_settings[] = {
+    "set soft_clipping",
+    "set software_volume_control",
+    "set sw_volume_left",
+    "set sw_volume_right"
+};
+
 void output_init ()
 {
     hook_associate ("set record", record_settings_changed, nullptr);
     hook_associate ("set record_stream", record_settings_changed, nullptr);
+
+    for (const char * name : gain_settings)
+        hook_associate (name, gain_settings_changed, nullptr);
+    for (const char * name : volume_settings)
+        hook_associate (name, volume_settings_changed, nullptr);
+
+    auto lock = state.lock_safe ();
+    update_replay_gain (lock);
+    update_volume (lock);
 }
 
 void output_cleanup ()
 {
+    stop_output_thread ();
+
     hook_dissociate ("set record", record_settings_changed);
     hook_dissociate ("set record_stream", record_settings_changed);
+
+    for (const char * name : gain_settings)
+        hook_dissociate (name, gain_settings_changed);
+    for (const char * name : volume_settings)
+        hook_dissociate (name, volume_settings_changed);
 }
@@ -0,0 +1,204 @@
+/*
+ * pipeline-stats.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "internal.h"
+
+#include <chrono>
+
+#include "drct.h"
+#include "hook.h"
+#include "runtime.h"
+
+/* Each histogram covers 1 ns to 2^MAX_BITS ns (about a minute) in log-linear
+ * buckets, in the manner of an HDR histogram: values below 2^SUB_BITS have a
+ * bucket each, and every power of two above that is split into 2^SUB_BITS
+ * equal buckets, so any value is known to within 1/16 (6.25%).
+ *
+ * The counters are updated with relaxed atomic operations, so recording never
+ * blocks and several threads may record into the same histogram (as effects
+ * do when "effect_threads" is enabled).  A summary taken while recording is in
+ * progress may be very slightly inconsistent, which does not matter here. */
+static constexpr int SUB_BITS = 4;
+static constexpr int MAX_BITS = 36;
+static constexpr int BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+struct Histogram
+{
+    int64_t count, total, max;
+    int64_t buckets[BUCKETS];
+};
+
+static constexpr int FIXED_STAGES = (int) PipelineStage::Effect;
+
+static bool enabled;
+static Histogram fixed[FIXED_STAGES];
+static Histogram effects[PIPELINE_MAX_EFFECTS];
+
+static int bucket_for (int64_t ns)
+{
+    if (ns < (1 << SUB_BITS))
+        return aud::max (ns, (int64_t) 0);
+
+    int bits = 63 - __builtin_clzll (ns);
+    if (bits >= MAX_BITS)
+        return BUCKETS - 1;
+
+    int sub = (ns >> (bits - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+    return ((bits - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+/* highest value that falls into a bucket */
+static int64_t bucket_limit (int bucket)
+{
+    if (bucket < (1 << SUB_BITS))
+        return bucket;
+
+    int shift = (bucket >> SUB_BITS) - 1;
+    int sub = bucket & ((1 << SUB_BITS) - 1);
+    return ((int64_t) ((1 << SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+static Histogram * get_histogram (PipelineStage stage, int effect)
+{
+    if (stage != PipelineStage::Effect)
+        return & fixed[(int) stage];
+
+    if (effect < 0 || effect >= PIPELINE_MAX_EFFECTS)
+        return nullptr;
+
+    return & effects[effect];
+}
+
+static void clear_histogram (Histogram & h)
+{
+    __atomic_store_n (& h.count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n (& h.total, 0, __ATOMIC_RELAXED);
+    __atomic_store_n (& h.max, 0, __ATOMIC_RELAXED);
+
+    for (int64_t & bucket : h.buckets)
+        __atomic_store_n (& bucket, 0, __ATOMIC_RELAXED);
+}
+
+int64_t pipeline_stats_start ()
+{
+    if (! __atomic_load_n (& enabled, __ATOMIC_RELAXED))
+        return 0;
+
+    auto now = std::chrono::steady_clock::now ().time_since_epoch ();
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (now).count ();
+}
+
+void pipeline_stats_finish (PipelineStage stage, int64_t start, int effect)
+{
+    if (! start)
+        return;
+
+    auto now = std::chrono::steady_clock::now ().time_since_epoch ();
+    int64_t end = std::chrono::duration_cast<std::chrono::nanoseconds> (now).count ();
+
+    pipeline_stats_record (stage, end - start, effect);
+}
+
+void pipeline_stats_record (PipelineStage stage, int64_t ns, int effect)
+{
+    Histogram * h = get_histogram (stage, effect);
+    if (! h)
+        return;
+
+    __atomic_fetch_add (& h->buckets[bucket_for (ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (& h->total, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add (& h->count, 1, __ATOMIC_RELAXED);
+
+    int64_t max = __atomic_load_n (& h->max, __ATOMIC_RELAXED);
+    while (ns > max && ! __atomic_compare_exchange_n (& h->max, & max, ns,
+     true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+bool pipeline_stats_summary (PipelineStage stage, int effect, PipelineStats & stats)
+{
+    Histogram * h = get_histogram (stage, effect);
+    if (! h)
+        return false;
+
+    /* copy the buckets first so that the percentiles add up */
+    int64_t buckets[BUCKETS];
+    int64_t count = 0;
+
+    for (int i = 0; i < BUCKETS; i ++)
+        count += (buckets[i] = __atomic_load_n (& h->buckets[i], __ATOMIC_RELAXED));
+
+    if (! count)
+        return false;
+
+    stats.calls = count;
+    stats.mean_ns = __atomic_load_n (& h->total, __ATOMIC_RELAXED) /
+     aud::max (__atomic_load_n (& h->count, __ATOMIC_RELAXED), (int64_t) 1);
+    stats.max_ns = __atomic_load_n (& h->max, __ATOMIC_RELAXED);
+
+    const int percents[3] = {50, 90, 99};
+    int64_t * results[3] = {& stats.p50_ns, & stats.p90_ns, & stats.p99_ns};
+
+    int64_t seen = 0;
+    int p = 0;
+
+    for (int i = 0; i < BUCKETS && p < 3; i ++)
+    {
+        seen += buckets[i];
+
+        /* report the top of the bucket, but never more than the maximum (the
+         * last bucket holds everything too long to measure otherwise) */
+        int64_t limit = (i < BUCKETS - 1) ? bucket_limit (i) : stats.max_ns;
+
+        while (p < 3 && seen * 100 >= count * percents[p])
+            * results[p ++] = aud::min (limit, stats.max_ns);
+    }
+
+    return true;
+}
+
+void pipeline_stats_reset ()
+{
+    for (Histogram & h : fixed)
+        clear_histogram (h);
+    for (Histogram & h : effects)
+        clear_histogram (h);
+}
+
+static void pipeline_stats_update (void * = nullptr, void * = nullptr)
+{
+    bool enable = aud_get_bool ("pipeline_stats");
+
+    /* start each run of measurements from scratch */
+    if (enable && ! __atomic_load_n (& enabled, __ATOMIC_RELAXED))
+        pipeline_stats_reset ();
+
+    __atomic_store_n (& enabled, enable, __ATOMIC_RELAXED);
+}
+
+void pipeline_stats_init ()
+{
+    pipeline_stats_update ();
+    hook_associate ("set pipeline_stats", pipeline_stats_update, nullptr);
+}
+
+void pipeline_stats_cleanup ()
+{
+    hook_dissociate ("set pipeline_stats", pipeline_stats_update);
+}
@@ -39,6 +39,8 @@
 
 #include <assert.h>
 
+#include <chrono>
+
 #include "audstrings.h"
 #include "hook.h"
 #include "i18n.h"
@@ -52,11 +54,15 @@
 #include "runtime.h"
 #include "threads.h"
 
+// how long before the end of a song to start reading the next one
+#define PREROLL_TIME 5000 // milliseconds
+
 struct PlaybackState {
     bool playing = false;
     bool thread_running = false;
     int control_serial = 0;
     int playback_serial = 0;
+    std::chrono::steady_clock::time_point play_time; // of last "play" command
 };
 
 struct PlaybackControl {
@@ -88,7 +94,12 @@ struct PlaybackInfo {
     bool ready = false;
     bool ended = false;
     bool error = false;
+    bool prerolled = false;
+    bool audio_started = false;
     String error_s;
+
+    // accessed only by the playback thread, without locking
+    int64_t decode_start = 0; // see pipeline_stats_start()
 };
 
 static aud::mutex mutex;
@@ -218,16 +229,21 @@ static void end_cb (void *)
         playlist.set_position (playlist.get_position ());
     };
 
-    auto do_next = [playlist] ()
+    // in render mode, each song is played once and failures are skipped
+    bool render = aud_get_render_mode ();
+
+    auto do_next = [playlist, render] ()
     {
-        if (! playlist.next_song (aud_get_bool ("repeat")))
+        if (! playlist.next_song (! render && aud_get_bool ("repeat")))
         {
             playlist.set_position (-1);
             hook_call ("playlist end reached", nullptr);
         }
     };
 
-    if (aud_get_bool ("no_playlist_advance"))
+    if (render)
+        do_next ();
+    else if (aud_get_bool ("no_playlist_advance"))
     {
         // we assume here that repeat is not enabled;
         // single-song repeats are handled in run_playback()
@@ -249,9 +265,18 @@ static void end_cb (void *)
     }
 }
 
-// helper, can be called from either main or playback thread
-static void request_seek (aud::mutex::holder & mh, int time)
+// helper, can be called from either main or playback thread;
+// "seamless" is used for A-B repeat, when the output has just reached point B
+static void request_seek (aud::mutex::holder & mh, int time, bool seamless = false)
 {
+    // seeks within the recently decoded audio do not involve the decoder
+    if (is_ready (mh) && pb_info.length > 0 && pb_control.seek < 0 &&
+     output_seek_cached (aud::clamp (time, 0, pb_info.length), ! seamless))
+    {
+        event_queue ("playback seek", nullptr);
+        return;
+    }
+
     // set up "seek" command whether ready or not;
     // if not ready, it will take effect upon open_audio()
     pb_control.seek = aud::max (0, time);
@@ -307,8 +332,8 @@ static bool check_playback_repeat ()
         return false;
 
     // check whether we need to repeat
-    if (pb_control.repeat_a >= 0 ||
-     (aud_get_bool ("repeat") && aud_get_bool ("no_playlist_advance")))
+    if (pb_control.repeat_a >= 0 || (! aud_get_render_mode () &&
+     aud_get_bool ("repeat") && aud_get_bool ("no_playlist_advance")))
     {
         // treat the repeat as a seek (takes effect at open_audio())
         pb_control.seek = pb_control.repeat_a;
@@ -326,6 +351,29 @@ static bool check_playback_repeat ()
     return false;
 }
 
+// playback thread helper: plays a repeat from the seek-back cache, if possible
+static bool replay_cached ()
+{
+    auto mh = mutex.take ();
+    if (! is_ready (mh))
+        return false;
+
+    int seek = pb_control.seek;
+    int stop_time = pb_info.stop_time;
+
+    // the repeat is treated as a seek; clear it unless the replay fails
+    pb_control.seek = -1;
+
+    mh.unlock ();
+    bool replayed = output_replay_cached (aud::max (0, seek), stop_time);
+    mh.lock ();
+
+    if (! replayed && pb_control.seek < 0)
+        pb_control.seek = seek;
+
+    return replayed;
+}
+
 // playback thread helper
 static void run_playback ()
 {
@@ -341,13 +389,17 @@ static void run_playback ()
         if (! dec.ip->play (pb_info.filename, dec.file))
             pb_info.error = true;
 
+        bool repeat = (! pb_info.error && pb_info.length > 0 && check_playback_repeat ());
+
+        // play the repeated part from the seek-back cache, for as long as it
+        // is there, before reopening the file
+        while (repeat && replay_cached ())
+            repeat = check_playback_repeat ();
+
         // close audio (no-op if it wasn't opened)
         output_close_audio ();
 
-        if (pb_info.error || pb_info.length <= 0)
-            break;
-
-        if (! check_playback_repeat ())
+        if (! repeat || ! aud_drct_get_ready ())
             break;
 
         // rewind file pointer before repeating
@@ -383,6 +435,8 @@ static void finish_playback (aud::mutex::holder &)
 // playback thread
 static void playback_thread ()
 {
+    realtime_setup_thread ("Playback");
+
     auto mh = mutex.take ();
 
     while (1)
@@ -442,6 +496,7 @@ void playback_play (int seek_time, bool pause)
     // set up "play" command
     pb_state.playing = true;
     pb_state.control_serial ++;
+    pb_state.play_time = std::chrono::steady_clock::now ();
     pb_control.paused = pause;
     pb_control.seek = (seek_time > 0) ? seek_time : -1;
 
@@ -527,20 +582,50 @@ EXPORT void InputPlugin::set_replay_gain (const ReplayGainInfo & gain)
 
 EXPORT void InputPlugin::write_audio (const void * data, int length)
 {
+    // record the time the input plugin took to decode this block
+    pipeline_stats_finish (PipelineStage::Decoder, pb_info.decode_start);
+
     auto mh = mutex.take ();
     if (! in_sync (mh))
         return;
 
+    // log the time from the "play" command to the first decoded audio
+    if (! pb_info.audio_started)
+    {
+        auto delay = std::chrono::steady_clock::now () - pb_state.play_time;
+        AUDINFO ("Time to first audio: %d ms.\n", (int)
+         std::chrono::duration_cast<std::chrono::milliseconds> (delay).count ());
+
+        pb_info.audio_started = true;
+    }
+
     // fetch A-B repeat settings
     int a = pb_control.repeat_a;
     int b = pb_control.repeat_b;
 
+    // start reading the next song once this one is nearly over
+    bool preroll = false;
+    if (! pb_info.prerolled && b < 0 && pb_info.ready && pb_info.length > 0 &&
+     output_get_time () >= pb_info.length - PREROLL_TIME)
+    {
+        pb_info.prerolled = true;
+        preroll = true;
+    }
+
     mh.unlock ();
 
+    // due to mutex ordering, we cannot call into the playlist while locked
+    if (preroll)
+        playback_entry_preroll (pb_state.playback_serial);
+
     // it's okay to call output_write_audio() even if we are no longer in sync,
     // since it will return immediately if output_flush() has been called
     int stop_time = (b >= 0) ? b : pb_info.stop_time;
-    if (output_write_audio (data, length, stop_time))
+    bool more = output_write_audio (data, length, stop_time);
+
+    pb_info.decode_start = pipeline_stats_start ();
+
+    if (more)
         return;
 
     mh.lock ();
@@ -555,7 +640,7 @@ EXPORT void InputPlugin::write_audio (const void * data, int length)
     if (pb_control.seek < 0)
     {
         if (b >= 0)
-            request_seek (mh, a);
+            request_seek (mh, a, true);
         else
             pb_info.ended = true;
     }
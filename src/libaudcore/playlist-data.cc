@@ -41,12 +41,25 @@ struct PlaylistEntry
     PluginHandle * decoder;
     Tuple tuple;
     String error;
-    int number;
-    int length;
-    int shuffle_num;
-    bool selected, queued;
+    FileStamp stamp; /* when the file was last scanned */
+    int number; /* see PlaylistData::entry_number() */
 };
 
+static int tuple_length (const Tuple & tuple)
+{
+    return aud::max (0, tuple.get_int (Tuple::Length));
+}
+
+template<class T>
+static void reorder_column (Index<T> & column, int at, const Index<int> & order)
+{
+    Index<T> old;
+    old.move_from (column, at, 0, order.len (), true, false);
+
+    for (int i = 0; i < order.len (); i ++)
+        column[at + i] = std::move (old[order[i]]);
+}
+
 void PlaylistEntry::format ()
 {
     tuple.delete_fallbacks ();
@@ -74,7 +87,6 @@ void PlaylistEntry::set_tuple (Tuple && new_tuple)
     if (! new_tuple.valid ())
         new_tuple.set_filename (filename);
 
-    length = aud::max (0, new_tuple.get_int (Tuple::Length));
     tuple = std::move (new_tuple);
 
     format ();
@@ -83,11 +95,7 @@ void PlaylistEntry::set_tuple (Tuple && new_tuple)
 PlaylistEntry::PlaylistEntry (PlaylistAddItem && item) :
     filename (item.filename),
     decoder (item.decoder),
-    number (-1),
-    length (0),
-    shuffle_num (0),
-    selected (false),
-    queued (false)
+    number (-1)
 {
     set_tuple (std::move (item.tuple));
 }
@@ -115,10 +123,13 @@ PlaylistData::PlaylistData (Playlist::ID * id, const char * title) :
     title (title),
     resume_time (0),
     m_id (id),
-    m_position (nullptr),
-    m_focus (nullptr),
+    m_numbered (0),
+    m_position (-1),
+    m_focus (-1),
     m_selected_count (0),
-    m_last_shuffle_num (0),
+    m_shuffle_choices_valid (false),
+    m_shuffle_by_album (false),
+    m_shuffle_peeked (-1),
     m_total_length (0),
     m_selected_length (0),
     m_last_update (),
@@ -130,10 +141,86 @@ PlaylistData::~PlaylistData ()
     pl_signal_playlist_deleted (m_id);
 }
 
-void PlaylistData::number_entries (int at, int length)
+/* Entries are not renumbered each time entries before them are inserted,
+ * removed, or moved, since that would touch every following entry.  Instead,
+ * the entries before m_numbered are known to be numbered correctly, and the
+ * rest are numbered when needed.  Only the scanner, which refers to entries by
+ * pointer, needs this. */
+int PlaylistData::entry_number (PlaylistEntry * entry)
 {
-    for (int i = at; i < at + length; i ++)
+    int n = entry->number;
+    if (n >= 0 && n < m_entries.len () && m_entries[n].get () == entry)
+        return n;
+
+    for (int i = m_numbered; i < m_entries.len (); i ++)
         m_entries[i]->number = i;
+
+    m_numbered = m_entries.len ();
+    return entry->number;
+}
+
+/* adds <delta> to each reference to an entry from <from> on */
+void PlaylistData::shift_numbers (int from, int delta)
+{
+    if (m_position >= from)
+        m_position += delta;
+    if (m_focus >= from)
+        m_focus += delta;
+
+    for (int & entry_num : m_queued)
+    {
+        if (entry_num >= from)
+            entry_num += delta;
+    }
+
+    for (int & entry_num : m_shuffle_history)
+    {
+        if (entry_num >= from)
+            entry_num += delta;
+    }
+
+    if (m_shuffle_peeked >= from)
+        m_shuffle_peeked += delta;
+
+    /* after a removal, the entries now at from + delta have moved too */
+    m_numbered = aud::min (m_numbered, aud::min (from, from + delta));
+    m_shuffle_choices_valid = false;
+}
+
+/* rearranges the entries from <at> on, so that entry at + i becomes the one
+ * that was at + order[i] */
+void PlaylistData::reorder_entries (int at, const Index<int> & order)
+{
+    int len = order.len ();
+
+    reorder_column (m_entries, at, order);
+    reorder_column (m_lengths, at, order);
+    reorder_column (m_shuffle_nums, at, order);
+    m_selected.reorder (at, order);
+    m_queued_flags.reorder (at, order);
+
+    Index<int> moved_to;
+    moved_to.insert (0, len);
+
+    for (int i = 0; i < len; i ++)
+        moved_to[order[i]] = at + i;
+
+    auto update = [&] (int & entry_num) {
+        if (entry_num >= at && entry_num < at + len)
+            entry_num = moved_to[entry_num - at];
+    };
+
+    update (m_position);
+    update (m_focus);
+    update (m_shuffle_peeked);
+
+    for (int & entry_num : m_queued)
+        update (entry_num);
+    for (int & entry_num : m_shuffle_history)
+        update (entry_num);
+
+    m_numbered = aud::min (m_numbered, at);
+    m_shuffle_choices_valid = false;
 }
 
 PlaylistEntry * PlaylistData::entry_at (int i)
@@ -172,17 +259,21 @@ bool PlaylistData::same_album (const Tuple & a, const Tuple & b)
     return (album && album == b.get_str (Tuple::Album));
 }
 
-void PlaylistData::set_entry_tuple (PlaylistEntry * entry, Tuple && tuple)
+void PlaylistData::set_entry_tuple (int entry_num, Tuple && tuple)
 {
-    m_total_length -= entry->length;
-    if (entry->selected)
-        m_selected_length -= entry->length;
-
+    PlaylistEntry * entry = m_entries[entry_num].get ();
     entry->set_tuple (std::move (tuple));
 
-    m_total_length += entry->length;
-    if (entry->selected)
-        m_selected_length += entry->length;
+    int change = tuple_length (entry->tuple) - m_lengths[entry_num];
+    m_lengths[entry_num] += change;
+
+    m_total_length += change;
+    if (m_selected.get (entry_num))
+        m_selected_length += change;
+
+    /* the album may have changed */
+    if (m_shuffle_by_album)
+        shuffle_update_choices (entry_num);
 }
 
 void PlaylistData::queue_update (Playlist::UpdateLevel level, int at, int count, int flags)
@@ -235,19 +326,28 @@ void PlaylistData::insert_items (int at, Index<PlaylistAddItem> && items)
     if (at < 0 || at > n_entries)
         at = n_entries;
 
+    shift_numbers (at, n_items);
+
     m_entries.insert (at, n_items);
+    m_lengths.insert (at, n_items);
+    m_shuffle_nums.insert (at, n_items);
+    m_selected.insert (at, n_items);
+    m_queued_flags.insert (at, n_items);
 
     int i = at;
     for (auto & item : items)
     {
         auto entry = new PlaylistEntry (std::move (item));
-        m_entries[i ++].capture (entry);
-        m_total_length += entry->length;
+        entry->number = i;
+        m_entries[i].capture (entry);
+
+        m_lengths[i] = tuple_length (entry->tuple);
+        m_total_length += m_lengths[i];
+        i ++;
     }
 
     items.clear ();
 
-    number_entries (at, n_entries + n_items - at);
     queue_update (Playlist::Structure, at, n_items);
 }
 
@@ -262,44 +362,49 @@ void PlaylistData::remove_entries (int at, int number)
     if (number < 0 || number > n_entries - at)
         number = n_entries - at;
 
-    if (m_position && m_position->number >= at && m_position->number < at + number)
+    if (m_position >= at && m_position < at + number)
     {
-        set_position (nullptr, false);
+        move_position (-1, false);
         position_changed = true;
     }
 
-    if (m_focus && m_focus->number >= at && m_focus->number < at + number)
+    /* the entry after the removed ones will take their place */
+    if (m_focus >= at && m_focus < at + number)
     {
         if (at + number < n_entries)
-            m_focus = m_entries[at + number].get ();
-        else if (at > 0)
-            m_focus = m_entries[at - 1].get ();
+            m_focus = at + number;
         else
-            m_focus = nullptr;
+            m_focus = at - 1;
     }
 
-    for (int i = 0; i < number; i ++)
-    {
-        PlaylistEntry * entry = m_entries [at + i].get ();
+    if (m_shuffle_peeked >= at && m_shuffle_peeked < at + number)
+        m_shuffle_peeked = -1;
 
-        if (entry->queued)
+    for (int i = at; i < at + number; i ++)
+    {
+        if (m_queued_flags.get (i))
         {
-            m_queued.remove (m_queued.find (entry), 1);
+            m_queued.remove (m_queued.find (i), 1);
             update_flags |= QueueChanged;
         }
 
-        if (entry->selected)
+        if (m_selected.get (i))
         {
             m_selected_count --;
-            m_selected_length -= entry->length;
+            m_selected_length -= m_lengths[i];
         }
 
-        m_total_length -= entry->length;
+        m_total_length -= m_lengths[i];
+        shuffle_forget (i);
     }
 
     m_entries.remove (at, number);
+    m_lengths.remove (at, number);
+    m_shuffle_nums.remove (at, number);
+    m_selected.remove (at, number);
+    m_queued_flags.remove (at, number);
 
-    number_entries (at, n_entries - at - number);
+    shift_numbers (at + number, -number);
     queue_update (Playlist::Structure, at, 0, update_flags);
 
     if (position_changed)
@@ -313,18 +418,18 @@ void PlaylistData::remove_entries (int at, int number)
 
 int PlaylistData::position () const
 {
-    return m_position ? m_position->number : -1;
+    return m_position;
 }
 
 int PlaylistData::focus () const
 {
-    return m_focus ? m_focus->number : -1;
+    return m_focus;
 }
 
 bool PlaylistData::entry_selected (int entry_num) const
 {
-    auto entry = entry_at (entry_num);
-    return entry ? entry->selected : false;
+    return (entry_num >= 0 && entry_num < m_entries.len ()) ?
+     m_selected.get (entry_num) : false;
 }
 
 int PlaylistData::n_selected (int at, int number) const
@@ -336,43 +441,48 @@ int PlaylistData::n_selected (int at, int number) const
     if (number < 0 || number > n_entries - at)
         number = n_entries - at;
 
-    int n_selected = 0;
-
     if (at == 0 && number == n_entries)
-        n_selected = m_selected_count;
-    else
-    {
-        for (int i = 0; i < number; i ++)
-        {
-            if (m_entries[at + i]->selected)
-                n_selected ++;
-        }
-    }
+        return m_selected_count;
 
-    return n_selected;
+    return m_selected.count (at, number);
+}
+
+Index<int> PlaylistData::selected_entries () const
+{
+    Index<int> selected;
+    selected.insert (0, m_selected_count);
+
+    int i = 0;
+    for (int entry_num = m_selected.find_next (true, 0); entry_num >= 0;
+     entry_num = m_selected.find_next (true, entry_num + 1))
+        selected[i ++] = entry_num;
+
+    return selected;
 }
 
 void PlaylistData::set_focus (int entry_num)
 {
-    auto new_focus = entry_at (entry_num);
-    if (new_focus == m_focus)
+    if (entry_num < 0 || entry_num >= m_entries.len ())
+        entry_num = -1;
+
+    if (entry_num == m_focus)
         return;
 
     int first = m_entries.len ();
     int last = -1;
 
-    if (m_focus)
+    if (m_focus >= 0)
     {
-        first = aud::min (first, m_focus->number);
-        last = aud::max (last, m_focus->number);
+        first = aud::min (first, m_focus);
+        last = aud::max (last, m_focus);
     }
 
-    m_focus = new_focus;
+    m_focus = entry_num;
 
-    if (m_focus)
+    if (m_focus >= 0)
     {
-        first = aud::min (first, m_focus->number);
-        last = aud::max (last, m_focus->number);
+        first = aud::min (first, m_focus);
+        last = aud::max (last, m_focus);
     }
 
     if (first <= last)
@@ -381,21 +491,21 @@ void PlaylistData::set_focus (int entry_num)
 
 void PlaylistData::select_entry (int entry_num, bool selected)
 {
-    auto entry = entry_at (entry_num);
-    if (! entry || entry->selected == selected)
+    if (entry_num < 0 || entry_num >= m_entries.len () ||
+     m_selected.get (entry_num) == selected)
         return;
 
-    entry->selected = selected;
+    m_selected.set (entry_num, selected);
 
     if (selected)
     {
         m_selected_count ++;
-        m_selected_length += entry->length;
+        m_selected_length += m_lengths[entry_num];
     }
     else
     {
         m_selected_count --;
-        m_selected_length -= entry->length;
+        m_selected_length -= m_lengths[entry_num];
     }
 
     queue_update (Playlist::Selection, entry_num, 1);
@@ -404,17 +514,12 @@ void PlaylistData::select_entry (int entry_num, bool selected)
 void PlaylistData::select_all (bool selected)
 {
     int n_entries = m_entries.len ();
-    int first = n_entries, last = 0;
 
-    for (auto & entry : m_entries)
-    {
-        if (entry->selected != selected)
-        {
-            entry->selected = selected;
-            first = aud::min (first, entry->number);
-            last = entry->number;
-        }
-    }
+    /* the range of entries that will change */
+    int first = m_selected.find_next (! selected, 0);
+    int last = m_selected.find_prev (! selected, n_entries - 1);
+
+    m_selected.fill (selected);
 
     if (selected)
     {
@@ -427,14 +532,26 @@ void PlaylistData::select_all (bool selected)
         m_selected_length = 0;
     }
 
-    if (first < n_entries)
+    if (first >= 0)
         queue_update (Playlist::Selection, first, last + 1 - first);
 }
 
+void PlaylistData::invert_selection ()
+{
+    int n_entries = m_entries.len ();
+
+    m_selected.invert ();
+    m_selected_count = n_entries - m_selected_count;
+    m_selected_length = m_total_length - m_selected_length;
+
+    if (n_entries)
+        queue_update (Playlist::Selection, 0, n_entries);
+}
+
 int PlaylistData::shift_entries (int entry_num, int distance)
 {
-    PlaylistEntry * entry = entry_at (entry_num);
-    if (! entry || ! entry->selected || ! distance)
+    if (entry_num < 0 || entry_num >= m_entries.len () ||
+     ! m_selected.get (entry_num) || ! distance)
         return 0;
 
     int n_entries = m_entries.len ();
@@ -444,7 +561,7 @@ int PlaylistData::shift_entries (int entry_num, int distance)
     {
         for (center = entry_num; center > 0 && shift > distance; )
         {
-            if (! m_entries[-- center]->selected)
+            if (! m_selected.get (-- center))
                 shift --;
         }
     }
@@ -452,48 +569,36 @@ int PlaylistData::shift_entries (int entry_num, int distance)
     {
         for (center = entry_num + 1; center < n_entries && shift < distance; )
         {
-            if (! m_entries[center ++]->selected)
+            if (! m_selected.get (center ++))
                 shift ++;
         }
     }
 
-    top = bottom = center;
-
-    for (int i = 0; i < top; i ++)
-    {
-        if (m_entries[i]->selected)
-            top = i;
-    }
-
-    for (int i = n_entries; i > bottom; i --)
-    {
-        if (m_entries[i - 1]->selected)
-            bottom = i;
-    }
+    /* there is at least one selected entry, so both are found */
+    top = aud::min (m_selected.find_next (true, 0), center);
+    bottom = aud::max (m_selected.find_prev (true, n_entries - 1) + 1, center);
 
-    Index<EntryPtr> temp;
+    /* unselected entries above the center, then the selected entries, then
+     * unselected entries below the center */
+    Index<int> order;
 
     for (int i = top; i < center; i ++)
     {
-        if (! m_entries[i]->selected)
-            temp.append (std::move (m_entries[i]));
+        if (! m_selected.get (i))
+            order.append (i - top);
     }
 
-    for (int i = top; i < bottom; i ++)
-    {
-        if (m_entries[i] && m_entries[i]->selected)
-            temp.append (std::move (m_entries[i]));
-    }
+    for (int i = m_selected.find_next (true, top); i >= 0 && i < bottom;
+     i = m_selected.find_next (true, i + 1))
+        order.append (i - top);
 
     for (int i = center; i < bottom; i ++)
     {
-        if (m_entries[i] && ! m_entries[i]->selected)
-            temp.append (std::move (m_entries[i]));
+        if (! m_selected.get (i))
+            order.append (i - top);
     }
 
-    m_entries.move_from (temp, 0, top, bottom - top, false, true);
-
-    number_entries (top, bottom - top);
+    reorder_entries (top, order);
     queue_update (Playlist::Structure, top, bottom - top);
 
     return shift;
@@ -508,51 +613,99 @@ void PlaylistData::remove_selected ()
     bool position_changed = false;
     int update_flags = 0;
 
-    if (m_position && m_position->selected)
+    if (m_position >= 0 && m_selected.get (m_position))
     {
-        set_position (nullptr, false);
+        move_position (-1, false);
         position_changed = true;
     }
 
     m_focus = find_unselected_focus ();
 
-    int before = 0;  // number of entries before first selected
-    int after = 0;   // number of entries after last selected
+    // number of entries before the first and after the last selected
+    int before = m_selected.find_next (true, 0);
+    int after = n_entries - 1 - m_selected.find_prev (true, n_entries - 1);
 
-    while (before < n_entries && ! m_entries[before]->selected)
-        before ++;
+    /* new numbers of the remaining entries, or -1 for removed ones */
+    Index<int> moved_to;
+    moved_to.insert (0, n_entries - before);
 
     int to = before;
 
-    for (int from = before; from < n_entries; from ++)
+    for (int from = before; from < n_entries; )
     {
-        PlaylistEntry * entry = m_entries[from].get ();
+        /* a run of selected entries, followed by a run of unselected ones */
+        int end = m_selected.find_next (false, from);
+        if (end < 0)
+            end = n_entries;
+
+        for (; from < end; from ++)
+            moved_to[from - before] = -1;
+
+        end = m_selected.find_next (true, from);
+        if (end < 0)
+            end = n_entries;
 
-        if (entry->selected)
+        for (; from < end; from ++)
         {
-            if (entry->queued)
-            {
-                m_queued.remove (m_queued.find (entry), 1);
-                update_flags |= QueueChanged;
-            }
-
-            m_total_length -= entry->length;
-            after = 0;
+            m_entries[to] = std::move (m_entries[from]);
+            m_lengths[to] = m_lengths[from];
+            m_shuffle_nums[to] = m_shuffle_nums[from];
+            m_queued_flags.set (to, m_queued_flags.get (from));
+            moved_to[from - before] = to ++;
         }
-        else
+    }
+
+    m_total_length -= m_selected_length;
+
+    m_entries.remove (to, -1);
+    m_lengths.remove (to, -1);
+    m_shuffle_nums.remove (to, -1);
+    m_selected.remove (to, n_entries - to);
+    m_queued_flags.remove (to, n_entries - to);
+    m_selected.fill (false);
+
+    auto update = [&] (int & entry_num) {
+        if (entry_num >= before)
+            entry_num = moved_to[entry_num - before];
+    };
+
+    update (m_position);
+    update (m_focus);
+    update (m_shuffle_peeked);
+
+    for (int i = 0; i < m_queued.len (); )
+    {
+        update (m_queued[i]);
+
+        if (m_queued[i] < 0)
         {
-            m_entries[to ++] = std::move (m_entries[from]);
-            after ++;
+            m_queued.remove (i, 1);
+            update_flags |= QueueChanged;
         }
+        else
+            i ++;
     }
 
+    for (int i = 0; i < m_shuffle_history.len (); i ++)
+    {
+        int & entry_num = m_shuffle_history[i];
+        if (entry_num < 0)
+            continue;
+
+        update (entry_num);
+
+        if (entry_num < 0)
+            m_shuffle_played.add (i, -1);
+    }
+
+    m_numbered = aud::min (m_numbered, before);
+    m_shuffle_choices_valid = false;
+
     n_entries = to;
-    m_entries.remove (n_entries, -1);
 
     m_selected_count = 0;
     m_selected_length = 0;
 
-    number_entries (before, n_entries - before);
     queue_update (Playlist::Structure, before, n_entries - after - before, update_flags);
 
     if (position_changed)
@@ -564,146 +717,193 @@ void PlaylistData::remove_selected ()
     }
 }
 
-void PlaylistData::sort_entries (Index<EntryPtr> & entries, const CompareData & data) // static
+void PlaylistData::sort_entries (Index<int> & order, const CompareData & data)
 {
-    entries.sort ([data] (const EntryPtr & a, const EntryPtr & b) {
+    order.sort ([this, data] (int a, int b) {
         if (data.filename_compare)
-            return data.filename_compare (a->filename, b->filename);
+            return data.filename_compare (m_entries[a]->filename, m_entries[b]->filename);
         else
-            return data.tuple_compare (a->tuple, b->tuple);
+            return data.tuple_compare (m_entries[a]->tuple, m_entries[b]->tuple);
     });
 }
 
+/* builds a key for each entry once, so that the sort itself only has to
+ * compare bytes */
+void PlaylistData::sort_entries (Index<int> & order, const SortKeys::Schemes & schemes)
+{
+    SortKeys keys;
+
+    for (int entry_num : order)
+        keys.add (m_entries[entry_num]->filename, m_entries[entry_num]->tuple, schemes);
+
+    keys.sort (order);
+}
+
+static Index<int> identity_order (int len)
+{
+    Index<int> order;
+    order.insert (0, len);
+
+    for (int i = 0; i < len; i ++)
+        order[i] = i;
+
+    return order;
+}
+
 void PlaylistData::sort (const CompareData & data)
 {
-    sort_entries (m_entries, data);
+    Index<int> order = identity_order (m_entries.len ());
+    sort_entries (order, data);
 
-    number_entries (0, m_entries.len ());
+    reorder_entries (0, order);
+    queue_update (Playlist::Structure, 0, m_entries.len ());
+}
+
+void PlaylistData::sort (const SortKeys::Schemes & schemes)
+{
+    Index<int> order = identity_order (m_entries.len ());
+    sort_entries (order, schemes);
+
+    reorder_entries (0, order);
+    queue_update (Playlist::Structure, 0, m_entries.len ());
+}
+
+/* the selected entries trade places among themselves, so that the one at
+ * selected[i] moves to sorted[i] */
+void PlaylistData::place_sorted (const Index<int> & selected, const Index<int> & sorted)
+{
+    int n_selected = selected.len ();
+    int top = selected[0];
+    Index<int> order = identity_order (selected[n_selected - 1] + 1 - top);
+
+    for (int i = 0; i < n_selected; i ++)
+        order[selected[i] - top] = sorted[i] - top;
+
+    reorder_entries (top, order);
     queue_update (Playlist::Structure, 0, m_entries.len ());
 }
 
 void PlaylistData::sort_selected (const CompareData & data)
 {
-    int n_entries = m_entries.len ();
+    if (! m_selected_count)
+        return;
 
-    Index<EntryPtr> selected;
+    Index<int> selected = selected_entries ();
 
-    for (auto & entry : m_entries)
-    {
-        if (entry->selected)
-            selected.append (std::move (entry));
-    }
+    Index<int> sorted;
+    sorted.insert (selected.begin (), 0, selected.len ());
+    sort_entries (sorted, data);
 
-    sort_entries (selected, data);
+    place_sorted (selected, sorted);
+}
 
-    int i = 0;
-    for (auto & entry : m_entries)
-    {
-        if (! entry)
-            entry = std::move (selected[i ++]);
-    }
+void PlaylistData::sort_selected (const SortKeys::Schemes & schemes)
+{
+    if (! m_selected_count)
+        return;
 
-    number_entries (0, n_entries);
-    queue_update (Playlist::Structure, 0, n_entries);
+    Index<int> selected = selected_entries ();
+
+    Index<int> sorted;
+    sorted.insert (selected.begin (), 0, selected.len ());
+    sort_entries (sorted, schemes);
+
+    place_sorted (selected, sorted);
 }
 
 void PlaylistData::reverse_order ()
 {
     int n_entries = m_entries.len ();
 
-    for (int i = 0; i < n_entries / 2; i ++)
-        std::swap (m_entries[i], m_entries[n_entries - 1 - i]);
+    Index<int> order;
+    order.insert (0, n_entries);
+
+    for (int i = 0; i < n_entries; i ++)
+        order[i] = n_entries - 1 - i;
 
-    number_entries (0, n_entries);
+    reorder_entries (0, order);
     queue_update (Playlist::Structure, 0, n_entries);
 }
 
 void PlaylistData::reverse_selected ()
 {
     int n_entries = m_entries.len ();
+    if (! m_selected_count)
+        return;
 
-    int top = 0;
-    int bottom = n_entries - 1;
-
-    while (1)
-    {
-        while (top < bottom && ! m_entries[top]->selected)
-            top ++;
-        while (top < bottom && ! m_entries[bottom]->selected)
-            bottom --;
-
-        if (top >= bottom)
-            break;
+    Index<int> selected = selected_entries ();
+    int n_selected = selected.len ();
+    int top = selected[0];
+    Index<int> order = identity_order (selected[n_selected - 1] + 1 - top);
 
-        std::swap (m_entries[top ++], m_entries[bottom --]);
-    }
+    for (int i = 0; i < n_selected; i ++)
+        order[selected[i] - top] = selected[n_selected - 1 - i] - top;
 
-    number_entries (0, n_entries);
+    reorder_entries (top, order);
     queue_update (Playlist::Structure, 0, n_entries);
 }
 
 void PlaylistData::randomize_order ()
 {
     int n_entries = m_entries.len ();
+    Index<int> order = identity_order (n_entries);
 
     for (int i = 0; i < n_entries; i ++)
-        std::swap (m_entries[i], m_entries[rand () % n_entries]);
+        std::swap (order[i], order[rand () % n_entries]);
 
-    number_entries (0, n_entries);
+    reorder_entries (0, order);
     queue_update (Playlist::Structure, 0, n_entries);
 }
 
 void PlaylistData::randomize_selected ()
 {
     int n_entries = m_entries.len ();
+    if (! m_selected_count)
+        return;
 
-    Index<PlaylistEntry *> selected;
-
-    for (auto & entry : m_entries)
-    {
-        if (entry->selected)
-            selected.append (entry.get ());
-    }
-
+    Index<int> selected = selected_entries ();
     int n_selected = selected.len ();
+    int top = selected[0];
+    Index<int> order = identity_order (selected[n_selected - 1] + 1 - top);
 
     for (int i = 0; i < n_selected; i ++)
     {
-        int a = selected[i]->number;
-        int b = selected[rand () % n_selected]->number;
-        std::swap (m_entries[a], m_entries[b]);
+        int a = selected[i] - top;
+        int b = selected[rand () % n_selected] - top;
+        std::swap (order[a], order[b]);
     }
 
-    number_entries (0, n_entries);
+    reorder_entries (top, order);
     queue_update (Playlist::Structure, 0, n_entries);
 }
 
 int PlaylistData::queue_get_entry (int at) const
 {
-    return (at >= 0 && at < m_queued.len ()) ? m_queued[at]->number : -1;
+    return (at >= 0 && at < m_queued.len ()) ? m_queued[at] : -1;
 }
 
 int PlaylistData::queue_find_entry (int entry_num) const
 {
-    auto entry = entry_at (entry_num);
-    return (entry && entry->queued) ? m_queued.find ((PlaylistEntry *) entry) : -1;
+    if (entry_num < 0 || entry_num >= m_entries.len () || ! m_queued_flags.get (entry_num))
+        return -1;
+
+    return m_queued.find (entry_num);
 }
 
 void PlaylistData::queue_insert (int at, int entry_num)
 {
-    auto entry = entry_at (entry_num);
-    if (! entry || entry->queued)
+    if (entry_num < 0 || entry_num >= m_entries.len () || m_queued_flags.get (entry_num))
         return;
 
     if (at < 0 || at > m_queued.len ())
-        m_queued.append (entry);
+        m_queued.append (entry_num);
     else
     {
         m_queued.insert (at, 1);
-        m_queued[at] = entry;
+        m_queued[at] = entry_num;
     }
 
-    entry->queued = true;
+    m_queued_flags.set (entry_num, true);
 
     queue_update (Playlist::Selection, entry_num, 1, QueueChanged);
 }
@@ -713,19 +913,20 @@ void PlaylistData::queue_insert_selected (int at)
     if (at < 0 || at > m_queued.len ())
         at = m_queued.len ();
 
-    Index<PlaylistEntry *> add;
+    Index<int> add;
     int first = m_entries.len ();
     int last = 0;
 
-    for (auto & entry : m_entries)
+    for (int i = m_selected.find_next (true, 0); i >= 0;
+     i = m_selected.find_next (true, i + 1))
     {
-        if (! entry->selected || entry->queued)
+        if (m_queued_flags.get (i))
             continue;
 
-        add.append (entry.get ());
-        entry->queued = true;
-        first = aud::min (first, entry->number);
-        last = entry->number;
+        add.append (i);
+        m_queued_flags.set (i, true);
+        first = aud::min (first, i);
+        last = i;
     }
 
     m_queued.move_from (add, 0, at, -1, true, true);
@@ -748,10 +949,10 @@ void PlaylistData::queue_remove (int at, int number)
 
     for (int i = at; i < at + number; i ++)
     {
-        PlaylistEntry * entry = m_queued[i];
-        entry->queued = false;
-        first = aud::min (first, entry->number);
-        last = entry->number;
+        int entry_num = m_queued[i];
+        m_queued_flags.set (entry_num, false);
+        first = aud::min (first, entry_num);
+        last = entry_num;
     }
 
     m_queued.remove (at, number);
@@ -767,14 +968,14 @@ void PlaylistData::queue_remove_selected ()
 
     for (int i = 0; i < m_queued.len ();)
     {
-        PlaylistEntry * entry = m_queued[i];
+        int entry_num = m_queued[i];
 
-        if (entry->selected)
+        if (m_selected.get (entry_num))
         {
             m_queued.remove (i, 1);
-            entry->queued = false;
-            first = aud::min (first, entry->number);
-            last = entry->number;
+            m_queued_flags.set (entry_num, false);
+            first = aud::min (first, entry_num);
+            last = entry_num;
         }
         else
             i ++;
@@ -784,147 +985,225 @@ void PlaylistData::queue_remove_selected ()
         queue_update (Playlist::Selection, first, last + 1 - first, QueueChanged);
 }
 
-void PlaylistData::set_position (PlaylistEntry * entry, bool update_shuffle)
+void PlaylistData::move_position (int entry_num, bool update_shuffle)
 {
-    m_position = entry;
+    m_position = entry_num;
     resume_time = 0;
 
     /* move entry to top of shuffle list */
-    if (entry && update_shuffle)
-        entry->shuffle_num = ++ m_last_shuffle_num;
+    if (entry_num >= 0 && update_shuffle)
+        shuffle_append (entry_num);
 }
 
 void PlaylistData::set_position (int entry_num)
 {
-    set_position (entry_at (entry_num), true);
+    if (entry_num < 0 || entry_num >= m_entries.len ())
+        entry_num = -1;
+
+    move_position (entry_num, true);
     queue_position_change ();
 }
 
+/* whether shuffle_next() may choose an entry at random: any entry not yet
+ * played, or with "album_shuffle", only the first of the unplayed entries of an
+ * album (the others are reached by step #2 of shuffle_next) */
+bool PlaylistData::shuffle_choice (int entry_num)
+{
+    if (m_shuffle_nums[entry_num])
+        return false;
+    if (! m_shuffle_by_album || entry_num == 0 || m_shuffle_nums[entry_num - 1])
+        return true;
+
+    return ! same_album (m_entries[entry_num - 1]->tuple, m_entries[entry_num]->tuple);
+}
+
+/* whether an entry may be chosen also depends on the entry before it */
+void PlaylistData::shuffle_update_choices (int entry_num)
+{
+    if (! m_shuffle_choices_valid)
+        return;
+
+    int end = aud::min (entry_num + 2, m_entries.len ());
+
+    for (int i = entry_num; i < end; i ++)
+    {
+        int change = (int) shuffle_choice (i) - m_shuffle_choices.get (i);
+        if (change)
+            m_shuffle_choices.add (i, change);
+    }
+}
+
+void PlaylistData::shuffle_build_choices (bool by_album)
+{
+    m_shuffle_by_album = by_album;
+
+    Index<int> choices;
+    choices.insert (0, m_entries.len ());
+
+    for (int i = 0; i < m_entries.len (); i ++)
+        choices[i] = shuffle_choice (i);
+
+    m_shuffle_choices.build (std::move (choices));
+    m_shuffle_choices_valid = true;
+}
+
+void PlaylistData::shuffle_append (int entry_num)
+{
+    shuffle_forget (entry_num);
+    shuffle_compact ();
+
+    m_shuffle_history.append (entry_num);
+    m_shuffle_played.append (1);
+    m_shuffle_nums[entry_num] = m_shuffle_history.len ();
+
+    shuffle_update_choices (entry_num);
+}
+
+/* note that the entry is not made available to shuffle_next() again; that
+ * is up to the caller */
+void PlaylistData::shuffle_forget (int entry_num)
+{
+    int num = m_shuffle_nums[entry_num];
+    if (! num)
+        return;
+
+    m_shuffle_history[num - 1] = -1;
+    m_shuffle_played.add (num - 1, -1);
+    m_shuffle_nums[entry_num] = 0;
+}
+
+/* renumbers the history once more than half of it is unused */
+void PlaylistData::shuffle_compact ()
+{
+    int n_played = m_shuffle_played.total ();
+    if (m_shuffle_history.len () < 2 * n_played + 64)
+        return;
+
+    int to = 0;
+
+    for (int from = 0; from < m_shuffle_history.len (); from ++)
+    {
+        int entry_num = m_shuffle_history[from];
+        if (entry_num < 0)
+            continue;
+
+        m_shuffle_history[to ++] = entry_num;
+        m_shuffle_nums[entry_num] = to;
+    }
+
+    m_shuffle_history.remove (to, -1);
+
+    Index<int> played;
+    played.insert (0, to);
+
+    for (int & count : played)
+        count = 1;
+
+    m_shuffle_played.build (std::move (played));
+}
+
 bool PlaylistData::shuffle_prev ()
 {
-    PlaylistEntry * found = nullptr;
+    int limit = m_shuffle_history.len ();
 
-    for (auto & entry : m_entries)
+    if (m_position >= 0)
     {
-        if (entry->shuffle_num &&
-            (! m_position || entry->shuffle_num < m_position->shuffle_num) &&
-            (! found || entry->shuffle_num > found->shuffle_num))
-        {
-            found = entry.get ();
-        }
+        limit = m_shuffle_nums[m_position] - 1;
+        if (limit < 0)
+            return false;
     }
 
-    if (! found)
+    int n_before = m_shuffle_played.sum (limit);
+    if (! n_before)
         return false;
 
-    set_position (found, false);
+    move_position (m_shuffle_history[m_shuffle_played.find (n_before - 1)], false);
     return true;
 }
 
-bool PlaylistData::shuffle_next ()
+/* chooses the entry that shuffle_next() moves to, without moving there;
+ * <in_history> is set if the entry is already in the shuffle history.  A random
+ * choice is kept until it is taken, so that it is not made differently the
+ * next time.  Returns -1 if every entry has been played. */
+int PlaylistData::shuffle_pick (bool & in_history)
 {
     bool by_album = aud_get_bool ("album_shuffle");
+    int n_entries = m_entries.len ();
 
-    // helper: determine whether an entry is among the shuffle choices
-    auto is_choice = [&] (PlaylistEntry * prev, PlaylistEntry * entry)
-    {
-        return (! entry->shuffle_num) && (! by_album || ! prev ||
-         prev->shuffle_num || ! same_album (prev->tuple, entry->tuple));
-    };
+    in_history = false;
 
-    if (m_position)
+    if (m_position >= 0)
     {
         // step #1: check to see if the shuffle order is already established
-        PlaylistEntry * next = nullptr;
+        int n_before = m_shuffle_played.sum (m_shuffle_nums[m_position]);
 
-        for (auto & entry : m_entries)
+        if (n_before < m_shuffle_played.total ())
         {
-            if (entry->shuffle_num > m_position->shuffle_num &&
-             (! next || entry->shuffle_num < next->shuffle_num))
-                next = entry.get ();
-        }
-
-        if (next)
-        {
-            set_position (next, false);
-            return true;
+            in_history = true;
+            return m_shuffle_history[m_shuffle_played.find (n_before)];
         }
 
         // step #2: check to see if we should advance to the next entry
-        if (by_album && m_position->number + 1 < m_entries.len ())
+        if (by_album && m_position + 1 < n_entries)
         {
-            next = m_entries[m_position->number + 1].get ();
+            int next = m_position + 1;
 
-            if (! next->shuffle_num && same_album (m_position->tuple, next->tuple))
-            {
-                set_position (next, true);
-                return true;
-            }
+            if (! m_shuffle_nums[next] &&
+             same_album (m_entries[m_position]->tuple, m_entries[next]->tuple))
+                return next;
         }
     }
 
     // step #3: count the number of possible shuffle choices
-    int choices = 0;
-    PlaylistEntry * prev = nullptr;
-
-    for (auto & entry : m_entries)
-    {
-        if (is_choice (prev, entry.get ()))
-            choices ++;
-
-        prev = entry.get ();
-    }
+    if (! m_shuffle_choices_valid || m_shuffle_by_album != by_album)
+        shuffle_build_choices (by_album);
 
+    int choices = m_shuffle_choices.total ();
     if (! choices)
-        return false;
-
-    // step #4: pick one of those choices by random and find it again
-    choices = rand () % choices;
-    prev = nullptr;
+        return -1;
 
-    for (auto & entry : m_entries)
-    {
-        if (is_choice (prev, entry.get ()))
-        {
-            if (! choices)
-            {
-                set_position (entry.get (), true);
-                return true;
-            }
+    // step #4: pick one of those choices by random and find it, unless one
+    // was picked already and is still available
+    if (m_shuffle_peeked < 0 || ! m_shuffle_choices.get (m_shuffle_peeked))
+        m_shuffle_peeked = m_shuffle_choices.find (rand () % choices);
 
-            choices --;
-        }
+    return m_shuffle_peeked;
+}
 
-        prev = entry.get ();
-    }
+bool PlaylistData::shuffle_next ()
+{
+    bool in_history;
+    int entry_num = shuffle_pick (in_history);
+    if (entry_num < 0)
+        return false;
 
-    return false;  // never reached
+    m_shuffle_peeked = -1;
+    move_position (entry_num, ! in_history);
+    return true;
 }
 
 void PlaylistData::shuffle_reset ()
 {
-    m_last_shuffle_num = 0;
+    for (int & num : m_shuffle_nums)
+        num = 0;
 
-    for (auto & entry : m_entries)
-        entry->shuffle_num = 0;
+    m_shuffle_history.clear ();
+    m_shuffle_played.clear ();
+    m_shuffle_choices_valid = false;
+    m_shuffle_peeked = -1;
 }
 
 Index<int> PlaylistData::shuffle_history () const
 {
     Index<int> history;
 
-    // create a list of all entries in the shuffle list
-    for (auto & entry : m_entries)
+    // the history is already in shuffle order
+    for (int entry_num : m_shuffle_history)
     {
-        if (entry->shuffle_num)
-            history.append (entry->number);
+        if (entry_num >= 0)
+            history.append (entry_num);
     }
 
-    // sort by shuffle order
-    history.sort ([this] (int entry_a, int entry_b) {
-        return m_entries[entry_a]->shuffle_num - m_entries[entry_b]->shuffle_num;
-    });
-
     return history;
 }
 
@@ -935,9 +1214,8 @@ void PlaylistData::shuffle_replay (const Index<int> & history)
     // replay the given history, entry by entry
     for (int entry_num : history)
     {
-        auto entry = entry_at (entry_num);
-        if (entry)
-            entry->shuffle_num = ++ m_last_shuffle_num;
+        if (entry_num >= 0 && entry_num < m_entries.len ())
+            shuffle_append (entry_num);
     }
 }
 
@@ -954,7 +1232,7 @@ bool PlaylistData::prev_song ()
         if (pos < 1)
             return false;
 
-        set_position (m_entries[pos - 1].get (), true);
+        move_position (pos - 1, true);
     }
 
     queue_position_change ();
@@ -982,7 +1260,7 @@ bool PlaylistData::prev_album ()
             if ( position() == start_position)
                 return false;
 
-            if (! same_album (m_position->tuple, start_tuple))
+            if (! same_album (m_entries[m_position]->tuple, start_tuple))
                 break;
         }
     }
@@ -1001,10 +1279,10 @@ bool PlaylistData::next_song_with_hint (bool repeat, int hint)
     if (! n_entries)
         return false;
 
-    PlaylistEntry * entry;
-    if ((entry = queue_pop ()))
+    int entry_num;
+    if ((entry_num = queue_pop ()) >= 0)
     {
-        set_position (entry, true);
+        move_position (entry_num, true);
         return true;
     }
 
@@ -1029,7 +1307,7 @@ bool PlaylistData::next_song_with_hint (bool repeat, int hint)
         hint = 0;
     }
 
-    set_position (m_entries[hint].get (), true);
+    move_position (hint, true);
     return true;
 }
 
@@ -1042,6 +1320,40 @@ bool PlaylistData::next_song (bool repeat)
     return true;
 }
 
+/* Returns the entry that next_song() would move to, without moving there.  In
+ * shuffle mode, a random choice is remembered (but not yet recorded in the
+ * shuffle order), so that next_song() will still pick the same entry.  Returns
+ * null if the shuffle order would have to be reset. */
+PlaylistEntry * PlaylistData::peek_next_song (bool repeat)
+{
+    int n_entries = m_entries.len ();
+    if (! n_entries)
+        return nullptr;
+
+    if (m_queued.len ())
+        return m_entries[m_queued[0]].get ();
+
+    if (aud_get_bool ("shuffle"))
+    {
+        bool in_history;
+        int next = shuffle_pick (in_history);
+
+        return (next >= 0) ? m_entries[next].get () : nullptr;
+    }
+
+    int hint = position () + 1;
+
+    if (hint >= n_entries)
+    {
+        if (! repeat)
+            return nullptr;
+
+        hint = 0;
+    }
+
+    return m_entries[hint].get ();
+}
+
 bool PlaylistData::next_album (bool repeat)
 {
     int start_position = position ();
@@ -1061,7 +1373,7 @@ bool PlaylistData::next_album (bool repeat)
         if ( position() == start_position)
             return false;
 
-        if (! same_album (m_position->tuple, start_tuple))
+        if (! same_album (m_entries[m_position]->tuple, start_tuple))
             break;
     }
 
@@ -1096,8 +1408,11 @@ ScanRequest * PlaylistData::create_scan_request (PlaylistEntry * entry,
         flags |= SCAN_TUPLE;
 
     /* scanner uses Tuple::AudioFile from existing tuple, if valid */
-    return new ScanRequest (entry->filename, flags, callback, entry->decoder,
-     (flags & SCAN_TUPLE) ? Tuple () : entry->tuple.ref ());
+    auto request = new ScanRequest (entry->filename, flags, callback,
+     entry->decoder, (flags & SCAN_TUPLE) ? Tuple () : entry->tuple.ref ());
+
+    request->known_stamp = entry->stamp;
+    return request;
 }
 
 void PlaylistData::update_entry_from_scan (PlaylistEntry * entry, ScanRequest * request, int update_flags)
@@ -1107,8 +1422,9 @@ void PlaylistData::update_entry_from_scan (PlaylistEntry * entry, ScanRequest *
 
     if (! entry->tuple.valid () && request->tuple.valid ())
     {
-        set_entry_tuple (entry, std::move (request->tuple));
-        queue_update (Playlist::Metadata, entry->number, 1, update_flags);
+        int entry_num = entry_number (entry);
+        set_entry_tuple (entry_num, std::move (request->tuple));
+        queue_update (Playlist::Metadata, entry_num, 1, update_flags);
     }
 
     if (! entry->decoder || ! entry->tuple.valid ())
@@ -1117,17 +1433,44 @@ void PlaylistData::update_entry_from_scan (PlaylistEntry * entry, ScanRequest *
     if (entry->tuple.state () == Tuple::Initial)
     {
         entry->tuple.set_state (Tuple::Failed);
-        queue_update (Playlist::Metadata, entry->number, 1, update_flags);
+        queue_update (Playlist::Metadata, entry_number (entry), 1, update_flags);
+    }
+
+    if (entry->decoder && entry->tuple.valid ())
+        entry->stamp = request->stamp;
+}
+
+/* replaces the tuple of an entry with one read again from the file; returns
+ * true if anything has changed */
+bool PlaylistData::refresh_entry_from_scan (PlaylistEntry * entry, ScanRequest * request)
+{
+    if (! request->tuple.valid ())
+    {
+        /* the file could not be read; scan it fully next time */
+        entry->stamp = FileStamp ();
+        return false;
     }
+
+    int entry_num = entry_number (entry);
+
+    Tuple old_tuple = entry->tuple.ref ();
+    set_entry_tuple (entry_num, std::move (request->tuple));
+    entry->stamp = request->stamp;
+
+    if (entry->tuple == old_tuple)
+        return false;
+
+    queue_update (Playlist::Metadata, entry_num, 1);
+    return true;
 }
 
 void PlaylistData::update_playback_entry (Tuple && tuple)
 {
     /* don't update cuesheet entries with stream metadata */
-    if (m_position && ! m_position->tuple.is_set (Tuple::StartTime))
+    if (m_position >= 0 && ! m_entries[m_position]->tuple.is_set (Tuple::StartTime))
     {
         set_entry_tuple (m_position, std::move (tuple));
-        queue_update (Playlist::Metadata, m_position->number, 1);
+        queue_update (Playlist::Metadata, m_position, 1);
     }
 }
 
@@ -1150,10 +1493,16 @@ void PlaylistData::reformat_titles ()
 
 void PlaylistData::reset_tuples (bool selected_only)
 {
-    for (auto & entry : m_entries)
+    if (selected_only)
     {
-        if (! selected_only || entry->selected)
-            set_entry_tuple (entry.get (), Tuple ());
+        for (int i = m_selected.find_next (true, 0); i >= 0;
+         i = m_selected.find_next (true, i + 1))
+            set_entry_tuple (i, Tuple ());
+    }
+    else
+    {
+        for (int i = 0; i < m_entries.len (); i ++)
+            set_entry_tuple (i, Tuple ());
     }
 
     queue_update (Playlist::Metadata, 0, m_entries.len ());
@@ -1164,12 +1513,12 @@ void PlaylistData::reset_tuple_of_file (const char * filename)
 {
     bool found = false;
 
-    for (auto & entry : m_entries)
+    for (int i = 0; i < m_entries.len (); i ++)
     {
-        if (! strcmp (entry->filename, filename))
+        if (! strcmp (m_entries[i]->filename, filename))
         {
-            set_entry_tuple (entry.get (), Tuple ());
-            queue_update (Playlist::Metadata, entry->number, 1);
+            set_entry_tuple (i, Tuple ());
+            queue_update (Playlist::Metadata, i, 1);
             found = true;
         }
     }
@@ -1178,38 +1527,28 @@ void PlaylistData::reset_tuple_of_file (const char * filename)
         pl_signal_rescan_needed (m_id);
 }
 
-PlaylistEntry * PlaylistData::find_unselected_focus ()
+int PlaylistData::find_unselected_focus ()
 {
-    if (! m_focus || ! m_focus->selected)
+    if (m_focus < 0 || ! m_selected.get (m_focus))
         return m_focus;
 
-    int n_entries = m_entries.len ();
-
-    for (int search = m_focus->number + 1; search < n_entries; search ++)
-    {
-        if (! m_entries[search]->selected)
-            return m_entries[search].get ();
-    }
+    int search = m_selected.find_next (false, m_focus + 1);
+    if (search < 0)
+        search = m_selected.find_prev (false, m_focus - 1);
 
-    for (int search = m_focus->number; search --;)
-    {
-        if (! m_entries[search]->selected)
-            return m_entries[search].get ();
-    }
-
-    return nullptr;
+    return search;
 }
 
-PlaylistEntry * PlaylistData::queue_pop ()
+int PlaylistData::queue_pop ()
 {
     if (! m_queued.len ())
-        return nullptr;
+        return -1;
 
-    auto entry = m_queued[0];
+    int entry_num = m_queued[0];
     m_queued.remove (0, 1);
-    entry->queued = false;
+    m_queued_flags.set (entry_num, false);
 
-    queue_update (Playlist::Selection, entry->number, 1, QueueChanged);
+    queue_update (Playlist::Selection, entry_num, 1, QueueChanged);
 
-    return entry;
+    return entry_num;
 }
@@ -20,8 +20,11 @@
 #ifndef PLAYLIST_DATA_H
 #define PLAYLIST_DATA_H
 
+#include "bit-index.h"
+#include "count-tree.h"
 #include "playlist.h"
 #include "scanner.h"
+#include "sort-keys.h"
 
 class TupleCompiler;
 struct PlaylistEntry;
@@ -73,11 +76,14 @@ public:
 
     void select_entry (int entry_num, bool selected);
     void select_all (bool selected);
+    void invert_selection ();
     int shift_entries (int entry_num, int distance);
     void remove_selected ();
 
     void sort (const CompareData & data);
     void sort_selected (const CompareData & data);
+    void sort (const SortKeys::Schemes & schemes);
+    void sort_selected (const SortKeys::Schemes & schemes);
 
     void reverse_order ();
     void randomize_order ();
@@ -101,12 +107,14 @@ public:
     bool prev_album ();
     bool next_song (bool repeat);
     bool next_album (bool repeat);
+    PlaylistEntry * peek_next_song (bool repeat);
 
     int next_unscanned_entry (int entry_num) const;
     bool entry_needs_rescan (PlaylistEntry * entry, bool need_decoder, bool need_tuple);
     ScanRequest * create_scan_request (PlaylistEntry * entry,
      ScanRequest::Callback callback, int extra_flags);
     void update_entry_from_scan (PlaylistEntry * entry, ScanRequest * request, int update_flags);
+    bool refresh_entry_from_scan (PlaylistEntry * entry, ScanRequest * request);
     void update_playback_entry (Tuple && tuple);
 
     void reformat_titles ();
@@ -131,25 +139,39 @@ private:
     static void delete_entry (PlaylistEntry * entry);
     typedef SmartPtr<PlaylistEntry, delete_entry> EntryPtr;
 
-    void number_entries (int at, int length);
-    void set_entry_tuple (PlaylistEntry * entry, Tuple && tuple);
+    int entry_number (PlaylistEntry * entry);
+    void shift_numbers (int from, int delta);
+    void reorder_entries (int at, const Index<int> & order);
+    Index<int> selected_entries () const;
+
+    void set_entry_tuple (int entry_num, Tuple && tuple);
     void queue_update (Playlist::UpdateLevel level, int at, int count, int flags = 0);
     void queue_position_change ();
 
     bool same_album (const Tuple & a, const Tuple & b);
 
-    static void sort_entries (Index<EntryPtr> & entries, const CompareData & data);
+    void sort_entries (Index<int> & order, const CompareData & data);
+    void sort_entries (Index<int> & order, const SortKeys::Schemes & schemes);
+    void place_sorted (const Index<int> & selected, const Index<int> & sorted);
+
+    void move_position (int entry_num, bool update_shuffle);
 
-    void set_position (PlaylistEntry * entry, bool update_shuffle);
+    bool shuffle_choice (int entry_num);
+    void shuffle_update_choices (int entry_num);
+    void shuffle_build_choices (bool by_album);
+    void shuffle_append (int entry_num);
+    void shuffle_forget (int entry_num);
+    void shuffle_compact ();
 
     bool shuffle_prev ();
+    int shuffle_pick (bool & in_history);
     bool shuffle_next ();
     void shuffle_reset ();
 
     bool next_song_with_hint (bool repeat, int hint);
 
-    PlaylistEntry * find_unselected_focus ();
-    PlaylistEntry * queue_pop ();
+    int find_unselected_focus ();
+    int queue_pop ();
 
 public:
     bool modified;
@@ -159,11 +181,32 @@ public:
 
 private:
     Playlist::ID * m_id;
+
+    /* The entries are stored as columns, indexed by entry number.  Only what
+     * is needed to scan and display an entry is kept in a PlaylistEntry; the
+     * state that whole-playlist operations work on is packed separately.
+     * The position, focus, and queue refer to entries by number; these are
+     * adjusted whenever entries are inserted, removed, or moved. */
     Index<EntryPtr> m_entries;
-    PlaylistEntry * m_position, * m_focus;
+    Index<int> m_lengths;
+    Index<int> m_shuffle_nums;
+    BitIndex m_selected, m_queued_flags;
+    int m_numbered; /* see entry_number() */
+
+    int m_position, m_focus;
     int m_selected_count;
-    int m_last_shuffle_num;
-    Index<PlaylistEntry *> m_queued;
+    Index<int> m_queued;
+
+    /* An entry's shuffle number is its place (from 1) in the shuffle history,
+     * or 0 if it has not been played.  The history maps each number back to
+     * an entry, or to -1 once the entry has moved on or been removed; one
+     * count tree counts the numbers still in use, and the other the entries
+     * shuffle_next() may choose from.  The latter is built when needed. */
+    Index<int> m_shuffle_history;
+    CountTree m_shuffle_played, m_shuffle_choices;
+    bool m_shuffle_choices_valid, m_shuffle_by_album;
+    int m_shuffle_peeked; /* random choice made by peek_next_song(), or -1 */
+
     int64_t m_total_length, m_selected_length;
     Playlist::Update m_last_update, m_next_update;
     bool m_position_changed;
@@ -51,6 +51,16 @@ public:
 
     bool insert_flat_playlist (const char * filename) const;
     void insert_flat_items (int at, Index<PlaylistAddItem> && items) const;
+
+    /* copies the filenames and tuples of all entries under a single lock,
+     * waiting for the tuples to be scanned if <need_tuples> is set */
+    void get_entries (Index<String> & filenames, Index<Tuple> & tuples, bool need_tuples) const;
+
+    /* removes the given entries, provided that the entries are still those
+     * whose filenames (and, unless <tuples> is empty, tuples) are given;
+     * returns false if the playlist has changed */
+    bool remove_listed (const Index<String> & filenames, const Index<Tuple> & tuples,
+     const Index<int> & entries) const;
 };
 
 /* playlist.cc */
@@ -63,6 +73,7 @@ void playlist_load_state ();
 void playlist_save_state ();
 
 DecodeInfo playback_entry_read (int serial);
+void playback_entry_preroll (int serial);
 void playback_entry_set_tuple (int serial, Tuple && tuple);
 
 /* playlist-cache.cc */
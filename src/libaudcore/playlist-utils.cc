@@ -28,173 +28,69 @@
 #include "hook.h"
 #include "multihash.h"
 #include "runtime.h"
+#include "sort-keys.h"
 #include "tuple.h"
 #include "vfs.h"
 
-static const char * get_basename (const char * filename)
+/* an entry's key, compared and hashed as a whole */
+struct DuplicateKey
 {
-    const char * slash = strrchr (filename, '/');
-    return slash ? slash + 1 : filename;
-}
-
-static int filename_compare_path (const char * a, const char * b)
-{
-    int dirlen_a = get_basename (a) - a;
-    int dirlen_b = get_basename (b) - b;
-
-    // if one folder is a subfolder of the other, sort it last
-    if (dirlen_a != dirlen_b && memcmp (a, b, aud::min (dirlen_a, dirlen_b)) == 0)
-        return dirlen_a - dirlen_b;
-
-    // in all other cases, compare the entire paths
-    return str_compare_encoded (a, b);
-}
-
-static int filename_compare_basename (const char * a, const char * b)
-{
-    return str_compare_encoded (get_basename (a), get_basename (b));
-}
-
-static int tuple_compare_string (const Tuple & a, const Tuple & b, Tuple::Field field)
-{
-    String string_a = a.get_str (field);
-    String string_b = b.get_str (field);
-
-    if (! string_a)
-        return (! string_b) ? 0 : -1;
-
-    return (! string_b) ? 1 : str_compare (string_a, string_b);
-}
-
-static int tuple_compare_int (const Tuple & a, const Tuple & b, Tuple::Field field)
-{
-    if (a.get_value_type (field) != Tuple::Int)
-        return (b.get_value_type (field) != Tuple::Int) ? 0 : -1;
-    if (b.get_value_type (field) != Tuple::Int)
-        return 1;
-
-    int int_a = a.get_int (field);
-    int int_b = b.get_int (field);
-
-    return (int_a < int_b) ? -1 : (int_a > int_b);
-}
-
-static int tuple_compare_title (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::Title); }
-static int tuple_compare_album (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::Album); }
-static int tuple_compare_artist (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::Artist); }
-static int tuple_compare_album_artist (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::AlbumArtist); }
-static int tuple_compare_date (const Tuple & a, const Tuple & b)
-    { return tuple_compare_int (a, b, Tuple::Year); }
-static int tuple_compare_genre (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::Genre); }
-static int tuple_compare_track (const Tuple & a, const Tuple & b)
-    { return tuple_compare_int (a, b, Tuple::Track); }
-static int tuple_compare_formatted_title (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::FormattedTitle); }
-static int tuple_compare_length (const Tuple & a, const Tuple & b)
-    { return tuple_compare_int (a, b, Tuple::Length); }
-static int tuple_compare_comment (const Tuple & a, const Tuple & b)
-    { return tuple_compare_string (a, b, Tuple::Comment); }
-
-static const Playlist::StringCompareFunc filename_comparisons[] = {
-    filename_compare_path,  // path
-    filename_compare_basename,  // filename
-    nullptr,  // title
-    nullptr,  // album
-    nullptr,  // artist
-    nullptr,  // album artist
-    nullptr,  // date
-    nullptr,  // genre
-    nullptr,  // track
-    nullptr,  // formatted title
-    nullptr,  // length
-    nullptr   // comment
-};
+    const SortKeys * keys;
+    int entry;
 
-static const Playlist::TupleCompareFunc tuple_comparisons[] = {
-    nullptr,  // path
-    nullptr,  // filename
-    tuple_compare_title,
-    tuple_compare_album,
-    tuple_compare_artist,
-    tuple_compare_album_artist,
-    tuple_compare_date,
-    tuple_compare_genre,
-    tuple_compare_track,
-    tuple_compare_formatted_title,
-    tuple_compare_length,
-    tuple_compare_comment
+    bool operator== (const DuplicateKey & b) const
+        { return ! keys->compare (entry, b.entry); }
+    unsigned hash () const
+        { return keys->hash (entry); }
 };
 
-static_assert (aud::n_elems (filename_comparisons) == Playlist::n_sort_types &&
- aud::n_elems (tuple_comparisons) == Playlist::n_sort_types,
- "Update playlist comparison functions");
-
 EXPORT void Playlist::sort_entries (SortType scheme) const
-{
-    if (filename_comparisons[scheme])
-        sort_by_filename (filename_comparisons[scheme]);
-    else if (tuple_comparisons[scheme])
-        sort_by_tuple (tuple_comparisons[scheme]);
-}
-
+    { sort_entries ({scheme}); }
 EXPORT void Playlist::sort_selected (SortType scheme) const
-{
-    if (filename_comparisons[scheme])
-        sort_selected_by_filename (filename_comparisons[scheme]);
-    else if (tuple_comparisons[scheme])
-        sort_selected_by_tuple (tuple_comparisons[scheme]);
-}
+    { sort_selected ({scheme}); }
 
-/* FIXME: this considers empty fields as duplicates */
 EXPORT void Playlist::remove_duplicates (SortType scheme) const
 {
-    int entries = n_entries ();
-    if (entries < 1)
-        return;
+    PlaylistEx playlist = * this;
+    bool need_tuples = (scheme != Path && scheme != Filename);
 
-    select_all (false);
+    Index<String> filenames;
+    Index<Tuple> tuples;
+    Index<int> duplicates;
 
-    if (filename_comparisons[scheme])
+    /* the keys are built and hashed without holding the playlist lock; if the
+     * playlist changes meanwhile (including the tuples, if the keys are built
+     * from them), start over */
+    do
     {
-        StringCompareFunc compare = filename_comparisons[scheme];
-
-        sort_by_filename (compare);
-        String last = entry_filename (0);
+        filenames.clear ();
+        tuples.clear ();
+        duplicates.clear ();
 
-        for (int i = 1; i < entries; i ++)
-        {
-            String current = entry_filename (i);
-
-            if (compare (last, current) == 0)
-                select_entry (i, true);
-
-            last = current;
-        }
-    }
-    else if (tuple_comparisons[scheme])
-    {
-        TupleCompareFunc compare = tuple_comparisons[scheme];
+        playlist.get_entries (filenames, tuples, need_tuples);
 
-        sort_by_tuple (compare);
-        Tuple last = entry_tuple (0);
+        SortKeys keys;
+        SimpleHash<DuplicateKey, bool> seen;
 
-        for (int i = 1; i < entries; i ++)
+        for (int i = 0; i < filenames.len (); i ++)
         {
-            Tuple current = entry_tuple (i);
+            /* entries with an empty field are not duplicates of each other */
+            if (! keys.add (filenames[i], tuples[i], {scheme}))
+                continue;
 
-            if (last.valid () && current.valid () && compare (last, current) == 0)
-                select_entry (i, true);
+            DuplicateKey key = {& keys, i};
 
-            last = std::move (current);
+            if (seen.lookup (key))
+                duplicates.append (i);
+            else
+                seen.add (key, true);
         }
-    }
 
-    remove_selected ();
+        /* a path or filename does not depend on the tuple */
+        if (! need_tuples)
+            tuples.clear ();
+    }
+    while (! playlist.remove_listed (filenames, tuples, duplicates));
 }
 
 EXPORT void Playlist::remove_unavailable () const
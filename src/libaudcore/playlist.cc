@@ -118,24 +118,44 @@ static UpdateState update_state;
 struct ScanItem : public ListNode
 {
     ScanItem (PlaylistData * playlist, PlaylistEntry * entry,
-     ScanRequest * request, bool for_playback) :
+     ScanRequest * request, bool for_playback, bool refresh = false) :
         playlist (playlist),
         entry (entry),
         request (request),
         for_playback (for_playback),
-        handled_by_playback (false) {}
+        handled_by_playback (false),
+        refresh (refresh) {}
 
     PlaylistData * playlist;
     PlaylistEntry * entry;
     ScanRequest * request;
     bool for_playback;
     bool handled_by_playback;
+    bool refresh;
 };
 
 static bool scan_enabled_nominal, scan_enabled;
 static int scan_playlist, scan_row;
 static List<ScanItem> scan_list;
 
+/* Shortly before the current song ends, the next one is scanned and its file
+ * opened on a scanner thread (see playback_entry_preroll), so that the
+ * playback thread can start decoding it as soon as the current one is done. */
+struct PrerollState
+{
+    PlaylistData * playlist = nullptr;
+    PlaylistEntry * entry = nullptr;
+    ScanRequest * request = nullptr; /* null once finished */
+    bool done = false;
+
+    /* results of the scan, valid once done */
+    DecodeInfo dec;
+    Index<char> image_data;
+    String image_file;
+};
+
+static PrerollState preroll;
+
 static void scan_finish (ScanRequest * request);
 static void scan_cancel (PlaylistEntry * entry);
 static void scan_restart ();
@@ -287,7 +307,7 @@ static ScanItem * scan_list_find_entry (PlaylistEntry * entry)
 
 static void scan_queue_entry (PlaylistData * playlist, PlaylistEntry * entry, bool for_playback = false)
 {
-    int extra_flags = for_playback ? (SCAN_IMAGE | SCAN_FILE) : 0;
+    int extra_flags = for_playback ? (SCAN_IMAGE | SCAN_FILE | SCAN_QUICK) : 0;
     auto request = playlist->create_scan_request (entry, scan_finish, extra_flags);
 
     scan_list.append (new ScanItem (playlist, entry, request, for_playback));
@@ -297,6 +317,15 @@ static void scan_queue_entry (PlaylistData * playlist, PlaylistEntry * entry, bo
         scanner_request (request);
 }
 
+/* re-reads the tag of an entry whose playback was started without doing so */
+static void scan_refresh_entry (PlaylistData * playlist, PlaylistEntry * entry)
+{
+    auto request = playlist->create_scan_request (entry, scan_finish, SCAN_TUPLE);
+
+    scan_list.append (new ScanItem (playlist, entry, request, false, true));
+    scanner_request (request);
+}
+
 static void scan_reset_playback ()
 {
     auto match = [] (const ScanItem & item)
@@ -409,7 +438,16 @@ static void scan_finish (ScanRequest * request)
     if (scan_enabled && playlist->scan_status != PlaylistData::NotScanning)
         update_flags = PlaylistData::DelayedUpdate;
 
-    playlist->update_entry_from_scan (entry, request, update_flags);
+    if (item->refresh)
+    {
+        // pass the new tag on to the playback module, if still playing
+        int pos = playlist->position ();
+        if (playlist->refresh_entry_from_scan (entry, request) && playing_id &&
+         playing_id->data == playlist && playlist->entry_at (pos) == entry)
+            playback_set_info (pos, playlist->entry_tuple (pos));
+    }
+    else
+        playlist->update_entry_from_scan (entry, request, update_flags);
 
     delete item;
 
@@ -419,6 +457,35 @@ static void scan_finish (ScanRequest * request)
     condvar.notify_all ();
 }
 
+static void preroll_finish (ScanRequest * request)
+{
+    auto mh = mutex.take ();
+
+    /* ignore the request if the pre-roll was canceled meanwhile */
+    if (request != preroll.request)
+        return;
+
+    preroll.playlist->update_entry_from_scan (preroll.entry, request, 0);
+
+    preroll.dec.filename = request->filename;
+    preroll.dec.ip = request->ip;
+    preroll.dec.file = std::move (request->file);
+    preroll.dec.error = std::move (request->error);
+    preroll.image_data = std::move (request->image_data);
+    preroll.image_file = std::move (request->image_file);
+
+    preroll.request = nullptr;
+    preroll.done = true;
+
+    condvar.notify_all ();
+}
+
+static void preroll_cancel ()
+{
+    /* a running request is left to finish and then ignored */
+    preroll = PrerollState ();
+}
+
 static void scan_cancel (PlaylistEntry * entry)
 {
     ScanItem * item = scan_list_find_entry (entry);
@@ -476,16 +543,22 @@ static void start_playback_locked (int seek_time, bool pause)
     auto playlist = playing_id->data;
     auto entry = playlist->entry_at (playlist->position ());
 
-    // playback always begins with a rescan of the current entry in order to
-    // open the file, ensure a valid tuple, and read album art
+    // playback always begins with a scan of the current entry in order to
+    // open the file, ensure a valid tuple, and read album art (unless this was
+    // already done by the pre-roll); if the file has not changed since it was
+    // last scanned, the tag and album art are instead read in the background
     scan_cancel (entry);
     scan_queue_entry (playlist, entry, true);
+
+    if (entry != preroll.entry)
+        preroll_cancel ();
 }
 
 static void stop_playback_locked ()
 {
     art_clear_current ();
     scan_reset_playback ();
+    preroll_cancel ();
 
     playback_stop ();
 }
@@ -493,6 +566,9 @@ static void stop_playback_locked ()
 void pl_signal_entry_deleted (PlaylistEntry * entry)
 {
     scan_cancel (entry);
+
+    if (entry == preroll.entry)
+        preroll_cancel ();
 }
 
 void pl_signal_position_changed (Playlist::ID * id)
@@ -675,6 +751,8 @@ EXPORT int Playlist::n_selected (int at, int number) const
     { SIMPLE_WRAPPER (int, 0, n_selected, at, number); }
 EXPORT void Playlist::select_all (bool selected) const
     { SIMPLE_VOID_WRAPPER (select_all, selected); }
+EXPORT void Playlist::invert_selection () const
+    { SIMPLE_VOID_WRAPPER (invert_selection); }
 EXPORT int Playlist::shift_entries (int entry_num, int distance) const
     { SIMPLE_WRAPPER (int, 0, shift_entries, entry_num, distance); }
 EXPORT void Playlist::remove_selected () const
@@ -688,6 +766,10 @@ EXPORT void Playlist::sort_selected_by_filename (StringCompareFunc compare) cons
     { SIMPLE_VOID_WRAPPER (sort_selected, {compare, nullptr}); }
 EXPORT void Playlist::sort_selected_by_tuple (TupleCompareFunc compare) const
     { SIMPLE_VOID_WRAPPER (sort_selected, {nullptr, compare}); }
+EXPORT void Playlist::sort_entries (const std::initializer_list<SortType> & schemes) const
+    { SIMPLE_VOID_WRAPPER (sort, schemes); }
+EXPORT void Playlist::sort_selected (const std::initializer_list<SortType> & schemes) const
+    { SIMPLE_VOID_WRAPPER (sort_selected, schemes); }
 EXPORT void Playlist::reverse_order () const
     { SIMPLE_VOID_WRAPPER (reverse_order); }
 EXPORT void Playlist::reverse_selected () const
@@ -1028,6 +1110,54 @@ EXPORT Tuple Playlist::entry_tuple (int entry_num, GetMode mode, String * error)
     return playlist->entry_tuple (entry_num, error);
 }
 
+void PlaylistEx::get_entries (Index<String> & filenames, Index<Tuple> & tuples,
+ bool need_tuples) const
+{
+    ENTER_GET_PLAYLIST ();
+
+    // the playlist may change while waiting; that is up to the caller
+    for (int i = 0; i < playlist->n_entries (); i ++)
+    {
+        if (need_tuples)
+            wait_for_entry (mh, playlist, i, false, true);
+
+        filenames.append (playlist->entry_filename (i));
+        tuples.append (playlist->entry_tuple (i));
+    }
+}
+
+bool PlaylistEx::remove_listed (const Index<String> & filenames,
+ const Index<Tuple> & tuples, const Index<int> & entries) const
+{
+    // a deleted playlist has nothing left to remove
+    ENTER_GET_PLAYLIST (true);
+
+    int n_entries = playlist->n_entries ();
+    if (n_entries != filenames.len ())
+        return false;
+
+    for (int i = 0; i < n_entries; i ++)
+    {
+        if (! (playlist->entry_filename (i) == filenames[i]))
+            return false;
+
+        // an entry rescanned meanwhile may no longer be a duplicate
+        if (tuples.len () && playlist->entry_tuple (i) != tuples[i])
+            return false;
+    }
+
+    if (! entries.len ())
+        return true;
+
+    playlist->select_all (false);
+
+    for (int entry_num : entries)
+        playlist->select_entry (entry_num, true);
+
+    playlist->remove_selected ();
+    return true;
+}
+
 EXPORT void Playlist::rescan_file (const char * filename)
 {
     auto mh = mutex.take ();
@@ -1053,9 +1183,38 @@ DecodeInfo playback_entry_read (int serial)
         ScanRequest * request = item->request;
         item->handled_by_playback = true;
 
-        mh.unlock ();
-        request->run ();
-        mh.lock ();
+        // if the entry was pre-rolled, wait for that scan instead of repeating
+        // it (if the entry is deleted meanwhile, the pre-roll is canceled)
+        while (entry == preroll.entry && ! preroll.done)
+            condvar.wait (mh);
+
+        PrerollState ready;
+        bool prerolled = (entry == preroll.entry);
+
+        if (prerolled)
+        {
+            ready = std::move (preroll);
+            preroll_cancel ();
+
+            auto match = [request] (const ScanItem & item)
+                { return item.request == request; };
+
+            // the scan item is not needed, and its request is never run
+            if ((item = scan_list.find (match)))
+            {
+                scan_list.remove (item);
+                delete item;
+            }
+
+            scan_check_complete (playlist);
+            scan_schedule ();
+        }
+        else
+        {
+            mh.unlock ();
+            request->run ();
+            mh.lock ();
+        }
 
         if (playback_check_serial (serial))
         {
@@ -1064,13 +1223,34 @@ DecodeInfo playback_entry_read (int serial)
             int pos = playlist->position ();
             playback_set_info (pos, playlist->entry_tuple (pos));
 
-            art_cache_current (request->filename,
-             std::move (request->image_data), std::move (request->image_file));
+            if (prerolled)
+            {
+                art_cache_current (ready.dec.filename,
+                 std::move (ready.image_data), std::move (ready.image_file));
 
-            dec.filename = request->filename;
-            dec.ip = request->ip;
-            dec.file = std::move (request->file);
-            dec.error = std::move (request->error);
+                dec = std::move (ready.dec);
+            }
+            else
+            {
+                if (request->unchanged)
+                {
+                    // the file was not rescanned; read the tag and album art
+                    // in the background instead
+                    art_request_current (request->filename);
+
+                    entry = playlist->entry_at (pos);
+                    if (! scan_list_find_entry (entry))
+                        scan_refresh_entry (playlist, entry);
+                }
+                else
+                    art_cache_current (request->filename,
+                     std::move (request->image_data), std::move (request->image_file));
+
+                dec.filename = request->filename;
+                dec.ip = request->ip;
+                dec.file = std::move (request->file);
+                dec.error = std::move (request->error);
+            }
         }
 
         delete request;
@@ -1079,6 +1259,36 @@ DecodeInfo playback_entry_read (int serial)
     return dec;
 }
 
+// called from playback thread, shortly before the current song ends
+void playback_entry_preroll (int serial)
+{
+    auto mh = mutex.take ();
+
+    if (! playback_check_serial (serial))
+        return;
+
+    // these are checked again in end_cb() once the song has actually ended
+    if (aud_get_bool ("no_playlist_advance") || aud_get_bool ("stop_after_current_song"))
+        return;
+
+    auto playlist = playing_id->data;
+    bool repeat = ! aud_get_render_mode () && aud_get_bool ("repeat");
+
+    auto entry = playlist->peek_next_song (repeat);
+    if (! entry || entry == preroll.entry ||
+     entry == playlist->entry_at (playlist->position ()))
+        return;
+
+    preroll_cancel ();
+
+    preroll.playlist = playlist;
+    preroll.entry = entry;
+    preroll.request = playlist->create_scan_request (entry, preroll_finish,
+     SCAN_IMAGE | SCAN_FILE);
+
+    scanner_request (preroll.request);
+}
+
 // called from playback thread
 void playback_entry_set_tuple (int serial, Tuple && tuple)
 {
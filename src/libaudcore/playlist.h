@@ -22,6 +22,8 @@
 
 #include <stdint.h>
 
+#include <initializer_list>
+
 #include <libaudcore/index.h>
 #include <libaudcore/tuple.h>
 
@@ -259,6 +261,9 @@ public:
     /* Selects all (or none) of the entries in a playlist. */
     void select_all (bool selected) const;
 
+    /* Selects the entries that are not selected, and deselects those that are. */
+    void invert_selection () const;
+
     /* Moves a selected entry within a playlist by an offset of <distance>
      * entries.  Other selected entries are gathered around it.  Returns the
      * offset by which the entry was actually moved (which may be less than the
@@ -362,8 +367,14 @@ public:
     void sort_entries (SortType scheme) const;
     void sort_selected (SortType scheme) const;
 
-    /* Removes duplicate entries according to a preset scheme.
-     * The current implementation also sorts the playlist. */
+    /* Sorts entries according to several preset schemes at once; entries that
+     * are equal by the first scheme are ordered by the second, and so on. */
+    void sort_entries (const std::initializer_list<SortType> & schemes) const;
+    void sort_selected (const std::initializer_list<SortType> & schemes) const;
+
+    /* Removes duplicate entries according to a preset scheme.  The first of
+     * each set of duplicates is kept and the order of the playlist is left as
+     * it was.  Entries for which the field is empty are never removed. */
     void remove_duplicates (SortType scheme) const;
 
     /* Removes all entries referring to inaccessible files in a playlist. */
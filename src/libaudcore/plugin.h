@@ -48,7 +48,7 @@ struct PluginPreferences;
  * _AUD_PLUGIN_VERSION_MIN to the same value. */
 
 #define _AUD_PLUGIN_VERSION_MIN 48 /* 3.8-devel */
-#define _AUD_PLUGIN_VERSION     48 /* 3.8-devel */
+#define _AUD_PLUGIN_VERSION     49 /* 3.8-devel */
 
 /* Default priority. */
 #define _AUD_PLUGIN_DEFAULT_PRIO 5
@@ -241,6 +241,20 @@ public:
 
     /* Discards any buffered audio data. */
     virtual void flush () = 0;
+
+    /* Optional (since version 49).  Called before open_audio() when threaded
+     * output is enabled.  A plugin driven by its own audio callback may return
+     * true to switch to "pull" mode for the stream: period_wait() and
+     * write_audio() are then no longer called, and the callback fetches data
+     * with pull_audio() instead. */
+    virtual bool use_pull_mode (bool enable)
+        { return false; }
+
+    /* In pull mode, fills <data> with up to <size> bytes of audio, in the
+     * format given to open_audio().  Returns the number of bytes actually
+     * filled; the caller should play silence for the rest.  This function
+     * never blocks and may be called from a real-time thread. */
+    static int pull_audio (void * data, int size);
 };
 
 class LIBAUDCORE_PUBLIC EffectPlugin : public Plugin
@@ -0,0 +1,184 @@
+/*
+ * realtime.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "audstrings.h"
+#include "runtime.h"
+#include "threads.h"
+
+/* With "realtime_audio" enabled, the threads that carry audio from the decoder
+ * to the output plugin ask for real-time scheduling ("realtime_priority", with
+ * SCHED_FIFO) and may be bound to the CPUs listed in "realtime_cpus".  Most
+ * systems allow this only to privileged users (or those granted it by
+ * RLIMIT_RTPRIO), so a higher nice level is tried next, and failing that the
+ * thread simply runs as before.  In either case, the result is logged.
+ *
+ * The audio buffers of the output are also locked into memory, so that they
+ * cannot be paged out.  Locking is limited by RLIMIT_MEMLOCK; if the limit is
+ * reached, the remaining buffers are left unlocked. */
+
+#define NICE_BOOST -10
+
+struct LockedRegion {
+    void * data;
+    size_t size;
+};
+
+static aud::mutex mutex;
+static Index<LockedRegion> regions;
+static bool lock_failed;
+
+bool realtime_enabled ()
+{
+    return aud_get_bool ("realtime_audio");
+}
+
+#ifdef __linux__
+static void set_affinity (const char * name)
+{
+    String cpus = aud_get_str ("realtime_cpus");
+    if (! cpus[0])
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO (& set);
+
+    for (const String & cpu : str_list_to_index (cpus, ", "))
+    {
+        int n = str_to_int (cpu);
+        if (n >= 0 && n < CPU_SETSIZE)
+            CPU_SET (n, & set);
+    }
+
+    int error = pthread_setaffinity_np (pthread_self (), sizeof set, & set);
+
+    if (error)
+        AUDWARN ("%s thread: cannot bind to CPUs %s: %s.\n", name,
+         (const char *) cpus, strerror (error));
+    else
+        AUDINFO ("%s thread: bound to CPUs %s.\n", name, (const char *) cpus);
+}
+#endif
+
+void realtime_setup_thread (const char * name)
+{
+    if (! realtime_enabled ())
+        return;
+
+#ifdef _WIN32
+    if (SetThreadPriority (GetCurrentThread (), THREAD_PRIORITY_TIME_CRITICAL))
+        AUDINFO ("%s thread: time-critical priority.\n", name);
+    else
+        AUDWARN ("%s thread: cannot raise priority.\n", name);
+#else
+    int min = sched_get_priority_min (SCHED_FIFO);
+    int max = sched_get_priority_max (SCHED_FIFO);
+
+    sched_param param = sched_param ();
+    param.sched_priority = aud::clamp (aud_get_int ("realtime_priority"), min, max);
+
+    int error = pthread_setschedparam (pthread_self (), SCHED_FIFO, & param);
+
+    if (! error)
+        AUDINFO ("%s thread: SCHED_FIFO, priority %d.\n", name, param.sched_priority);
+    else
+    {
+#ifdef __linux__
+        /* on Linux, the nice level can be set for a single thread */
+        if (! setpriority (PRIO_PROCESS, syscall (SYS_gettid), NICE_BOOST))
+            AUDINFO ("%s thread: real-time scheduling not permitted (%s), "
+             "nice level %d.\n", name, strerror (error), NICE_BOOST);
+        else
+#endif
+            AUDINFO ("%s thread: real-time scheduling not permitted (%s), "
+             "normal priority.\n", name, strerror (error));
+    }
+
+#ifdef __linux__
+    set_affinity (name);
+#endif
+#endif
+}
+
+bool realtime_lock_memory (void * data, size_t size)
+{
+    if (! data || ! size)
+        return true;
+
+    auto mh = mutex.take ();
+
+    /* after one failure, don't keep running into the limit */
+    if (lock_failed)
+        return false;
+
+#ifdef _WIN32
+    bool success = VirtualLock (data, size);
+    const char * error = "VirtualLock failed";
+#else
+    /* mlock() also faults in any pages not yet touched */
+    bool success = ! mlock (data, size);
+    const char * error = success ? nullptr : strerror (errno);
+#endif
+
+    if (! success)
+    {
+        AUDWARN ("Cannot lock audio buffers in memory (%s); they may be paged "
+         "out.\n", error);
+        lock_failed = true;
+        return false;
+    }
+
+    regions.append (data, size);
+    return true;
+}
+
+void realtime_unlock_memory ()
+{
+    auto mh = mutex.take ();
+
+    for (const LockedRegion & region : regions)
+    {
+#ifdef _WIN32
+        VirtualUnlock (region.data, region.size);
+#else
+        munlock (region.data, region.size);
+#endif
+    }
+
+    regions.clear ();
+    lock_failed = false;
+}
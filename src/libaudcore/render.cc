@@ -0,0 +1,297 @@
+/*
+ * render.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+#include <chrono>
+
+#include "drct.h"
+#include "i18n.h"
+#include "plugin.h"
+#include "runtime.h"
+#include "threads.h"
+#include "vfs.h"
+
+/* In render mode, the render sink takes the place of the output plugin.  It
+ * never blocks, so songs are played as fast as the decoder, effects, and
+ * equalizer allow.  The audio is either discarded or appended to a single WAV
+ * file.  A WAV file has only one format, so songs in different formats can be
+ * rendered to a file only with a fixed output format (see output.cc). */
+
+class RenderOutput : public OutputPlugin
+{
+public:
+    constexpr RenderOutput (const PluginInfo info) :
+        OutputPlugin (info, 0) {}
+
+    bool init ();
+    void cleanup ();
+
+    StereoVolume get_volume ();
+    void set_volume (StereoVolume vol);
+
+    bool open_audio (int format, int rate, int chans, String & error);
+    void close_audio ();
+
+    void period_wait () {}
+    int write_audio (const void * data, int size);
+    void drain () {}
+
+    int get_delay ()
+        { return 0; }
+
+    void pause (bool pause) {}
+    void flush () {}
+};
+
+static constexpr PluginInfo render_info = {N_("Offline Render"), PACKAGE};
+
+static RenderOutput render_output (render_info);
+
+static bool render_mode;
+static String render_file;
+
+/* sink state, accessed only through the output plugin interface */
+static StereoVolume volume = {100, 100};
+static VFSFile wav_file;
+static int wav_format, wav_rate, wav_channels;
+static int64_t wav_bytes;
+static bool wav_failed;
+
+/* statistics, accessed from several threads */
+static aud::mutex mutex;
+static Index<RenderStats> stats;
+static int64_t render_start, track_start;
+
+static int64_t monotonic_time ()
+{
+    auto now = std::chrono::steady_clock::now ().time_since_epoch ();
+    return std::chrono::duration_cast<std::chrono::microseconds> (now).count ();
+}
+
+static void put16 (unsigned char * p, unsigned val)
+{
+    p[0] = val;
+    p[1] = val >> 8;
+}
+
+static void put32 (unsigned char * p, uint32_t val)
+{
+    put16 (p, val);
+    put16 (p + 2, val >> 16);
+}
+
+/* rewrites the header with the current data size */
+static bool write_wav_header ()
+{
+    int size = FMT_SIZEOF (wav_format);
+    uint32_t data = aud::min<int64_t> (wav_bytes, UINT32_MAX - 36);
+    unsigned char header[44];
+
+    memcpy (header, "RIFF", 4);
+    put32 (header + 4, 36 + data);
+    memcpy (header + 8, "WAVEfmt ", 8);
+    put32 (header + 16, 16);
+    put16 (header + 20, (wav_format == FMT_FLOAT) ? 3 : 1);
+    put16 (header + 22, wav_channels);
+    put32 (header + 24, wav_rate);
+    put32 (header + 28, wav_rate * wav_channels * size);
+    put16 (header + 32, wav_channels * size);
+    put16 (header + 34, 8 * size);
+    memcpy (header + 36, "data", 4);
+    put32 (header + 40, data);
+
+    return ! wav_file.fseek (0, VFS_SEEK_SET) &&
+     wav_file.fwrite (header, 1, sizeof header) == sizeof header &&
+     ! wav_file.fseek (0, VFS_SEEK_END);
+}
+
+static bool wav_supported (int format)
+{
+    switch (format)
+    {
+    case FMT_U8:
+    case FMT_S16_LE:
+    case FMT_S24_3LE:
+    case FMT_S32_LE:
+        return true;
+    case FMT_FLOAT:
+        return (FMT_S16_NE == FMT_S16_LE);
+    default:
+        return false;
+    }
+}
+
+bool RenderOutput::init ()
+{
+    auto mh = mutex.take ();
+    stats.clear ();
+    render_start = -1;
+    return true;
+}
+
+void RenderOutput::cleanup ()
+{
+    if (wav_file)
+    {
+        if (! wav_failed && (! write_wav_header () || wav_file.fflush ()))
+            AUDERR ("Error writing %s.\n", (const char *) render_file);
+
+        wav_file = VFSFile ();
+    }
+}
+
+StereoVolume RenderOutput::get_volume ()
+{
+    return volume;
+}
+
+void RenderOutput::set_volume (StereoVolume vol)
+{
+    volume = vol;
+}
+
+bool RenderOutput::open_audio (int format, int rate, int chans, String & error)
+{
+    if (! render_file)
+        return true;
+
+    if (! wav_supported (format))
+    {
+        error = String (_("The selected bit depth cannot be written to a WAV file."));
+        return false;
+    }
+
+    /* songs in the same format go into the same file */
+    if (wav_file)
+    {
+        if (format == wav_format && rate == wav_rate && chans == wav_channels)
+            return true;
+
+        error = String (_("Songs in different audio formats cannot be rendered "
+         "to one file.  Enable a fixed output format and try again."));
+        return false;
+    }
+
+    wav_file = VFSFile (render_file, "w");
+    if (! wav_file)
+    {
+        error = String (wav_file.error ());
+        return false;
+    }
+
+    wav_format = format;
+    wav_rate = rate;
+    wav_channels = chans;
+    wav_bytes = 0;
+    wav_failed = false;
+
+    if (! write_wav_header ())
+    {
+        error = String (_("Error writing WAV header."));
+        wav_file = VFSFile ();
+        return false;
+    }
+
+    AUDINFO ("Rendering to %s, format %d, %d channels, %d Hz.\n",
+     (const char *) render_file, format, chans, rate);
+
+    return true;
+}
+
+void RenderOutput::close_audio ()
+{
+    /* keep the file valid in case we are interrupted */
+    if (wav_file && ! wav_failed && ! write_wav_header ())
+    {
+        AUDERR ("Error writing %s.\n", (const char *) render_file);
+        wav_failed = true;
+    }
+}
+
+int RenderOutput::write_audio (const void * data, int size)
+{
+    if (wav_file && ! wav_failed)
+    {
+        if (wav_file.fwrite (data, 1, size) != size)
+        {
+            AUDERR ("Error writing %s.\n", (const char *) render_file);
+            wav_failed = true;
+        }
+        else
+            wav_bytes += size;
+    }
+
+    return size;
+}
+
+OutputPlugin * render_get_output ()
+{
+    return & render_output;
+}
+
+void render_track_begin ()
+{
+    auto mh = mutex.take ();
+
+    track_start = monotonic_time ();
+    if (render_start < 0)
+        render_start = track_start;
+}
+
+void render_track_end (const char * filename, int64_t frames, int rate)
+{
+    auto mh = mutex.take ();
+    int64_t now = monotonic_time ();
+
+    stats.append (String (filename), frames, rate,
+     track_start - render_start, now - track_start);
+}
+
+void render_cleanup ()
+{
+    auto mh = mutex.take ();
+
+    stats.clear ();
+    render_file = String ();
+}
+
+EXPORT void aud_set_render_mode (bool render, const char * filename)
+{
+    render_mode = render;
+    render_file = String (filename);
+}
+
+EXPORT bool aud_get_render_mode ()
+{
+    return render_mode;
+}
+
+EXPORT Index<RenderStats> aud_drct_get_render_stats ()
+{
+    auto mh = mutex.take ();
+    Index<RenderStats> copy;
+
+    for (const RenderStats & s : stats)
+        copy.append (s.filename, s.frames, s.rate, s.start_us, s.time_us);
+
+    return copy;
+}
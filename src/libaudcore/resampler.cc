@@ -0,0 +1,393 @@
+/*
+ * resampler.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "resampler.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Filter length per output sample (at unity ratio); when downsampling, the
+ * filter is stretched by the ratio so that the cutoff still falls below the
+ * output Nyquist frequency.  96 taps with a Kaiser window (beta 8) give about
+ * 80 dB of stopband rejection with the passband flat up to 0.45 fs. */
+#define BASE_TAPS 96
+#define CUTOFF 0.475
+#define KAISER_BETA 8.0
+
+#define MAX_PHASES 1024
+
+/* The dot products are done LANES taps at a time using the compiler's generic
+ * vector types (see equalizer.cc); the filter length is padded to a multiple of
+ * 2 * LANES with zero coefficients. */
+#define LANES 4
+
+typedef float Lanes __attribute__ ((vector_size (LANES * sizeof (float))));
+
+static int gcd (int a, int b)
+{
+    while (b)
+    {
+        int c = a % b;
+        a = b;
+        b = c;
+    }
+
+    return a;
+}
+
+/* modified Bessel function of the first kind, order zero */
+static double bessel_i0 (double x)
+{
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 32; k ++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static inline Lanes load (const float * p)
+{
+    Lanes v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+static inline float dot (const float * a, const float * b, int n)
+{
+    Lanes s0 = Lanes (), s1 = Lanes ();
+
+    for (int i = 0; i < n; i += 2 * LANES)
+    {
+        s0 += load (a + i) * load (b + i);
+        s1 += load (a + i + LANES) * load (b + i + LANES);
+    }
+
+    s0 += s1;
+
+    float sum = 0;
+    for (int l = 0; l < LANES; l ++)
+        sum += s0[l];
+
+    return sum;
+}
+
+void Resampler::setup (int channels, int in_rate, int out_rate)
+{
+    m_channels = channels;
+
+    if (in_rate == out_rate)
+    {
+        m_taps = 0;
+        m_coefs.clear ();
+        reset ();
+        return;
+    }
+
+    int div = gcd (in_rate, out_rate);
+    m_in_step = in_rate / div;
+    m_out_step = out_rate / div;
+    m_phases = aud::min (m_out_step, MAX_PHASES);
+
+    double ratio = aud::min (1.0, (double) out_rate / in_rate);
+    double cutoff = CUTOFF * ratio; /* in cycles per input sample */
+
+    int taps = ceil (BASE_TAPS / ratio);
+    m_taps = (taps + 2 * LANES - 1) / (2 * LANES) * (2 * LANES);
+
+    /* phase p is the filter for an output sample falling p / m_phases input
+     * samples after the last of the first m_taps / 2 input samples */
+    m_coefs.resize (m_phases * m_taps);
+
+    double half = m_taps / 2;
+    double norm = bessel_i0 (KAISER_BETA);
+
+    for (int p = 0; p < m_phases; p ++)
+    {
+        float * row = & m_coefs[p * m_taps];
+        double sum = 0;
+
+        for (int t = 0; t < m_taps; t ++)
+        {
+            double x = (double) p / m_phases + (half - 1) - t;
+            double w = x / half;
+
+            if (w <= -1 || w >= 1)
+                row[t] = 0;
+            else
+            {
+                double arg = 2 * M_PI * cutoff * x;
+                double sinc = x ? sin (arg) / arg : 1;
+                row[t] = 2 * cutoff * sinc * bessel_i0 (KAISER_BETA *
+                 sqrt (1 - w * w)) / norm;
+            }
+
+            sum += row[t];
+        }
+
+        /* normalize for unity gain at DC */
+        for (int t = 0; t < m_taps; t ++)
+            row[t] /= sum;
+    }
+
+    reset ();
+}
+
+void Resampler::reset ()
+{
+    m_phase = 0;
+    m_pos = 0;
+
+    for (int c = 0; c < AUD_MAX_CHANNELS; c ++)
+        m_planes[c].clear ();
+
+    /* prime the history so that the first output sample is centered on the
+     * first input sample */
+    if (m_taps)
+    {
+        for (int c = 0; c < m_channels; c ++)
+            m_planes[c].insert (0, m_taps / 2 - 1);
+    }
+}
+
+void Resampler::process (const float * in, int frames, Index<float> & out)
+{
+    out.resize (0);
+
+    if (! frames)
+        return;
+
+    if (! m_taps)
+    {
+        out.insert (in, 0, frames * m_channels);
+        return;
+    }
+
+    /* deinterleave into the history */
+    for (int c = 0; c < m_channels; c ++)
+    {
+        Index<float> & plane = m_planes[c];
+        int start = plane.len ();
+        plane.resize (start + frames);
+
+        float * dst = & plane[start];
+        const float * src = in + c;
+
+        for (int f = 0; f < frames; f ++)
+            dst[f] = src[f * m_channels];
+    }
+
+    int avail = m_planes[0].len ();
+    int guess = (int64_t) (avail - m_pos) * m_out_step / m_in_step + 1;
+    out.resize (guess * m_channels);
+
+    int written = 0;
+
+    while (m_pos + m_taps <= avail)
+    {
+        int row = (int64_t) m_phase * m_phases / m_out_step;
+        const float * coefs = & m_coefs[row * m_taps];
+
+        if (written == guess)
+        {
+            guess ++;
+            out.resize (guess * m_channels);
+        }
+
+        float * dst = & out[written * m_channels];
+        for (int c = 0; c < m_channels; c ++)
+            dst[c] = dot (& m_planes[c][m_pos], coefs, m_taps);
+
+        written ++;
+
+        m_phase += m_in_step;
+        m_pos += m_phase / m_out_step;
+        m_phase %= m_out_step;
+    }
+
+    out.resize (written * m_channels);
+
+    /* drop history that will not be used again */
+    int drop = aud::min (m_pos, avail);
+    for (int c = 0; c < m_channels; c ++)
+        m_planes[c].remove (0, drop);
+
+    m_pos -= drop;
+}
+
+/* speaker positions, in the order used for each channel count */
+enum {
+    FL, FR, FC, LFE, RL, RR, RC, SL, SR, OTHER
+};
+
+static const int layouts[AUD_MAX_CHANNELS][AUD_MAX_CHANNELS] = {
+    {FC},
+    {FL, FR},
+    {FL, FR, FC},
+    {FL, FR, RL, RR},
+    {FL, FR, FC, RL, RR},
+    {FL, FR, FC, LFE, RL, RR},
+    {FL, FR, FC, LFE, RC, SL, SR},
+    {FL, FR, FC, LFE, RL, RR, SL, SR},
+    {FL, FR, FC, LFE, RL, RR, SL, SR, OTHER},
+    {FL, FR, FC, LFE, RL, RR, SL, SR, OTHER, OTHER}
+};
+
+static int find_speaker (int channels, int speaker)
+{
+    for (int c = 0; c < channels; c ++)
+    {
+        if (layouts[channels - 1][c] == speaker)
+            return c;
+    }
+
+    return -1;
+}
+
+void Remixer::setup (int in_channels, int out_channels)
+{
+    m_in = in_channels;
+    m_out = out_channels;
+
+    memset (m_matrix, 0, sizeof m_matrix);
+
+    for (int i = 0; i < m_in; i ++)
+    {
+        int speaker = layouts[m_in - 1][i];
+        int o = find_speaker (m_out, speaker);
+
+        auto add = [&] (int to, float level) {
+            int dest = find_speaker (m_out, to);
+            if (dest >= 0)
+                m_matrix[i][dest] += level;
+            return dest >= 0;
+        };
+
+        if (speaker == OTHER)
+        {
+            /* no known position; keep it if the output has the same slot */
+            if (i < m_out && layouts[m_out - 1][i] == OTHER)
+                m_matrix[i][i] = 1;
+        }
+        else if (o >= 0)
+            m_matrix[i][o] = 1;
+        else if (m_in == 1)
+        {
+            /* mono goes to both front speakers at full level */
+            add (FL, 1);
+            add (FR, 1);
+        }
+        else if (speaker == FL || speaker == FR)
+            add (FC, 1);
+        else if (speaker == FC)
+        {
+            add (FL, M_SQRT1_2);
+            add (FR, M_SQRT1_2);
+        }
+        else if (speaker == RL || speaker == SL)
+        {
+            add ((speaker == RL) ? SL : RL, 1) || add (FL, M_SQRT1_2) ||
+             add (FC, M_SQRT1_2);
+        }
+        else if (speaker == RR || speaker == SR)
+        {
+            add ((speaker == RR) ? SR : RR, 1) || add (FR, M_SQRT1_2) ||
+             add (FC, M_SQRT1_2);
+        }
+        else if (speaker == RC)
+        {
+            if (! (add (RL, M_SQRT1_2) & add (RR, M_SQRT1_2)) &&
+             ! (add (SL, M_SQRT1_2) & add (SR, M_SQRT1_2)))
+            {
+                add (FL, 0.5) || add (FC, M_SQRT1_2);
+                add (FR, 0.5);
+            }
+        }
+
+        /* LFE is dropped unless the output has one */
+    }
+
+    /* scale down any output channel that could otherwise clip */
+    for (int o = 0; o < m_out; o ++)
+    {
+        float sum = 0;
+        for (int i = 0; i < m_in; i ++)
+            sum += m_matrix[i][o];
+
+        if (sum > 1)
+        {
+            for (int i = 0; i < m_in; i ++)
+                m_matrix[i][o] /= sum;
+        }
+    }
+}
+
+/* Each input sample is multiplied by its row of the matrix and added to the
+ * output frame, LANES output channels at a time.  For one or two output
+ * channels, most of each vector would be wasted, so the plain matrix product
+ * is faster.  The sums are taken in the same order either way, so the result
+ * does not depend on the path taken. */
+void Remixer::process (const float * in, int frames, Index<float> & out)
+{
+    static_assert (ROW % LANES == 0, "matrix rows must be whole vectors");
+
+    out.resize (frames * m_out);
+    float * dst = out.begin ();
+
+    if (m_out <= LANES / 2)
+    {
+        for (int f = 0; f < frames; f ++)
+        {
+            for (int o = 0; o < m_out; o ++)
+            {
+                float sum = 0;
+                for (int i = 0; i < m_in; i ++)
+                    sum += m_matrix[i][o] * in[i];
+
+                dst[o] = sum;
+            }
+
+            in += m_in;
+            dst += m_out;
+        }
+
+        return;
+    }
+
+    int groups = (m_out + LANES - 1) / LANES;
+
+    for (int f = 0; f < frames; f ++)
+    {
+        Lanes sum[ROW / LANES] = {};
+
+        for (int i = 0; i < m_in; i ++)
+        {
+            for (int g = 0; g < groups; g ++)
+                sum[g] += load (& m_matrix[i][g * LANES]) * in[i];
+        }
+
+        memcpy (dst, sum, m_out * sizeof (float));
+
+        in += m_in;
+        dst += m_out;
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * resampler.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_RESAMPLER_H
+#define LIBAUDCORE_RESAMPLER_H
+
+#include "audio.h"
+#include "index.h"
+
+/*
+ * Resampler converts interleaved floating point audio between two sample rates
+ * using a windowed-sinc polyphase filter.  The ratio is handled exactly for all
+ * common rates; for unusual ones the filter phase is rounded to the nearest of
+ * MAX_PHASES (the output rate stays exact).  The filter keeps a history of the
+ * previous input, so it delays the signal by latency() input frames.
+ */
+class Resampler
+{
+public:
+    void setup (int channels, int in_rate, int out_rate);
+    void reset ();
+
+    /* in_rate == out_rate after setup() */
+    bool passthrough () const
+        { return ! m_taps; }
+
+    int latency () const
+        { return m_taps / 2; }
+
+    /* replaces the contents of <out> */
+    void process (const float * in, int frames, Index<float> & out);
+
+private:
+    int m_channels = 0, m_taps = 0;
+    int m_in_step = 0, m_out_step = 0, m_phases = 0;
+    int m_phase = 0, m_pos = 0;
+
+    Index<float> m_coefs;
+    Index<float> m_planes[AUD_MAX_CHANNELS];
+};
+
+/*
+ * Remixer converts interleaved floating point audio between two channel counts
+ * using a fixed matrix, assuming the usual (WAVE) speaker order for each count.
+ * Speakers missing from the output are folded into their neighbours and each
+ * output channel is scaled so that it cannot exceed full scale.
+ */
+class Remixer
+{
+public:
+    void setup (int in_channels, int out_channels);
+
+    bool passthrough () const
+        { return m_in == m_out; }
+
+    /* replaces the contents of <out> */
+    void process (const float * in, int frames, Index<float> & out);
+
+private:
+    /* the matrix is stored one row per input channel, with the weights for
+     * all output channels padded to a whole number of vectors */
+    static constexpr int ROW = (AUD_MAX_CHANNELS + 3) / 4 * 4;
+
+    int m_in = 0, m_out = 0;
+    float m_matrix[AUD_MAX_CHANNELS][ROW];
+};
+
+#endif // LIBAUDCORE_RESAMPLER_H
@@ -154,6 +154,15 @@ EXPORT void RingBufBase::move_out (void * to, int len, aud::EraseFunc erase_func
     remove (len);
 }
 
+EXPORT void RingBufBase::copy_out (int pos, void * to, int len)
+{
+    Areas areas;
+    get_areas (pos, len, areas);
+
+    memcpy (to, areas.area1, areas.len1);
+    memcpy ((char *) to + areas.len1, areas.area2, areas.len2);
+}
+
 EXPORT void RingBufBase::discard (int len, aud::EraseFunc erase_func)
 {
     if (! m_data)
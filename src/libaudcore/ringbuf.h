@@ -80,6 +80,7 @@ public:
     void copy_in (const void * from, int len, aud::CopyFunc copy_func);
     void move_in (void * from, int len, aud::FillFunc fill_func);
     void move_out (void * to, int len, aud::EraseFunc erase_func);
+    void copy_out (int pos, void * to, int len);  // no copy function
     void discard (int len, aud::EraseFunc erase_func);
 
     void move_in (IndexBase & index, int from, int len);
@@ -141,6 +142,13 @@ public:
     void discard (int len = -1)
         { RingBufBase::discard (raw (len), aud::erase_func<T> ()); }
 
+    // copies elements without removing them, for use as a raw data buffer
+    void copy_out (int pos, T * to, int len)
+    {
+        static_assert (std::is_trivial<T>::value, "for basic types only");
+        RingBufBase::copy_out (raw (pos), to, raw (len));
+    }
+
     void move_in (Index<T> & index, int from, int len)
         { RingBufBase::move_in (index.base (), raw (from), raw (len)); }
     void move_out (Index<T> & index, int to, int len)
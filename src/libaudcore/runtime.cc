@@ -289,6 +289,7 @@ EXPORT void aud_init ()
 
     chardet_init ();
     eq_init ();
+    pipeline_stats_init ();
     output_init ();
     playlist_init ();
 
@@ -296,6 +297,7 @@ EXPORT void aud_init ()
 
     record_init ();
     scanner_init ();
+    vis_export_init ();
     load_playlists ();
 }
 
@@ -343,8 +345,13 @@ EXPORT void aud_cleanup ()
 
     art_cleanup ();
     chardet_cleanup ();
+    effect_cleanup ();
     eq_cleanup ();
     output_cleanup ();
+    pipeline_stats_cleanup ();
+    render_cleanup ();
+    vis_export_cleanup ();
+    vis_runner_cleanup ();
     playlist_end ();
 
     event_queue_cancel_all ();
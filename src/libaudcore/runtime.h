@@ -95,6 +95,13 @@ const char * aud_get_path (AudPath id);
 void aud_set_headless_mode (bool headless);
 bool aud_get_headless_mode ();
 
+// In render mode, the output plugin is replaced by a built-in sink that never
+// blocks, so that songs are played faster than realtime.  The audio is written
+// to <filename> (a URI) as a WAV file, or discarded if <filename> is null.
+// Must be set before aud_init().
+void aud_set_render_mode (bool render, const char * filename = nullptr);
+bool aud_get_render_mode ();
+
 // Note that the UserDir and PlaylistDir paths vary depending on the instance
 // number.  Therefore, calling aud_set_instance() after these paths have been
 // referenced, or after aud_init(), is an error.
@@ -20,6 +20,7 @@
 #include "scanner.h"
 
 #include <glib.h>  /* for GThreadPool */
+#include <glib/gstdio.h>
 
 #include "audstrings.h"
 #include "cue-cache.h"
@@ -63,6 +64,24 @@ void ScanRequest::read_cuesheet_entry ()
     }
 }
 
+FileStamp FileStamp::read (const char * filename)
+{
+    FileStamp stamp;
+    StringBuf local = uri_to_filename (filename);
+    GStatBuf info;
+
+    if (local && g_stat (local, & info) == 0)
+    {
+        stamp.size = info.st_size;
+        stamp.mtime = info.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+        stamp.mtime_nsec = info.st_mtim.tv_nsec;
+#endif
+    }
+
+    return stamp;
+}
+
 void ScanRequest::run ()
 {
     /* load cuesheet entry (possibly cached) */
@@ -74,8 +93,13 @@ void ScanRequest::run ()
     if (! audio_file)
         audio_file = filename;
 
+    stamp = FileStamp::read (audio_file);
+
+    unchanged = (flags & SCAN_QUICK) && decoder && tuple.valid () &&
+     stamp.valid () && stamp == known_stamp;
+
     bool need_tuple = (flags & SCAN_TUPLE) && ! tuple.valid ();
-    bool need_image = (flags & SCAN_IMAGE);
+    bool need_image = (flags & SCAN_IMAGE) && ! unchanged;
 
     if (! decoder)
         decoder = aud_file_find_decoder (audio_file, false, file, & error);
@@ -100,7 +124,12 @@ void ScanRequest::run ()
 
     /* rewind/reopen the input file */
     if ((flags & SCAN_FILE))
+    {
+        if (! ip && ! (ip = load_input_plugin (decoder, & error)))
+            goto err;
+
         open_input_file (audio_file, "r", ip, file, & error);
+    }
     else
     {
     err:
@@ -32,9 +32,26 @@ class PluginHandle;
 #define SCAN_TUPLE (1 << 0)
 #define SCAN_IMAGE (1 << 1)
 #define SCAN_FILE  (1 << 2)
+#define SCAN_QUICK (1 << 3)  /* skip SCAN_IMAGE if the file is unchanged */
 
 #define SCAN_THREADS 2
 
+/* size and modification time of a local file, used to tell whether it has
+ * changed since it was last scanned; invalid for remote files */
+struct FileStamp
+{
+    int64_t size = -1;
+    int64_t mtime = -1;
+    int mtime_nsec = 0; /* where the system provides it */
+
+    bool valid () const
+        { return size >= 0; }
+    bool operator== (const FileStamp & b) const
+        { return size == b.size && mtime == b.mtime && mtime_nsec == b.mtime_nsec; }
+
+    static FileStamp read (const char * filename);
+};
+
 struct ScanRequest
 {
     typedef void (* Callback) (ScanRequest * request);
@@ -53,6 +70,12 @@ struct ScanRequest
     String image_file;
     String error;
 
+    /* with SCAN_QUICK, known_stamp is compared with the stamp read during the
+     * scan; if they match (and the decoder and tuple are already known), only
+     * the file is opened and "unchanged" is set */
+    FileStamp known_stamp, stamp;
+    bool unchanged = false;
+
     ScanRequest (const String & filename, int flags, Callback callback,
      PluginHandle * decoder = nullptr, Tuple && tuple = Tuple ());
 
@@ -0,0 +1,331 @@
+/*
+ * sort-keys.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "sort-keys.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "tuple.h"
+
+/* Strings are encoded so that memcmp() agrees with str_compare():
+ *  - bytes other than digits are copied, with A-Z folded to a-z
+ *  - a run of digits becomes a '0', the number of digits (less any leading
+ *    zeros), and the digits themselves, so that runs compare by value; the '0'
+ *    compares against other bytes just as any digit would
+ *  - a zero byte ends the string, so that it sorts before any longer string
+ *    beginning the same way, whatever keys follow it
+ * Filenames are percent-decoded first.  In a path, a 1 byte is inserted
+ * before the base name, so that the files in a folder sort before those in
+ * its subfolders.  Fields missing from the tuple sort first. */
+
+static constexpr char KEY_END = 0;
+static constexpr char KEY_BASENAME = 1;
+static constexpr char KEY_PRESENT = 1;
+static constexpr char KEY_DIGITS = '0';
+
+/* longer runs of digits are counted in four bytes */
+static constexpr int SHORT_RUN = 254;
+
+/* sorting is split among threads only for this many keys per thread */
+static constexpr int MIN_PER_THREAD = 16384;
+static constexpr int MAX_THREADS = 8;
+
+static bool is_digit (char c)
+    { return c >= '0' && c <= '9'; }
+
+static int from_hex (char c)
+{
+    if (is_digit (c))
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+static void append_digits (Index<char> & key, const char * digits, int len)
+{
+    while (len > 1 && digits[0] == '0')
+    {
+        digits ++;
+        len --;
+    }
+
+    key.append (KEY_DIGITS);
+
+    if (len <= SHORT_RUN)
+        key.append ((char) len);
+    else
+    {
+        key.append ((char) 0xff);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            key.append ((char) (len >> shift));
+    }
+
+    key.insert (digits, -1, len);
+}
+
+static void append_text (Index<char> & key, const char * str, const char * end)
+{
+    while (str < end)
+    {
+        if (is_digit (* str))
+        {
+            const char * run = str;
+            while (str < end && is_digit (* str))
+                str ++;
+
+            append_digits (key, run, str - run);
+        }
+        else
+        {
+            char c = * str ++;
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+
+            key.append (c);
+        }
+    }
+}
+
+static void append_encoded (Index<char> & key, const char * str, const char * end)
+{
+    if (! memchr (str, '%', end - str))
+        return append_text (key, str, end);
+
+    Index<char> decoded;
+
+    while (str < end)
+    {
+        int hi, lo;
+
+        /* a zero byte would end the string early; leave %00 as it is */
+        if (str[0] == '%' && end - str >= 3 && (hi = from_hex (str[1])) >= 0 &&
+         (lo = from_hex (str[2])) >= 0 && (hi || lo))
+        {
+            decoded.append ((char) ((hi << 4) | lo));
+            str += 3;
+        }
+        else
+            decoded.append (* str ++);
+    }
+
+    append_text (key, decoded.begin (), decoded.end ());
+}
+
+static bool append_string (Index<char> & key, const Tuple & tuple, Tuple::Field field)
+{
+    String str = tuple.get_str (field);
+
+    if (str)
+    {
+        key.append (KEY_PRESENT);
+        append_text (key, str, str + strlen (str));
+    }
+
+    key.append (KEY_END);
+    return str && str[0];
+}
+
+static bool append_int (Index<char> & key, const Tuple & tuple, Tuple::Field field)
+{
+    if (tuple.get_value_type (field) != Tuple::Int)
+    {
+        key.append (KEY_END);
+        return false;
+    }
+
+    /* flip the sign bit so that negative numbers sort first */
+    unsigned val = (unsigned) tuple.get_int (field) ^ 0x80000000u;
+
+    key.append (KEY_PRESENT);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        key.append ((char) (val >> shift));
+
+    return true;
+}
+
+bool SortKeys::add (const char * filename, const Tuple & tuple, const Schemes & schemes)
+{
+    m_offsets.append (m_data.len ());
+
+    const char * end = filename + strlen (filename);
+    const char * slash = strrchr (filename, '/');
+    const char * base = slash ? slash + 1 : filename;
+    bool found = false;
+
+    for (Playlist::SortType scheme : schemes)
+    {
+        switch (scheme)
+        {
+        case Playlist::Path:
+            append_encoded (m_data, filename, base);
+            m_data.append (KEY_BASENAME);
+            append_encoded (m_data, base, end);
+            m_data.append (KEY_END);
+            found |= (end > filename);
+            break;
+
+        case Playlist::Filename:
+            append_encoded (m_data, base, end);
+            m_data.append (KEY_END);
+            found |= (end > base);
+            break;
+
+        case Playlist::Title:
+            found |= append_string (m_data, tuple, Tuple::Title);
+            break;
+        case Playlist::Album:
+            found |= append_string (m_data, tuple, Tuple::Album);
+            break;
+        case Playlist::Artist:
+            found |= append_string (m_data, tuple, Tuple::Artist);
+            break;
+        case Playlist::AlbumArtist:
+            found |= append_string (m_data, tuple, Tuple::AlbumArtist);
+            break;
+        case Playlist::Date:
+            found |= append_int (m_data, tuple, Tuple::Year);
+            break;
+        case Playlist::Genre:
+            found |= append_string (m_data, tuple, Tuple::Genre);
+            break;
+        case Playlist::Track:
+            found |= append_int (m_data, tuple, Tuple::Track);
+            break;
+        case Playlist::FormattedTitle:
+            found |= append_string (m_data, tuple, Tuple::FormattedTitle);
+            break;
+        case Playlist::Length:
+            found |= append_int (m_data, tuple, Tuple::Length);
+            break;
+        case Playlist::Comment:
+            found |= append_string (m_data, tuple, Tuple::Comment);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return found;
+}
+
+int SortKeys::compare (int a, int b) const
+{
+    int n_keys = m_offsets.len ();
+    int start_a = m_offsets[a], start_b = m_offsets[b];
+    int len_a = ((a + 1 < n_keys) ? m_offsets[a + 1] : m_data.len ()) - start_a;
+    int len_b = ((b + 1 < n_keys) ? m_offsets[b + 1] : m_data.len ()) - start_b;
+
+    int diff = memcmp (& m_data[start_a], & m_data[start_b], aud::min (len_a, len_b));
+    return diff ? diff : len_a - len_b;
+}
+
+unsigned SortKeys::hash (int i) const
+{
+    int start = m_offsets[i];
+    int end = (i + 1 < m_offsets.len ()) ? m_offsets[i + 1] : m_data.len ();
+
+    unsigned h = 5381;
+    for (int pos = start; pos < end; pos ++)
+        h = h * 33 + (unsigned char) m_data[pos];
+
+    return h;
+}
+
+/* calls func (0) through func (count - 1), each in its own thread */
+template<class Func>
+static void run_parallel (int count, const Func & func)
+{
+    std::thread threads[MAX_THREADS];
+
+    for (int i = 1; i < count; i ++)
+        threads[i] = std::thread (func, i);
+
+    func (0);
+
+    for (int i = 1; i < count; i ++)
+        threads[i].join ();
+}
+
+void SortKeys::sort (Index<int> & list) const
+{
+    int n = list.len ();
+    assert (n == m_offsets.len ());
+
+    Index<int> keys, temp;
+    keys.insert (0, n);
+    temp.insert (0, n);
+
+    for (int i = 0; i < n; i ++)
+        keys[i] = i;
+
+    auto less = [this] (int a, int b)
+        { return compare (a, b) < 0; };
+
+    /* first each thread sorts a slice of the list ... */
+    int n_threads = aud::clamp ((int) std::thread::hardware_concurrency (), 1, MAX_THREADS);
+    n_threads = aud::clamp (n / MIN_PER_THREAD, 1, n_threads);
+
+    Index<int> bounds;
+    for (int t = 0; t <= n_threads; t ++)
+        bounds.append ((int64_t) n * t / n_threads);
+
+    int * from = keys.begin ();
+    int * to = temp.begin ();
+
+    run_parallel (n_threads, [&] (int t) {
+        std::stable_sort (from + bounds[t], from + bounds[t + 1], less);
+    });
+
+    /* ... then neighboring slices are merged in pairs, until one is left */
+    while (bounds.len () > 2)
+    {
+        int n_slices = bounds.len () - 1;
+
+        run_parallel ((n_slices + 1) / 2, [&] (int pair) {
+            int start = bounds[2 * pair];
+            int middle = bounds[aud::min (2 * pair + 1, n_slices)];
+            int end = bounds[aud::min (2 * pair + 2, n_slices)];
+            std::merge (from + start, from + middle, from + middle, from + end,
+             to + start, less);
+        });
+
+        Index<int> merged;
+        for (int i = 0; i < n_slices; i += 2)
+            merged.append (bounds[i]);
+
+        merged.append (n);
+        bounds = std::move (merged);
+
+        std::swap (from, to);
+    }
+
+    for (int i = 0; i < n; i ++)
+        temp[i] = list[from[i]];
+
+    list = std::move (temp);
+}
@@ -0,0 +1,58 @@
+/*
+ * sort-keys.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_SORT_KEYS_H
+#define LIBAUDCORE_SORT_KEYS_H
+
+#include <initializer_list>
+
+#include "index.h"
+#include "playlist.h"
+
+/*
+ * SortKeys holds a binary key for each of a list of entries, built once from
+ * the entry's filename and tuple according to one or more of the preset sort
+ * schemes.  Keys compare with memcmp() in the same order as the comparison
+ * functions for those schemes (natural-number aware, with ASCII letters
+ * folded to lower case); keys for several schemes are simply concatenated.
+ */
+class SortKeys
+{
+public:
+    typedef std::initializer_list<Playlist::SortType> Schemes;
+
+    /* returns false if the fields used by <schemes> are all missing or empty */
+    bool add (const char * filename, const Tuple & tuple, const Schemes & schemes);
+
+    int len () const
+        { return m_offsets.len (); }
+
+    int compare (int a, int b) const;
+    unsigned hash (int i) const;
+
+    /* sorts the items of <list>, where item i has the key added ith, in a
+     * stable fashion; large lists are sorted by several threads at once */
+    void sort (Index<int> & list) const;
+
+private:
+    Index<char> m_data;
+    Index<int> m_offsets;  /* where each key starts in m_data */
+};
+
+#endif // LIBAUDCORE_SORT_KEYS_H
@@ -0,0 +1,129 @@
+/*
+ * spsc-ring.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "spsc-ring.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+void SPSCRing::alloc (int size)
+{
+    assert (size > 0);
+
+    destroy ();
+
+    m_data = (char *) malloc (size);
+    if (! m_data)
+        throw std::bad_alloc ();
+
+    __sync_add_and_fetch (& misc_bytes_allocated, size);
+    m_size = size;
+}
+
+void SPSCRing::destroy ()
+{
+    if (m_data)
+    {
+        __sync_sub_and_fetch (& misc_bytes_allocated, m_size);
+        free (m_data);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_read = m_write = m_discard = 0;
+}
+
+int SPSCRing::len () const
+{
+    int64_t read = __atomic_load_n (& m_read, __ATOMIC_ACQUIRE);
+    int64_t discard = __atomic_load_n (& m_discard, __ATOMIC_ACQUIRE);
+    int64_t write = __atomic_load_n (& m_write, __ATOMIC_ACQUIRE);
+
+    return write - aud::max (read, discard);
+}
+
+int SPSCRing::space () const
+{
+    /* space is only reclaimed once the consumer moves past discarded data */
+    int64_t read = __atomic_load_n (& m_read, __ATOMIC_ACQUIRE);
+    return m_size - (int) (m_write - read);
+}
+
+int SPSCRing::write (const void * data, int len)
+{
+    len = aud::min (len, space ());
+
+    int start = m_write % m_size;
+    int part = aud::min (len, m_size - start);
+
+    memcpy (m_data + start, data, part);
+    memcpy (m_data, (const char *) data + part, len - part);
+
+    __atomic_store_n (& m_write, m_write + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+int SPSCRing::peek (const void * * data)
+{
+    int64_t discard = __atomic_load_n (& m_discard, __ATOMIC_ACQUIRE);
+    if (discard > m_read)
+        __atomic_store_n (& m_read, discard, __ATOMIC_RELEASE);
+
+    int64_t write = __atomic_load_n (& m_write, __ATOMIC_ACQUIRE);
+    int start = m_read % m_size;
+
+    * data = m_data + start;
+    return aud::min ((int) (write - m_read), m_size - start);
+}
+
+void SPSCRing::consume (int len)
+{
+    /* if discard() was called meanwhile, skip past the discarded data */
+    int64_t discard = __atomic_load_n (& m_discard, __ATOMIC_ACQUIRE);
+    __atomic_store_n (& m_read, aud::max (m_read + len, discard), __ATOMIC_RELEASE);
+}
+
+int SPSCRing::read (void * data, int len)
+{
+    int copied = 0;
+
+    while (copied < len)
+    {
+        const void * area;
+        int part = aud::min (peek (& area), len - copied);
+        if (! part)
+            break;
+
+        memcpy ((char *) data + copied, area, part);
+        consume (part);
+        copied += part;
+    }
+
+    return copied;
+}
+
+void SPSCRing::discard ()
+{
+    int64_t write = __atomic_load_n (& m_write, __ATOMIC_ACQUIRE);
+    __atomic_store_n (& m_discard, write, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,78 @@
+/*
+ * spsc-ring.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_SPSC_RING_H
+#define LIBAUDCORE_SPSC_RING_H
+
+#include <stdint.h>
+
+/*
+ * SPSCRing is a bounded byte ring buffer which can be shared by exactly one
+ * producer thread and one consumer thread without any locking:
+ *  - The read and write positions are 64-bit running byte counts, each written
+ *    by only one side, so the fill level is simply their difference.
+ *  - alloc() and destroy() are not thread-safe and must only be called while
+ *    neither side is active.
+ *  - discard() may be called from any thread.  Everything written before the
+ *    call is skipped by the consumer on its next access.
+ */
+class SPSCRing
+{
+public:
+    SPSCRing () = default;
+    ~SPSCRing ()
+        { destroy (); }
+
+    SPSCRing (const SPSCRing &) = delete;
+    SPSCRing & operator= (const SPSCRing &) = delete;
+
+    void alloc (int size);
+    void destroy ();
+
+    int size () const
+        { return m_size; }
+
+    /* the underlying buffer, e.g. for realtime_lock_memory() */
+    void * buffer ()
+        { return m_data; }
+
+    /* any thread; the result may be out of date by the time it is used */
+    int len () const;
+
+    /* producer side */
+    int space () const;
+    int write (const void * data, int len);
+
+    /* consumer side; peek() returns the largest contiguous block available and
+     * consume() releases (part of) it once the data has been used */
+    int peek (const void * * data);
+    void consume (int len);
+    int read (void * data, int len);
+
+    /* any thread */
+    void discard ();
+
+private:
+    char * m_data = nullptr;
+    int m_size = 0;
+
+    int64_t m_read = 0, m_write = 0, m_discard = 0;
+};
+
+#endif // LIBAUDCORE_SPSC_RING_H
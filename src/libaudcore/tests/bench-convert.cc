@@ -0,0 +1,116 @@
+/*
+ * bench-convert.cc - Output conversion benchmark for libaudcore
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "audio.h"
+#include "internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+/* as many frames as the output code typically converts at once */
+static constexpr int channels = 2;
+static constexpr int frames = 4096;
+static constexpr int samples = channels * frames;
+
+/* about a minute of CD audio per case */
+static constexpr int rounds = 640;
+
+static float source[samples];
+static float data[samples];
+static char buffer[4 * samples];
+
+typedef std::chrono::steady_clock Clock;
+
+static void report (const char * name, Clock::duration time)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds> (time).count ();
+    printf ("  %-28s %10.3f ms %8.1f Msamples/s\n", name, us / 1000.0,
+     (double) samples * rounds / us);
+}
+
+/* the path used before audio_amplify_convert(): the software volume is
+ * converted to factors on each call, and the data is gone over three times */
+static Clock::duration run_separate (int format, StereoVolume volume, bool soft_clip)
+{
+    Clock::duration time {};
+
+    for (int r = 0; r < rounds; r ++)
+    {
+        memcpy (data, source, sizeof data);
+        auto start = Clock::now ();
+
+        audio_amplify (data, channels, frames, volume);
+        if (soft_clip)
+            audio_soft_clip (data, samples);
+        if (format != FMT_FLOAT)
+            audio_to_int (data, buffer, format, samples);
+
+        time += Clock::now () - start;
+    }
+
+    return time;
+}
+
+static Clock::duration run_fused (int format, StereoVolume volume, bool soft_clip)
+{
+    Clock::duration time {};
+    float factors[channels];
+    audio_volume_factors (volume, channels, factors);
+
+    for (int r = 0; r < rounds; r ++)
+    {
+        memcpy (data, source, sizeof data);
+        auto start = Clock::now ();
+
+        audio_amplify_convert (data, (format == FMT_FLOAT) ? (void *) data : buffer,
+         format, channels, frames, factors, soft_clip);
+
+        time += Clock::now () - start;
+    }
+
+    return time;
+}
+
+static void bench (const char * name, int format, bool soft_clip)
+{
+    StereoVolume volume = {80, 60};
+
+    printf ("%s%s:\n", name, soft_clip ? ", soft clipping" : "");
+    report ("separate passes", run_separate (format, volume, soft_clip));
+    report ("fused pass", run_fused (format, volume, soft_clip));
+}
+
+int main ()
+{
+    for (float & f : source)
+        f = (rand () % 3001 - 1500) / 1000.0f;
+
+    for (bool soft_clip : {false, true})
+    {
+        bench ("16-bit", FMT_S16_NE, soft_clip);
+        bench ("24-bit", FMT_S24_NE, soft_clip);
+        bench ("32-bit", FMT_S32_NE, soft_clip);
+        bench ("floating point", FMT_FLOAT, soft_clip);
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * bench-equalizer.cc - Equalizer benchmark for libaudcore
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "audio.h"
+#include "equalizer.h"
+#include "internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+static constexpr int frames = 4096;
+
+/* ten seconds of audio per case */
+static constexpr int seconds = 10;
+
+static float data[AUD_MAX_CHANNELS * frames];
+
+/* the original equalizer, filtering one channel at a time */
+static const float Q = 1.2247449f;
+static const float CF[AUD_EQ_NBANDS] = {31.25f, 62.5f, 125, 250, 500, 1000,
+ 2000, 4000, 8000, 16000};
+
+static int old_K;
+static float old_a[AUD_EQ_NBANDS][2], old_b[AUD_EQ_NBANDS][2];
+static float old_wqv[AUD_MAX_CHANNELS][AUD_EQ_NBANDS][2];
+static float old_g[AUD_EQ_NBANDS];
+
+static void old_set_format (int rate)
+{
+    double bands[AUD_EQ_NBANDS];
+    aud_eq_get_bands (bands);
+
+    old_K = AUD_EQ_NBANDS;
+    while (old_K > 0 && CF[old_K - 1] > (float) rate / (2.005f * Q))
+        old_K --;
+
+    for (int k = 0; k < old_K; k ++)
+    {
+        float th = 2 * (float) M_PI * (CF[k] / (float) rate);
+        float C = (1 - tanf (th * Q / 2)) / (1 + tanf (th * Q / 2));
+
+        old_a[k][0] = (1 + C) * cosf (th);
+        old_a[k][1] = -C;
+        old_b[k][0] = (1 - C) / 2;
+        old_b[k][1] = -1.005f;
+        old_g[k] = powf (10, (float) bands[k] / 20) - 1;
+    }
+
+    memset (old_wqv, 0, sizeof old_wqv);
+}
+
+static void old_filter (float * data, int channels, int samples)
+{
+    for (int channel = 0; channel < channels; channel ++)
+    {
+        float * end = data + samples;
+
+        for (float * f = data + channel; f < end; f += channels)
+        {
+            float yt = * f;
+
+            for (int k = 0; k < old_K; k ++)
+            {
+                float * wq = old_wqv[channel][k];
+                float w = yt * old_b[k][0] + wq[0] * old_a[k][0] + wq[1] * old_a[k][1];
+
+                yt += (w + wq[1] * old_b[k][1]) * old_g[k];
+
+                wq[1] = wq[0];
+                wq[0] = w;
+            }
+
+            * f = yt;
+        }
+    }
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static void fill (int samples)
+{
+    for (int i = 0; i < samples; i ++)
+        data[i] = (rand () % 2001 - 1000) / 1000.0f;
+}
+
+static void report (const char * name, Clock::duration time)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds> (time).count ();
+    printf ("  %-28s %10.3f ms %8.1fx real time\n", name, us / 1000.0,
+     seconds * 1e6 / us);
+}
+
+static void bench (int channels, int rate)
+{
+    int samples = channels * frames;
+    int buffers = (int64_t) rate * seconds / frames;
+
+    printf ("%d channels at %d Hz:\n", channels, rate);
+
+    old_set_format (rate);
+    Clock::duration time {};
+
+    for (int i = 0; i < buffers; i ++)
+    {
+        fill (samples);
+        auto start = Clock::now ();
+        old_filter (data, channels, samples);
+        time += Clock::now () - start;
+    }
+
+    report ("one channel at a time", time);
+
+    eq_set_format (channels, rate);
+    time = Clock::duration ();
+
+    for (int i = 0; i < buffers; i ++)
+    {
+        fill (samples);
+        auto start = Clock::now ();
+        eq_filter (data, samples);
+        time += Clock::now () - start;
+    }
+
+    report ("channels in SIMD lanes", time);
+}
+
+int main ()
+{
+    eq_init ();
+
+    /* let the equalizer pick up (and fade in) the initial gains */
+    eq_set_format (2, 44100);
+    eq_filter (data, 2 * frames);
+
+    for (int channels : {2, 6, 8})
+    {
+        for (int rate : {44100, 48000, 96000, 192000})
+            bench (channels, rate);
+    }
+
+    eq_cleanup ();
+    return 0;
+}
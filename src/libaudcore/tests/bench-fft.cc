@@ -0,0 +1,159 @@
+/*
+ * bench-fft.cc - FFT benchmark for libaudcore
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "fft.h"
+#include "internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <complex>
+
+typedef std::complex<float> Complex;
+typedef std::chrono::steady_clock Clock;
+
+/* the original fixed-size FFT from fft.cc, with the size made a parameter so
+ * that it can be compared at every size; tables are built outside the timing */
+static int old_n;
+static float hamming[FFT::MaxSize];
+static int reversed[FFT::MaxSize];
+static Complex roots[FFT::MaxSize / 2];
+
+static void old_setup (int n)
+{
+    int logn = 0;
+    while ((1 << logn) < n)
+        logn ++;
+
+    old_n = n;
+
+    for (int i = 0; i < n; i ++)
+        hamming[i] = 1 - 0.85f * cosf (i * (6.2831853f / n));
+
+    for (int i = 0; i < n; i ++)
+    {
+        int x = i, y = 0;
+        for (int b = logn; b --; )
+        {
+            y = (y << 1) | (x & 1);
+            x >>= 1;
+        }
+
+        reversed[i] = y;
+    }
+
+    for (int i = 0; i < n / 2; i ++)
+        roots[i] = exp (Complex (0, i * (6.2831853f / n)));
+}
+
+static void old_calc_freq (const float * data, float * freq)
+{
+    static Complex a[FFT::MaxSize];
+    int n = old_n;
+
+    for (int i = 0; i < n; i ++)
+        a[reversed[i]] = data[i] * hamming[i];
+
+    int half = 1, inv = n / 2;
+
+    while (inv)
+    {
+        for (int g = 0; g < n; g += half << 1)
+        {
+            for (int b = 0, r = 0; b < half; b ++, r += inv)
+            {
+                Complex even = a[g + b];
+                Complex odd = roots[r] * a[g + half + b];
+                a[g + b] = even + odd;
+                a[g + half + b] = even - odd;
+            }
+        }
+
+        half <<= 1;
+        inv >>= 1;
+    }
+
+    for (int i = 0; i < n / 2 - 1; i ++)
+        freq[i] = 2 * abs (a[1 + i]) / n;
+
+    freq[n / 2 - 1] = abs (a[n / 2]) / n;
+}
+
+static float input[FFT::MaxSize];
+static float freq[FFT::MaxSize / 2], freq2[FFT::MaxSize / 2];
+
+/* enough rounds that each case takes a noticeable fraction of a second */
+static int rounds_for (int size)
+    { return (1 << 24) / size; }
+
+template<class F>
+static double time_per_call (int rounds, F func)
+{
+    auto start = Clock::now ();
+
+    for (int r = 0; r < rounds; r ++)
+        func ();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+     (Clock::now () - start).count ();
+
+    return ns / 1000.0 / rounds;
+}
+
+int main ()
+{
+    for (float & f : input)
+        f = (rand () % 2001 - 1000) / 1000.0f;
+
+    /* the visualizer path, against the code it replaced */
+    old_setup (512);
+    int rounds = rounds_for (512);
+
+    double t_old = time_per_call (rounds, [&] () { old_calc_freq (input, freq); });
+    double t_new = time_per_call (rounds, [&] () { ::calc_freq (input, freq2); });
+
+    float diff = 0;
+    for (int i = 0; i < 256; i ++)
+        diff = fmaxf (diff, fabsf (freq[i] - freq2[i]) / fmaxf (freq[i], 1e-3f));
+
+    printf ("calc_freq (512 points, Hamming):\n");
+    printf ("  %-28s %10.3f us\n", "old complex FFT", t_old);
+    printf ("  %-28s %10.3f us   (max relative difference %.2g)\n",
+     "real-input FFT", t_new, diff);
+
+    /* magnitude spectra at every supported size, both with a Hamming window */
+    printf ("magnitude spectrum:\n");
+
+    for (int size = FFT::MinSize; size <= FFT::MaxSize; size *= 2)
+    {
+        old_setup (size);
+        FFT fft (size, FFTWindow::Hamming);
+        rounds = rounds_for (size);
+
+        t_old = time_per_call (rounds, [&] () { old_calc_freq (input, freq); });
+        t_new = time_per_call (rounds, [&] () { fft.magnitudes (input, freq2); });
+
+        printf ("  %5d points: old %10.3f us, new %10.3f us (%.1fx)\n", size,
+         t_old, t_new, t_old / t_new);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# bench-first-audio.sh - Playback start benchmark for libaudcore
+# Copyright 2026 Audacious developers
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions, and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions, and the following disclaimer in the documentation
+#    provided with the distribution.
+#
+# This software is provided "as is" and without any warranty, express or
+# implied. In no event shall the authors be liable for any damages arising from
+# the use of this software.
+#
+# Measures the time from the "play" command to the first decoded audio, as
+# logged by the playback thread ("Time to first audio").  Each round plays the
+# same song twice: once after touching the file, which forces the full scan
+# that playback always did before, and once with the file unchanged, which
+# takes the quick path.  Both rounds read the file from the page cache.
+#
+# Needs an installed build of Audacious and audtool, and a D-Bus session.  Any
+# running instance is shut down first.  The results depend heavily on the
+# format and the size of the embedded album art, so try several files.
+#
+# usage: bench-first-audio.sh FILE [ROUNDS]
+
+set -e
+
+if [ $# -lt 1 ] ; then
+    echo "usage: $0 FILE [ROUNDS]" >&2
+    exit 1
+fi
+
+file=$(realpath "$1")
+rounds=${2:-10}
+log=$(mktemp)
+
+audtool shutdown 2>/dev/null || true
+sleep 1
+
+audacious -H -V > "$log" 2>&1 &
+sleep 2
+
+audtool playlist-clear
+audtool playlist-addurl "file://$file"
+
+# let the playlist scan finish, so that the entry has a stamp
+sleep 2
+
+play_once () {
+    audtool playback-stop
+    audtool playlist-jump 1
+    audtool playback-play
+    sleep 1
+}
+
+for i in $(seq "$rounds") ; do
+    touch "$file"
+    sleep 1  # file times have a resolution of one second
+    play_once
+    play_once
+done
+
+audtool playback-stop
+audtool shutdown
+wait
+
+# the log has alternating full and quick starts
+grep -o 'Time to first audio: [0-9]*' "$log" | awk '{ print $5 }' | awk '
+    NR % 2 == 1 { full += $1; n_full ++ }
+    NR % 2 == 0 { quick += $1; n_quick ++ }
+    END {
+        if (n_full) printf ("full scan:  %.1f ms average over %d starts\n", full / n_full, n_full)
+        if (n_quick) printf ("quick path: %.1f ms average over %d starts\n", quick / n_quick, n_quick)
+    }'
+
+rm -f "$log"
@@ -0,0 +1,148 @@
+/*
+ * bench-playlist.cc - Playlist benchmark for libaudcore
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "audstrings.h"
+#include "playlist-data.h"
+#include "runtime.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+static std::chrono::steady_clock::time_point start_time;
+
+static void start ()
+{
+    start_time = std::chrono::steady_clock::now ();
+}
+
+static void finish (const char * name)
+{
+    auto time = std::chrono::steady_clock::now () - start_time;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds> (time).count ();
+    printf ("  %-28s %10.3f ms\n", name, us / 1000.0);
+}
+
+static Index<PlaylistAddItem> make_items (int first, int count)
+{
+    Index<PlaylistAddItem> items;
+    items.insert (0, count);
+
+    for (int i = 0; i < count; i ++)
+        items[i].filename = String (str_printf ("file:///music/%08d.ogg", first + i));
+
+    return items;
+}
+
+static void bench (int n_entries)
+{
+    printf ("%d entries:\n", n_entries);
+
+    PlaylistData playlist (nullptr, "Benchmark");
+
+    start ();
+    playlist.insert_items (0, make_items (0, n_entries));
+    finish ("insert (append)");
+
+    /* the usual case of adding a few files in the middle of a playlist */
+    start ();
+    for (int i = 0; i < 100; i ++)
+        playlist.insert_items (n_entries / 2, make_items (n_entries + i, 1));
+    finish ("insert 1 at middle (x100)");
+
+    start ();
+    for (int i = 0; i < 100; i ++)
+        playlist.remove_entries (n_entries / 2, 1);
+    finish ("remove 1 at middle (x100)");
+
+    assert (playlist.n_entries () == n_entries);
+
+    start ();
+    playlist.select_all (true);
+    playlist.select_all (false);
+    finish ("select all, select none");
+
+    start ();
+    for (int i = 0; i < n_entries; i += 2)
+        playlist.select_entry (i, true);
+    finish ("select every other entry");
+
+    start ();
+    int n_selected = playlist.n_selected (1, n_entries - 2);
+    finish ("count selected in a range");
+
+    assert (n_selected == (n_entries - 1) / 2);
+
+    start ();
+    playlist.invert_selection ();
+    playlist.invert_selection ();
+    finish ("invert selection (x2)");
+
+    n_selected = playlist.n_selected (0, n_entries);
+    assert (n_selected == (n_entries + 1) / 2);
+
+    start ();
+    playlist.shift_entries (n_entries / 2, 10);
+    finish ("shift selected by 10");
+
+    start ();
+    playlist.set_position (n_entries / 2);
+    for (int i = 0; i < 100; i ++)
+        playlist.next_song (true);
+    finish ("next song (x100)");
+
+    start ();
+    playlist.remove_selected ();
+    finish ("remove selected");
+
+    assert (playlist.n_entries () == n_entries - n_selected);
+
+    playlist.randomize_order ();
+    start ();
+    playlist.sort ({Playlist::Path});
+    finish ("sort by path (keys)");
+
+    playlist.randomize_order ();
+    start ();
+    playlist.sort (PlaylistData::CompareData {str_compare_encoded, nullptr});
+    finish ("sort by path (callback)");
+
+    start ();
+    playlist.remove_entries (0, -1);
+    finish ("remove all");
+}
+
+int main (int argc, char * * argv)
+{
+    PlaylistData::update_formatter ();
+
+    if (argc > 1)
+        bench (atoi (argv[1]));
+    else
+    {
+        bench (10000);
+        bench (100000);
+        bench (1000000);
+    }
+
+    PlaylistData::cleanup_formatter ();
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * bench-resampler.cc - Fixed output format benchmark for libaudcore
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "resampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+/* as many frames as the output code typically gets at once */
+static constexpr int frames = 4096;
+
+/* ten seconds of audio per case */
+static constexpr int seconds = 10;
+
+typedef std::chrono::steady_clock Clock;
+
+static void report (const char * name, Clock::duration time, const char * extra = "")
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds> (time).count ();
+    printf ("  %-28s %10.3f ms %8.1fx real time%s\n", name, us / 1000.0,
+     seconds * 1e6 / us, extra);
+}
+
+/* resamples ten seconds of a stereo sine wave in blocks, returning the time
+ * taken and the signal-to-noise ratio of the result */
+static Clock::duration resample (int in_rate, int out_rate, double freq, double & snr)
+{
+    int in_frames = in_rate * seconds;
+    Index<float> in, out, whole;
+
+    in.resize (2 * in_frames);
+    for (int f = 0; f < in_frames; f ++)
+        in[2 * f] = in[2 * f + 1] = 0.5 * sin (2 * M_PI * freq * f / in_rate);
+
+    Resampler rs;
+    rs.setup (2, in_rate, out_rate);
+    Clock::duration time {};
+
+    for (int f = 0; f < in_frames; f += frames)
+    {
+        auto start = Clock::now ();
+        rs.process (& in[2 * f], aud::min (frames, in_frames - f), out);
+        time += Clock::now () - start;
+
+        whole.insert (out.begin (), -1, out.len ());
+    }
+
+    /* skip the start, where the filter sees silence before the input */
+    int skip = (int64_t) 2 * rs.latency () * out_rate / in_rate;
+    double signal = 0, noise = 0;
+
+    for (int f = skip; f < whole.len () / 2; f ++)
+    {
+        double ref = 0.5 * sin (2 * M_PI * freq * f / out_rate);
+        signal += ref * ref;
+        noise += (whole[2 * f] - ref) * (whole[2 * f] - ref);
+    }
+
+    snr = noise ? 10 * log10 (signal / noise) : INFINITY;
+    return time;
+}
+
+static void bench_resample (int in_rate, int out_rate)
+{
+    char extra[64];
+    double snr;
+
+    printf ("%d Hz to %d Hz, stereo:\n", in_rate, out_rate);
+
+    /* reopening the output at the input rate needs no conversion at all; what
+     * it costs instead is the gap while the device is drained and reopened */
+    report ("reopen (no conversion)", resample (in_rate, in_rate, 1000, snr));
+
+    for (double freq : {1000, 15000})
+    {
+        Clock::duration time = resample (in_rate, out_rate, freq, snr);
+        snprintf (extra, sizeof extra, ", %d Hz at %.1f dB SNR", (int) freq, snr);
+        report ("fixed format", time, extra);
+    }
+}
+
+/* the matrix product as first written, one output channel at a time */
+static void remix_scalar (const float (* matrix)[AUD_MAX_CHANNELS], int in_channels,
+ int out_channels, const float * in, int n_frames, Index<float> & out)
+{
+    out.resize (n_frames * out_channels);
+    float * dst = out.begin ();
+
+    for (int f = 0; f < n_frames; f ++)
+    {
+        for (int o = 0; o < out_channels; o ++)
+        {
+            float sum = 0;
+            for (int i = 0; i < in_channels; i ++)
+                sum += matrix[o][i] * in[i];
+
+            dst[o] = sum;
+        }
+
+        in += in_channels;
+        dst += out_channels;
+    }
+}
+
+static void bench_remix (int in_channels, int out_channels)
+{
+    int rate = 48000;
+    int total = rate * seconds;
+
+    Remixer mix;
+    mix.setup (in_channels, out_channels);
+
+    /* read back the matrix by remixing one channel at a time */
+    float matrix[AUD_MAX_CHANNELS][AUD_MAX_CHANNELS] = {};
+    Index<float> in, out, out2;
+
+    for (int i = 0; i < in_channels; i ++)
+    {
+        in.resize (0);
+        in.insert (0, in_channels);
+        in[i] = 1;
+
+        mix.process (in.begin (), 1, out);
+        for (int o = 0; o < out_channels; o ++)
+            matrix[o][i] = out[o];
+    }
+
+    in.resize (frames * in_channels);
+    for (float & f : in)
+        f = (rand () % 2001 - 1000) / 1000.0f;
+
+    printf ("%d to %d channels at %d Hz:\n", in_channels, out_channels, rate);
+
+    Clock::duration time {};
+    for (int f = 0; f < total; f += frames)
+    {
+        auto start = Clock::now ();
+        remix_scalar (matrix, in_channels, out_channels, in.begin (), frames, out);
+        time += Clock::now () - start;
+    }
+
+    report ("one output at a time", time);
+
+    time = Clock::duration ();
+    for (int f = 0; f < total; f += frames)
+    {
+        auto start = Clock::now ();
+        mix.process (in.begin (), frames, out2);
+        time += Clock::now () - start;
+    }
+
+    bool same = ! memcmp (out.begin (), out2.begin (), out.len () * sizeof (float));
+    report ("outputs in SIMD lanes", time, same ? "" : " (mismatch)");
+}
+
+int main ()
+{
+    bench_resample (44100, 48000);
+    bench_resample (48000, 44100);
+    bench_resample (96000, 44100);
+    bench_resample (44056, 48000);
+
+    bench_remix (1, 2);
+    bench_remix (2, 6);
+    bench_remix (6, 2);
+    bench_remix (8, 2);
+    bench_remix (8, 6);
+
+    return 0;
+}
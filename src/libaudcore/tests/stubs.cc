@@ -1,14 +1,118 @@
+#include "drct.h"
+#include "hook.h"
+#include "interface.h"
 #include "internal.h"
+#include "playlist-data.h"
+#include "plugins.h"
+#include "runtime.h"
 #include "vfs.h"
 
+#include <string.h>
+
+#define EQ_TEST_BANDS "-12,-6,0,3,6,9,12,6,0,-6"
+
 extern "C" const char * libguess_determine_encoding (const char *, int, const char *)
     { return nullptr; }
 
-bool aud_get_bool (const char *, const char *)
-    { return false; }
-String aud_get_str (const char *, const char *)
-    { return String (""); }
+bool test_record, test_shuffle;
+
+bool aud_get_bool (const char *, const char * name)
+{
+    return ! strcmp (name, "equalizer_active") || ! strcmp (name, "pipeline_stats") ||
+     ! strcmp (name, "effect_threads") || (! strcmp (name, "record") && test_record) ||
+     (! strcmp (name, "shuffle") && test_shuffle);
+}
+int aud_get_int (const char *, const char * name)
+    { return strcmp (name, "record_buffer") ? 0 : 10; }
+double aud_get_double (const char *, const char *)
+    { return 0; }
+String aud_get_str (const char *, const char * name)
+    { return String (strcmp (name, "equalizer_bands") ? "" : EQ_TEST_BANDS); }
+void aud_set_int (const char *, const char *, int)
+    {}
+void aud_set_double (const char *, const char *, double)
+    {}
+void aud_set_str (const char *, const char *, const char *)
+    {}
 String VFSFile::get_metadata (const char *)
     { return String (); }
+int aud_get_instance ()
+    { return 1; }
+
+bool aud_drct_get_playing ()
+    { return false; }
+void event_queue (const char *, void *, EventDestroyFunc)
+    {}
+void aud_ui_show_error (const char *)
+    {}
+
+bool aud_get_render_mode ()
+    { return false; }
+OutputPlugin * render_get_output ()
+    { return nullptr; }
+void render_track_begin ()
+    {}
+void render_track_end (const char *, int64_t, int)
+    {}
+
+bool realtime_enabled ()
+    { return false; }
+bool realtime_lock_memory (void *, size_t)
+    { return false; }
+void realtime_unlock_memory ()
+    {}
+void realtime_setup_thread (const char *)
+    {}
+
+void aud_visualizer_add (Visualizer *)
+    {}
+void aud_visualizer_remove (Visualizer *)
+    {}
+void vis_runner_start_stop (bool, bool)
+    {}
+void vis_runner_pass_audio (int, const Index<float> &, int, int)
+    {}
+void vis_runner_flush ()
+    {}
 
 size_t misc_bytes_allocated;
+
+/* the effects run by effect.cc; any plugin handle is just the plugin itself */
+Index<PluginHandle *> test_effect_plugins;
+
+const Index<PluginHandle *> & aud_plugin_list (PluginType)
+    { return test_effect_plugins; }
+bool aud_plugin_get_enabled (PluginHandle *)
+    { return true; }
+const void * aud_plugin_get_header (PluginHandle * plugin)
+    { return plugin; }
+const char * aud_plugin_get_name (PluginHandle *)
+    { return "Test"; }
+const char * aud_plugin_get_basename (PluginHandle *)
+    { return "test"; }
+PluginHandle * aud_plugin_by_header (const void * header)
+    { return (PluginHandle *) header; }
+
+/* the scanner and the rest of the playlist code are not linked in */
+ScanRequest::ScanRequest (const String & filename, int flags, Callback callback,
+ PluginHandle * decoder, Tuple && tuple) :
+    filename (filename),
+    flags (flags),
+    callback (callback),
+    decoder (decoder),
+    tuple (std::move (tuple)),
+    ip (nullptr) {}
+
+CueCacheRef::~CueCacheRef ()
+    {}
+
+void pl_signal_entry_deleted (PlaylistEntry *)
+    {}
+void pl_signal_position_changed (Playlist::ID *)
+    {}
+void pl_signal_update_queued (Playlist::ID *, Playlist::UpdateLevel, int)
+    {}
+void pl_signal_rescan_needed (Playlist::ID *)
+    {}
+void pl_signal_playlist_deleted (Playlist::ID *)
+    {}
@@ -19,16 +19,71 @@
 
 #include "audio.h"
 #include "audstrings.h"
+#include "bit-index.h"
+#include "block-pool.h"
+#include "count-tree.h"
+#include "drct.h"
+#include "equalizer.h"
+#include "fft.h"
+#include "hook.h"
 #include "internal.h"
+#include "output.h"
+#include "playlist-data.h"
+#include "plugin.h"
+#include "resampler.h"
 #include "ringbuf.h"
+#include "sort-keys.h"
+#include "spsc-ring.h"
+#include "threads.h"
 #include "tuple.h"
 #include "tuple-compiler.h"
 #include "vfs.h"
+#include "vis-reader.h"
 
 #include <assert.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Counts calls to the C allocator (which also backs operator new) while
+ * count_allocs is set.  The real allocator is reached through the entry points
+ * glibc keeps for this purpose; elsewhere nothing is counted. */
+static bool count_allocs;
+static int alloc_count;
+
+#ifdef __GLIBC__
+extern "C" {
+void * __libc_malloc (size_t size);
+void * __libc_calloc (size_t n, size_t size);
+void * __libc_realloc (void * ptr, size_t size);
+
+void * malloc (size_t size)
+{
+    if (count_allocs)
+        alloc_count ++;
+    return __libc_malloc (size);
+}
+
+void * calloc (size_t n, size_t size)
+{
+    if (count_allocs)
+        alloc_count ++;
+    return __libc_calloc (n, size);
+}
+
+void * realloc (void * ptr, size_t size)
+{
+    if (count_allocs)
+        alloc_count ++;
+    return __libc_realloc (ptr, size);
+}
+}
+#endif
 
 static void test_audio_conversion ()
 {
@@ -60,6 +115,356 @@ static void test_audio_conversion ()
         assert (out[i] == (in[i] & 0xffffff));
 }
 
+static void test_audio_simd_format (int format, AudioSIMD level)
+{
+    /* odd length and offset to exercise unaligned access and leftover samples */
+    constexpr int samples = 1001;
+
+    int size = FMT_SIZEOF (format);
+    float f[samples + 1];
+    char in[4 * samples + 1], ref[4 * samples + 1], out[4 * samples + 1];
+    float ref_f[samples + 1], out_f[samples + 1];
+
+    for (int i = 0; i < samples + 1; i ++)
+    {
+        switch (i % 4)
+        {
+            case 0: f[i] = (rand () % 4001 - 2000) / 1000.0f; break; /* clipping */
+            case 1: f[i] = (rand () % 256 - 128 + 0.5f) / 128; break; /* ties */
+            case 2: f[i] = (rand () % 65536 - 32768 + 0.5f) / 32768; break;
+            default: f[i] = (rand () - RAND_MAX / 2) / (float) RAND_MAX; break;
+        }
+    }
+
+    /* NaN must come out as the negative limit, from every kernel */
+    float nan_f[samples + 1];
+    char nan_ref[4 * samples + 1];
+
+    for (int i = 0; i < samples + 1; i ++)
+    {
+        if (i % 97 == 1)
+            f[i] = NAN;
+
+        nan_f[i] = (i % 97 == 1) ? -1.0f : f[i];
+    }
+
+    for (char & c : in)
+        c = rand ();
+
+    audio_simd_select (AudioSIMD::None);
+    audio_to_int (f + 1, ref + 1, format, samples);
+    audio_to_int (nan_f + 1, nan_ref + 1, format, samples);
+    audio_from_int (in + 1, format, ref_f + 1, samples);
+
+    assert (! memcmp (ref + 1, nan_ref + 1, size * samples));
+
+    audio_simd_select (level);
+    audio_to_int (f + 1, out + 1, format, samples);
+    audio_from_int (in + 1, format, out_f + 1, samples);
+
+    assert (! memcmp (ref + 1, out + 1, size * samples));
+    assert (! memcmp (ref_f + 1, out_f + 1, sizeof (float) * samples));
+}
+
+static void test_audio_simd ()
+{
+    AudioSIMD best = audio_simd_get ();
+
+    for (AudioSIMD level : {AudioSIMD::SSE2, AudioSIMD::AVX2, AudioSIMD::NEON})
+    {
+        if (! audio_simd_select (level))
+            continue;
+
+        for (int format = FMT_S8; format <= FMT_U24_3BE; format ++)
+            test_audio_simd_format (format, level);
+    }
+
+    audio_simd_select (best);
+}
+
+static void test_audio_amplify_convert ()
+{
+    constexpr int channels = 3, frames = 1001, samples = channels * frames;
+
+    static float a[samples], b[samples];
+    static int16_t out1[samples], out2[samples];
+
+    for (int i = 0; i < samples; i ++)
+        a[i] = b[i] = (rand () % 3001 - 1500) / 1000.0f;
+
+    StereoVolume volume = {70, 40};
+    float factors[channels];
+    assert (audio_volume_factors (volume, channels, factors));
+
+    /* the fused pass must match the separate ones exactly */
+    audio_amplify (a, channels, frames, volume);
+    audio_soft_clip (a, samples);
+    audio_to_int (a, out1, FMT_S16_NE, samples);
+
+    audio_amplify_convert (b, out2, FMT_S16_NE, channels, frames, factors, true);
+    assert (! memcmp (out1, out2, sizeof out1));
+
+    audio_amplify_convert (b, b, FMT_FLOAT, channels, frames, factors, true);
+    assert (! memcmp (a, b, sizeof a));
+}
+
+/* the original equalizer, filtering one channel at a time */
+static void eq_filter_reference (float * data, int channels, int rate, int samples)
+{
+    const float Q = 1.2247449f;
+    const float CF[AUD_EQ_NBANDS] = {31.25f, 62.5f, 125, 250, 500, 1000,
+     2000, 4000, 8000, 16000};
+
+    double bands[AUD_EQ_NBANDS];
+    aud_eq_get_bands (bands);
+
+    int K = AUD_EQ_NBANDS;
+    while (K > 0 && CF[K - 1] > (float) rate / (2.005f * Q))
+        K --;
+
+    for (int c = 0; c < channels; c ++)
+    {
+        float wq[AUD_EQ_NBANDS][2] = {};
+
+        for (int f = c; f < samples; f += channels)
+        {
+            float yt = data[f];
+
+            for (int k = 0; k < K; k ++)
+            {
+                float th = 2 * (float) M_PI * (CF[k] / (float) rate);
+                float C = (1 - tanf (th * Q / 2)) / (1 + tanf (th * Q / 2));
+                float a0 = (1 + C) * cosf (th), a1 = -C;
+                float b0 = (1 - C) / 2, b1 = -1.005f;
+                float g = powf (10, (float) bands[k] / 20) - 1;
+
+                float w = yt * b0 + wq[k][0] * a0 + wq[k][1] * a1;
+                yt += (w + wq[k][1] * b1) * g;
+                wq[k][1] = wq[k][0];
+                wq[k][0] = w;
+            }
+
+            data[f] = yt;
+        }
+    }
+}
+
+static void test_equalizer ()
+{
+    constexpr int frames = 4096;
+    static float data[AUD_MAX_CHANNELS * frames], ref[AUD_MAX_CHANNELS * frames];
+
+    eq_init ();
+
+    /* let the equalizer pick up (and fade in) the initial gains */
+    eq_set_format (1, 44100);
+    eq_filter (data, frames);
+
+    for (int channels = 1; channels <= AUD_MAX_CHANNELS; channels ++)
+    {
+        for (int rate : {44100, 48000, 96000, 192000})
+        {
+            int samples = channels * frames;
+
+            /* impulse in each channel, staggered in time */
+            memset (data, 0, sizeof data);
+            for (int c = 0; c < channels; c ++)
+                data[c * (channels + 1)] = 1;
+
+            memcpy (ref, data, sizeof data);
+
+            eq_set_format (channels, rate);
+            eq_filter (data, samples);
+            eq_filter_reference (ref, channels, rate, samples);
+
+            for (int i = 0; i < samples; i ++)
+                assert (fabsf (data[i] - ref[i]) < 1e-4f);
+        }
+    }
+
+    eq_cleanup ();
+}
+
+static void test_fft ()
+{
+    static float in[FFT::MaxSize], re[FFT::MaxSize / 2 + 1], im[FFT::MaxSize / 2 + 1];
+
+    for (int size = FFT::MinSize; size <= FFT::MaxSize; size *= 2)
+    {
+        for (int n = 0; n < size; n ++)
+            in[n] = sinf (n * 0.37f) + 0.25f * cosf (n * 1.91f) + ((n & 3) - 1.5f) / 8;
+
+        FFT fft (size, FFTWindow::Rectangular);
+        fft.transform (in, re, im);
+
+        /* compare a few bins against a direct DFT */
+        for (int k : {0, 1, 7, size / 4 + 3, size / 2 - 1, size / 2})
+        {
+            double sum_re = 0, sum_im = 0;
+            for (int n = 0; n < size; n ++)
+            {
+                double angle = 2 * M_PI * ((int64_t) k * n % size) / size;
+                sum_re += in[n] * cos (angle);
+                sum_im -= in[n] * sin (angle);
+            }
+
+            assert (fabs (re[k] - sum_re) < 1e-5 * size);
+            assert (fabs (im[k] - sum_im) < 1e-5 * size);
+        }
+    }
+
+    /* the amplitude of a sine wave should not depend on the window */
+    for (auto window : {FFTWindow::Rectangular, FFTWindow::Hann,
+     FFTWindow::Hamming, FFTWindow::Blackman, FFTWindow::BlackmanHarris})
+    {
+        FFT fft (1024, window);
+
+        for (int n = 0; n < 1024; n ++)
+            in[n] = 0.5f * sinf (2 * M_PI * 100 * n / 1024);
+
+        fft.magnitudes (in, re);
+        assert (fabsf (re[99] - 0.5f) < 1e-4f);
+        assert (re[49] < 1e-4f && re[299] < 1e-4f);
+    }
+}
+
+static void test_resampler ()
+{
+    static const int rates[][2] = {{44100, 48000}, {48000, 44100},
+     {96000, 44100}, {22050, 48000}, {44056, 48000}};
+
+    for (auto & r : rates)
+    {
+        int in_frames = r[0] / 2;
+        Index<float> in, out, whole, pieces;
+
+        in.resize (2 * in_frames);
+        for (int f = 0; f < in_frames; f ++)
+        {
+            in[2 * f] = 0.5f * sinf (2 * M_PI * 1000 * f / r[0]);
+            in[2 * f + 1] = -in[2 * f];
+        }
+
+        Resampler rs;
+        rs.setup (2, r[0], r[1]);
+        rs.process (in.begin (), in_frames, whole);
+
+        /* the result must not depend on how the input is split up */
+        rs.reset ();
+        for (int f = 0, block = 1; f < in_frames; f += block, block = block * 3 % 1000 + 1)
+        {
+            rs.process (& in[2 * f], aud::min (block, in_frames - f), out);
+            pieces.insert (out.begin (), -1, out.len ());
+        }
+
+        assert (pieces.len () == whole.len ());
+        for (int i = 0; i < whole.len (); i ++)
+            assert (pieces[i] == whole[i]);
+
+        /* everything but the filter latency comes out */
+        int out_frames = whole.len () / 2;
+        int expect = (int64_t) (in_frames - rs.latency ()) * r[1] / r[0];
+        assert (abs (out_frames - expect) <= 1);
+
+        /* skip the start, where the filter sees silence before the input */
+        int skip = (int64_t) 2 * rs.latency () * r[1] / r[0];
+
+        for (int f = skip; f < out_frames; f ++)
+        {
+            float ref = 0.5f * sinf (2 * M_PI * 1000 * f / r[1]);
+            assert (fabsf (whole[2 * f] - ref) < 1e-3f);
+            assert (whole[2 * f + 1] == - whole[2 * f]);
+        }
+    }
+
+    Remixer mix;
+    Index<float> out;
+
+    float mono[] = {0.5f};
+    mix.setup (1, 2);
+    mix.process (mono, 1, out);
+    assert (out.len () == 2 && out[0] == 0.5f && out[1] == 0.5f);
+
+    float stereo[] = {0.25f, 0.75f};
+    mix.setup (2, 1);
+    mix.process (stereo, 1, out);
+    assert (out.len () == 1 && out[0] == 0.5f);
+
+    /* 5.1 to stereo: no clipping at full scale, LFE dropped */
+    float surround[] = {1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0};
+    mix.setup (6, 2);
+    mix.process (surround, 2, out);
+    assert (out.len () == 4);
+    assert (fabsf (out[0] - 1) < 1e-6f && fabsf (out[1] - 1) < 1e-6f);
+    assert (out[2] == 0 && out[3] == 0);
+
+    /* stereo to quad keeps the rear channels silent */
+    mix.setup (2, 4);
+    mix.process (stereo, 1, out);
+    assert (out.len () == 4 && out[0] == 0.25f && out[1] == 0.75f);
+    assert (out[2] == 0 && out[3] == 0);
+}
+
+static void test_pipeline_stats ()
+{
+    pipeline_stats_init (); /* enabled by the test configuration */
+
+    /* 1 to 1000 microseconds, evenly spread */
+    for (int i = 1; i <= 1000; i ++)
+        pipeline_stats_record (PipelineStage::Convert, i * 1000);
+
+    PipelineStats stats {};
+    assert (pipeline_stats_summary (PipelineStage::Convert, 0, stats));
+    assert (stats.calls == 1000);
+    assert (stats.mean_ns == 500500);
+    assert (stats.max_ns == 1000000);
+
+    /* percentiles are rounded up to within 1/16 */
+    assert (stats.p50_ns >= 500000 && stats.p50_ns <= 500000 * 17 / 16);
+    assert (stats.p90_ns >= 900000 && stats.p90_ns <= 900000 * 17 / 16);
+    assert (stats.p99_ns >= 990000 && stats.p99_ns <= 1000000);
+
+    /* short times are exact; very long ones are capped at the maximum */
+    pipeline_stats_record (PipelineStage::Effect, 3, 1);
+    pipeline_stats_record (PipelineStage::Effect, 3, 1);
+    pipeline_stats_record (PipelineStage::Effect, (int64_t) 1 << 40, 1);
+
+    assert (pipeline_stats_summary (PipelineStage::Effect, 1, stats));
+    assert (stats.calls == 3);
+    assert (stats.p50_ns == 3);
+    assert (stats.p99_ns == (int64_t) 1 << 40);
+    assert (stats.max_ns == (int64_t) 1 << 40);
+
+    /* effects past the last slot are not recorded */
+    pipeline_stats_record (PipelineStage::Effect, 100, PIPELINE_MAX_EFFECTS);
+    assert (! pipeline_stats_summary (PipelineStage::Effect, PIPELINE_MAX_EFFECTS, stats));
+
+    /* concurrent recording loses nothing */
+    pipeline_stats_reset ();
+    assert (! pipeline_stats_summary (PipelineStage::Convert, 0, stats));
+
+    std::thread threads[4];
+    for (std::thread & t : threads)
+    {
+        t = std::thread ([] () {
+            for (int i = 0; i < 10000; i ++)
+            {
+                StageTimer timer (PipelineStage::Decoder);
+            }
+        });
+    }
+
+    for (std::thread & t : threads)
+        t.join ();
+
+    assert (pipeline_stats_summary (PipelineStage::Decoder, 0, stats));
+    assert (stats.calls == 40000);
+    assert (stats.p50_ns <= stats.p90_ns && stats.p90_ns <= stats.p99_ns);
+    assert (stats.p99_ns <= stats.max_ns);
+
+    pipeline_stats_cleanup ();
+}
+
 static void test_case_conversion ()
 {
     const char in[]        = "AÄaäEÊeêIÌiìOÕoõUÚuú";
@@ -451,9 +856,444 @@ static void test_ringbuf ()
     ring.discard ();
     assert (ring.len () == 0);
 
+    /* copying out leaves the contents in place, also across the wrap */
+    RingBuf<int> ints;
+    ints.alloc (8);
+
+    for (int i = 0; i < 6; i ++)
+        ints.push (i);
+    for (int i = 0; i < 4; i ++)
+        ints.pop ();
+    for (int i = 6; i < 11; i ++)
+        ints.push (i);
+
+    int out[7];
+    ints.copy_out (0, out, 7);
+
+    for (int i = 0; i < 7; i ++)
+        assert (out[i] == 4 + i);
+
+    ints.copy_out (3, out, 3);
+    assert (out[0] == 7 && out[1] == 8 && out[2] == 9);
+    assert (ints.len () == 7 && ints.head () == 4);
+
     string_leak_check ();
 }
 
+static void test_spsc_ring ()
+{
+    SPSCRing ring;
+    ring.alloc (10);
+
+    char in[16], out[16];
+    for (int i = 0; i < 16; i ++)
+        in[i] = i;
+
+    assert (ring.write (in, 6) == 6);
+    assert (ring.read (out, 4) == 4);
+    assert (! memcmp (out, in, 4));
+
+    /* writes wrap around and stop when full */
+    assert (ring.write (in + 6, 10) == 8);
+    assert (ring.len () == 10 && ring.space () == 0);
+
+    const void * area;
+    assert (ring.peek (& area) == 6);
+    assert (! memcmp (area, in + 4, 6));
+    ring.consume (6);
+
+    assert (ring.read (out, 16) == 4);
+    assert (! memcmp (out, in + 10, 4));
+    assert (ring.len () == 0);
+
+    /* discarded data is skipped and its space reclaimed by the consumer */
+    ring.write (in, 8);
+    ring.discard ();
+    assert (ring.len () == 0 && ring.space () == 2);
+    ring.write (in + 8, 2);
+    assert (ring.read (out, 16) == 2);
+    assert (! memcmp (out, in + 8, 2) && ring.space () == 10);
+
+    /* one producer and one consumer thread, byte-exact */
+    static constexpr int total = 1 << 20;
+    ring.alloc (4093);
+
+    std::thread consumer ([& ring] () {
+        unsigned char buf[1000];
+        int pos = 0;
+
+        while (pos < total)
+        {
+            int len = ring.read (buf, aud::min ((int) sizeof buf, total - pos));
+            if (! len)
+                std::this_thread::yield ();
+
+            for (int i = 0; i < len; i ++)
+                assert (buf[i] == (unsigned char) ((pos + i) * 7));
+
+            pos += len;
+        }
+    });
+
+    unsigned char buf[777];
+    for (int pos = 0; pos < total; )
+    {
+        int len = aud::min ((int) sizeof buf, total - pos);
+        for (int i = 0; i < len; i ++)
+            buf[i] = (pos + i) * 7;
+
+        for (int done = 0; done < len; )
+        {
+            int written = ring.write (buf + done, len - done);
+            if (! written)
+                std::this_thread::yield ();
+
+            done += written;
+        }
+
+        pos += len;
+    }
+
+    consumer.join ();
+    assert (ring.len () == 0);
+}
+
+static void test_block_pool ()
+{
+    AudioBlockPool pool;
+    pool.alloc (2, 64);
+    assert (pool.available () == 2);
+
+    /* running dry hands out new blocks; a full pool frees extra ones */
+    Index<float> a = pool.take (), b = pool.take (), c = pool.take ();
+    assert (pool.available () == 0 && pool.misses () == 1);
+    pool.give (std::move (a));
+    pool.give (std::move (b));
+    c.resize (10);
+    pool.give (std::move (c));
+    assert (pool.available () == 2 && ! c.len ());
+}
+
+/* multiplies the audio by a constant, in place */
+class ScaleEffect : public EffectPlugin
+{
+public:
+    ScaleEffect (float factor) :
+        EffectPlugin ({"Scale"}, 0, true),
+        m_factor (factor) {}
+
+    void start (int & channels, int & rate) {}
+
+    Index<float> & process (Index<float> & data)
+    {
+        for (float & sample : data)
+            sample *= m_factor;
+
+        return data;
+    }
+
+private:
+    float m_factor;
+};
+
+extern Index<PluginHandle *> test_effect_plugins; /* in stubs.cc */
+
+/* feeds one block of the sequence 0, 1, 2, ... to the effects and checks that
+ * the output, which lags behind, continues the sequence times 3 */
+static void process_effect_block (Index<float> & data, int samples, int & in, int & out)
+{
+    data.resize (samples);
+    for (float & sample : data)
+        sample = in ++;
+
+    for (float sample : effect_process (data))
+        assert (sample == 3 * out ++);
+}
+
+static void test_effects ()
+{
+    static constexpr int samples = 1024;
+
+    ScaleEffect effect1 (2), effect2 (3), effect3 (0.5f);
+    for (EffectPlugin * ep : {& effect1, & effect2, & effect3})
+        test_effect_plugins.append ((PluginHandle *) ep);
+
+    /* "effect_threads" is set by the test configuration */
+    int channels = 2, rate = 44100;
+    effect_start (channels, rate);
+
+    Index<float> data;
+    int in = 0, out = 0;
+
+    process_effect_block (data, samples, in, out);
+
+    /* in the steady state, blocks cycle through the pool without any memory
+     * being allocated */
+    count_allocs = true;
+    for (int i = 0; i < 1000; i ++)
+        process_effect_block (data, samples, in, out);
+    count_allocs = false;
+
+    assert (! alloc_count);
+
+    /* larger blocks make their way through as well */
+    for (int i = 0; i < 10; i ++)
+        process_effect_block (data, 16 * samples, in, out);
+
+    /* after a flush, the output picks up with the next block */
+    assert (effect_flush (false));
+    out = in;
+
+    for (int i = 0; i < 10; i ++)
+        process_effect_block (data, samples, in, out);
+
+    /* finishing returns the rest */
+    data.resize (0);
+    for (float sample : effect_finish (data, false))
+        assert (sample == 3 * out ++);
+
+    assert (out == in);
+
+    effect_cleanup ();
+    test_effect_plugins.clear ();
+}
+
+/* an output that takes any amount of audio at once */
+class NullOutput : public OutputPlugin
+{
+public:
+    NullOutput () :
+        OutputPlugin ({"Null"}, 0) {}
+
+    StereoVolume get_volume () { return {0, 0}; }
+    void set_volume (StereoVolume) {}
+    bool open_audio (int, int, int, String &) { return true; }
+    void close_audio () {}
+    void period_wait () {}
+    int write_audio (const void *, int size) { return size; }
+    void drain () {}
+    int get_delay () { return 0; }
+    void pause (bool) {}
+    void flush () {}
+};
+
+/* a slow recorder that keeps what it is given, a few bytes at a time, so
+ * that the space it frees is seldom a whole number of frames */
+class KeepOutput : public NullOutput
+{
+public:
+    Index<char> kept;
+
+    int write_audio (const void * data, int size)
+    {
+        usleep (100);
+        size = aud::min (size, 6);
+        kept.insert ((const char *) data, -1, size);
+        return size;
+    }
+};
+
+extern bool test_record; /* in stubs.cc */
+
+/* writes stereo frames numbered from <first>, as (n, -n) */
+static void write_test_frames (int first, int frames)
+{
+    Index<float> data;
+    data.resize (2 * frames);
+
+    for (int f = 0; f < frames; f ++)
+    {
+        data[2 * f] = first + f;
+        data[2 * f + 1] = -(first + f);
+    }
+
+    assert (output_write_audio (data.begin (), sizeof (float) * data.len (), -1));
+}
+
+static void test_output ()
+{
+    NullOutput primary;
+    KeepOutput secondary;
+    auto primary_handle = (PluginHandle *) & primary;
+    auto secondary_handle = (PluginHandle *) & secondary;
+
+    output_init ();
+    assert (output_plugin_set_current (primary_handle));
+    assert (output_open_audio (String ("test"), Tuple (), FMT_FLOAT, 44100, 2, 0, true));
+
+    /* while paused, the input thread waits in write_output() */
+    std::thread input ([] () { write_test_frames (0, 4096); });
+    usleep (100000);
+
+    /* recording can still be switched on and off meanwhile */
+    assert (output_plugin_add_secondary (secondary_handle));
+    test_record = true;
+    hook_call ("set record", nullptr);
+    test_record = false;
+    hook_call ("set record", nullptr);
+    output_plugin_remove_secondary (secondary_handle);
+    assert (output_plugin_add_secondary (secondary_handle));
+    test_record = true;
+    hook_call ("set record", nullptr);
+
+    output_pause (false);
+    input.join ();
+
+    /* the recorder cannot keep up, so most of this is dropped from its 10 ms
+     * buffer, but always whole frames */
+    for (int f = 4096; f < 8 * 4096; f += 512)
+    {
+        write_test_frames (f, 512);
+        usleep (1000);
+    }
+
+    RecordStats stats;
+    assert (aud_drct_get_record_stats (secondary_handle, stats));
+    assert (stats.dropped_frames > 0);
+
+    output_close_audio ();
+    output_drain ();
+
+    auto kept = (const float *) secondary.kept.begin ();
+    int kept_frames = secondary.kept.len () / (2 * sizeof (float));
+
+    assert (secondary.kept.len () % (2 * sizeof (float)) == 0);
+    assert (kept_frames + stats.dropped_frames == 7 * 4096);
+
+    for (int f = 0; f < kept_frames; f ++)
+    {
+        assert (kept[2 * f + 1] == -kept[2 * f]);
+        assert (f == 0 || kept[2 * f] > kept[2 * f - 2]);
+    }
+
+    test_record = false;
+    output_plugin_remove_secondary (secondary_handle);
+    assert (output_plugin_set_current (nullptr));
+    output_cleanup ();
+}
+
+static void publish_vis_frame (int n, int channels)
+{
+    float pcm[AUD_MAX_CHANNELS * 512], mono[512], freq[256];
+
+    for (float & x : pcm)
+        x = n;
+    for (float & x : mono)
+        x = n;
+    for (float & x : freq)
+        x = n;
+
+    vis_export_publish (pcm, channels, mono, freq, n * 1000);
+}
+
+static void check_vis_frame (const AudVisShmFrame & frame, int channels)
+{
+    float n = frame.index;
+
+    assert (frame.channels == channels && frame.position_us == (int64_t) frame.index * 1000);
+
+    for (int i = 0; i < channels * 512; i ++)
+        assert (frame.pcm[i] == n);
+    for (float x : frame.mono)
+        assert (x == n);
+    for (float x : frame.freq)
+        assert (x == n);
+}
+
+static void test_vis_export ()
+{
+    StringBuf name = str_printf ("/audacious-vis-test-%d", (int) getpid ());
+
+    assert (vis_export_open (name));
+
+    VisReader reader;
+    assert (! vis_reader_open (& reader, name));
+
+    static AudVisShmFrame frame;
+    assert (! vis_reader_poll (& reader, & frame));
+
+    publish_vis_frame (0, 2);
+    assert (vis_reader_poll (& reader, & frame) == 1);
+    check_vis_frame (frame, 2);
+    assert (! vis_reader_poll (& reader, & frame));
+
+    /* a slow reader skips to the newest frame */
+    for (int n = 1; n <= 40; n ++)
+        publish_vis_frame (n, 6);
+
+    assert (vis_reader_poll (& reader, & frame) == 1);
+    assert (frame.index == 40);
+    check_vis_frame (frame, 6);
+
+    vis_export_publish (nullptr, 0, nullptr, nullptr, 41000);
+    assert (vis_reader_poll (& reader, & frame) == 1);
+    assert (frame.index == 41 && frame.channels == 0);
+
+    /* a writer running flat out never hands the reader a torn frame */
+    static constexpr int total = 20000;
+
+    std::thread writer ([] () {
+        for (int n = 42; n < total; n ++)
+            publish_vis_frame (n, AUD_MAX_CHANNELS);
+    });
+
+    int64_t last = 41;
+    while (last < total - 1)
+    {
+        if (! vis_reader_poll (& reader, & frame))
+            continue;
+
+        assert ((int64_t) frame.index > last);
+        check_vis_frame (frame, AUD_MAX_CHANNELS);
+        last = frame.index;
+    }
+
+    writer.join ();
+
+    vis_reader_close (& reader);
+    vis_export_close ();
+
+    /* the shared memory is removed along with the exporter */
+    assert (vis_reader_open (& reader, name) < 0);
+
+    /* an object left behind by an exporter that crashed, in the middle of
+     * writing a frame, with a reader still attached */
+    int fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    assert (fd >= 0 && ! ftruncate (fd, sizeof (AudVisShm)));
+
+    void * map = mmap (nullptr, sizeof (AudVisShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert (map != MAP_FAILED);
+
+    auto stale = (AudVisShm *) map;
+    stale->magic = AUD_VIS_SHM_MAGIC;
+    stale->version = AUD_VIS_SHM_VERSION;
+    stale->slots = AUD_VIS_SHM_SLOTS;
+    stale->frame_size = sizeof (AudVisShmFrame);
+    stale->write_count = 100;
+    stale->frames[100 % AUD_VIS_SHM_SLOTS].sequence = 7;
+    munmap (map, sizeof (AudVisShm));
+
+    assert (! vis_reader_open (& reader, name));
+
+    /* it cannot be taken over while another exporter holds it */
+    assert (! flock (fd, LOCK_EX | LOCK_NB));
+    assert (! vis_export_open (name));
+    close (fd);
+
+    /* once free, it is reused without going back to frame 0 */
+    assert (vis_export_open (name));
+    assert (! vis_reader_poll (& reader, & frame));
+
+    publish_vis_frame (100, 2);
+    assert (vis_reader_poll (& reader, & frame) == 1);
+    assert (frame.index == 100);
+    check_vis_frame (frame, 2);
+
+    vis_reader_close (& reader);
+    vis_export_close ();
+    assert (vis_reader_open (& reader, name) < 0);
+}
+
 static StringBuf str_recursive_insert (const char * str, int level)
 {
     StringBuf buf = str_copy (str);
@@ -481,6 +1321,928 @@ static StringBuf str_repeated_nest (const char * str, int level)
     return buf2;
 }
 
+static void check_bit_index (const BitIndex & bits, const Index<bool> & ref)
+{
+    int len = ref.len ();
+    int count = 0;
+
+    assert (bits.len () == len);
+    for (int i = 0; i < len; i ++)
+    {
+        assert (bits.get (i) == ref[i]);
+        count += ref[i];
+    }
+
+    assert (bits.count (0, len) == count);
+
+    /* counts and searches from random places */
+    for (int round = 0; round < 10 && len; round ++)
+    {
+        int pos = rand () % len;
+        int n = rand () % (len - pos + 1);
+
+        count = 0;
+        for (int i = pos; i < pos + n; i ++)
+            count += ref[i];
+
+        assert (bits.count (pos, n) == count);
+
+        for (bool value : {false, true})
+        {
+            int next = pos, prev = pos;
+            while (next < len && ref[next] != value)
+                next ++;
+            while (prev >= 0 && ref[prev] != value)
+                prev --;
+
+            assert (bits.find_next (value, pos) == (next < len ? next : -1));
+            assert (bits.find_prev (value, pos) == prev);
+        }
+    }
+}
+
+static void test_bit_index ()
+{
+    BitIndex bits;
+    Index<bool> ref;
+
+    srand (1);
+
+    /* odd lengths and positions, so that words are split every which way */
+    for (int round = 0; round < 200; round ++)
+    {
+        int pos = rand () % (ref.len () + 1);
+        int len = rand () % 150;
+
+        bits.insert (pos, len);
+        ref.insert (pos, len);
+
+        for (int i = 0; i < len; i ++)
+        {
+            bool value = rand () & 1;
+            bits.set (pos + i, value);
+            ref[pos + i] = value;
+        }
+
+        check_bit_index (bits, ref);
+
+        if (ref.len () > 0 && (round & 1))
+        {
+            pos = rand () % ref.len ();
+            len = rand () % aud::min (ref.len () - pos + 1, 150);
+
+            bits.remove (pos, len);
+            ref.remove (pos, len);
+            check_bit_index (bits, ref);
+        }
+    }
+
+    assert (ref.len () > 1000);
+
+    /* reverse everything from some point on */
+    int from = ref.len () / 3;
+    int count = ref.len () - from;
+
+    Index<int> order;
+    order.insert (0, count);
+    for (int i = 0; i < count; i ++)
+        order[i] = count - 1 - i;
+
+    Index<bool> reversed;
+    reversed.insert (0, ref.len ());
+    for (int i = 0; i < ref.len (); i ++)
+        reversed[i] = (i < from) ? ref[i] : ref[from + order[i - from]];
+
+    bits.reorder (from, order);
+    check_bit_index (bits, reversed);
+
+    bits.invert ();
+    for (int i = 0; i < reversed.len (); i ++)
+        reversed[i] = ! reversed[i];
+
+    check_bit_index (bits, reversed);
+
+    bits.fill (true);
+    for (int i = 0; i < bits.len (); i ++)
+        assert (bits.get (i));
+
+    assert (bits.find_next (false, 0) == -1 && bits.find_prev (false, bits.len ()) == -1);
+
+    /* removing from the end must not leave stray bits behind */
+    bits.remove (10, bits.len () - 10);
+    bits.insert (10, 100);
+    for (int i = 0; i < bits.len (); i ++)
+        assert (bits.get (i) == (i < 10));
+
+    bits.clear ();
+    assert (bits.len () == 0);
+}
+
+static void test_count_tree ()
+{
+    CountTree tree;
+    Index<int> ref;
+
+    srand (1);
+
+    /* grow it both ways, with some zero counts in between */
+    Index<int> counts;
+    for (int i = 0; i < 300; i ++)
+        counts.append (rand () % 3);
+
+    ref.insert (counts.begin (), 0, counts.len ());
+    tree.build (std::move (counts));
+
+    for (int i = 0; i < 333; i ++)
+    {
+        int count = rand () % 3;
+        tree.append (count);
+        ref.append (count);
+    }
+
+    for (int round = 0; round < 1000; round ++)
+    {
+        int pos = rand () % ref.len ();
+        int delta = rand () % 5 - ref[pos] / 2;
+
+        tree.add (pos, delta);
+        ref[pos] += delta;
+    }
+
+    int total = 0;
+
+    for (int pos = 0; pos < ref.len (); pos ++)
+    {
+        assert (tree.get (pos) == ref[pos]);
+        assert (tree.sum (pos) == total);
+
+        for (int n = total; n < total + ref[pos]; n ++)
+            assert (tree.find (n) == pos);
+
+        total += ref[pos];
+    }
+
+    assert (tree.total () == total && tree.sum (ref.len ()) == total);
+
+    tree.clear ();
+    assert (tree.len () == 0 && tree.total () == 0);
+}
+
+static String random_name ()
+{
+    static const char chars[] = "aAbZ_ 0129/";
+    char name[8];
+    int len = rand () % 8;
+
+    for (int i = 0; i < len; i ++)
+        name[i] = chars[rand () % (sizeof chars - 1)];
+
+    return String (str_copy (name, len));
+}
+
+static int sign (int x)
+    { return (x > 0) - (x < 0); }
+
+static void test_sort_keys ()
+{
+    srand (1);
+
+    /* single keys agree with the comparison functions */
+    {
+        SortKeys keys;
+        Index<String> names;
+
+        for (int i = 0; i < 200; i ++)
+        {
+            Tuple tuple;
+            names.append (random_name ());
+            tuple.set_str (Tuple::Title, names[i]);
+            keys.add ("", tuple, {Playlist::Title});
+        }
+
+        for (int a = 0; a < 200; a ++)
+        {
+            for (int b = 0; b < 200; b ++)
+                assert (sign (keys.compare (a, b)) == sign (str_compare (names[a], names[b])));
+        }
+    }
+
+    static const char * const files[] = {
+        "file:///music/Track%202.ogg",
+        "file:///music/track%2010.ogg",
+        "file:///music/track%2010b.ogg",
+        "file:///music/track%20010c.ogg",
+        "file:///music/a/Track%201.ogg",
+        "file:///music/b/track%200.ogg",
+        "file:///musica/track%201.ogg"
+    };
+
+    /* files in a folder come before those in its subfolders */
+    {
+        SortKeys keys;
+        Index<int> list;
+
+        for (int i = aud::n_elems (files) - 1; i >= 0; i --)
+        {
+            keys.add (files[i], Tuple (), {Playlist::Path});
+            list.append (i);
+        }
+
+        keys.sort (list);
+
+        for (int i = 0; i < list.len (); i ++)
+            assert (list[i] == i);
+    }
+
+    {
+        SortKeys keys;
+
+        for (const char * file : files)
+            keys.add (file, Tuple (), {Playlist::Filename});
+
+        for (int a = 0; a < keys.len (); a ++)
+        {
+            for (int b = 0; b < keys.len (); b ++)
+            {
+                int expected = str_compare_encoded (strrchr (files[a], '/') + 1,
+                 strrchr (files[b], '/') + 1);
+                assert (sign (keys.compare (a, b)) == sign (expected));
+            }
+        }
+    }
+
+    /* equal keys hash alike; empty fields are reported */
+    {
+        SortKeys keys;
+        Tuple tuples[4];
+
+        tuples[0].set_str (Tuple::Album, "Disc 01");
+        tuples[1].set_str (Tuple::Album, "disc 1");
+        tuples[2].set_str (Tuple::Album, "");
+
+        assert (keys.add ("", tuples[0], {Playlist::Album}));
+        assert (keys.add ("", tuples[1], {Playlist::Album}));
+        assert (! keys.add ("", tuples[2], {Playlist::Album}));
+        assert (! keys.add ("", tuples[3], {Playlist::Album}));
+        assert (! keys.add ("", tuples[3], {Playlist::Album, Playlist::Filename}));
+        assert (keys.add ("a.ogg", tuples[3], {Playlist::Album, Playlist::Filename}));
+
+        assert (keys.compare (0, 1) == 0 && keys.hash (0) == keys.hash (1));
+        assert (keys.compare (2, 3) > 0);
+    }
+
+    /* several schemes at once, with missing fields first; large enough to be
+     * sorted by several threads */
+    {
+        SortKeys keys;
+        Index<int> list;
+
+        for (int i = 0; i < 100000; i ++)
+        {
+            Tuple tuple;
+
+            if (rand () % 10)
+                tuple.set_str (Tuple::Album, str_printf ("Album %d", rand () % 100));
+            if (rand () % 10)
+                tuple.set_int (Tuple::Track, rand () % 20 - 1);
+
+            keys.add ("", tuple, {Playlist::Album, Playlist::Track});
+            list.append (i);
+        }
+
+        keys.sort (list);
+
+        for (int i = 1; i < list.len (); i ++)
+        {
+            int diff = keys.compare (list[i - 1], list[i]);
+            assert (diff < 0 || (diff == 0 && list[i - 1] < list[i]));
+        }
+    }
+}
+
+static Tuple test_tuple (const char * filename, int length)
+{
+    Tuple tuple;
+    tuple.set_filename (filename);
+    tuple.set_int (Tuple::Length, length);
+    tuple.set_state (Tuple::Valid);
+    return tuple;
+}
+
+/* "file:///test/<n>.ogg", lasting n + 1 seconds */
+static Index<PlaylistAddItem> make_test_items (int first, int count)
+{
+    Index<PlaylistAddItem> items;
+    items.insert (0, count);
+
+    for (int i = 0; i < count; i ++)
+    {
+        items[i].filename = String (str_printf ("file:///test/%d.ogg", first + i));
+        items[i].tuple = test_tuple (items[i].filename, (first + i + 1) * 1000);
+    }
+
+    return items;
+}
+
+static int entry_index (const PlaylistData & playlist, const PlaylistEntry * entry)
+{
+    for (int i = 0; i < playlist.n_entries (); i ++)
+    {
+        if (playlist.entry_at (i) == entry)
+            return i;
+    }
+
+    return -1;
+}
+
+extern bool test_shuffle; /* in stubs.cc */
+
+/* a peek in shuffle mode does not count as playing the entry, even if the
+ * user then jumps somewhere else */
+static void test_playlist_peek ()
+{
+    PlaylistData playlist (nullptr, "Test");
+    playlist.insert_items (0, make_test_items (0, 20));
+
+    int played[20] {};
+
+    test_shuffle = true;
+    srand (1);
+
+    for (int i = 0; i < 5; i ++)
+    {
+        assert (playlist.next_song (false));
+        played[playlist.position ()] ++;
+    }
+
+    int peeked = entry_index (playlist, playlist.peek_next_song (false));
+    assert (peeked >= 0 && ! played[peeked]);
+    assert (entry_index (playlist, playlist.peek_next_song (false)) == peeked);
+    assert (playlist.shuffle_history ().find (peeked) < 0);
+
+    int jump = 0;
+    while (jump == peeked || played[jump])
+        jump ++;
+
+    playlist.set_position (jump);
+    played[jump] ++;
+
+    assert (playlist.shuffle_history ().find (peeked) < 0);
+
+    /* next_song() goes where the peek said it would */
+    peeked = entry_index (playlist, playlist.peek_next_song (false));
+    assert (playlist.next_song (false) && playlist.position () == peeked);
+    played[peeked] ++;
+
+    while (playlist.next_song (false))
+        played[playlist.position ()] ++;
+
+    for (int count : played)
+        assert (count == 1);
+
+    assert (playlist.shuffle_history ().len () == 20);
+
+    test_shuffle = false;
+}
+
+/* the expected contents of a playlist, kept naively by the number in the
+ * filename of each entry (its "id") */
+struct PlaylistModel
+{
+    Index<int> ids; /* in playlist order */
+    Index<int> lengths, selected; /* by id */
+    Index<int> queue;
+    int position = -1, focus = -1;
+
+    int index_of (int id) const
+        { return (id < 0) ? -1 : ids.find (id); }
+};
+
+static int entry_id (const PlaylistData & playlist, int entry_num)
+{
+    String filename = playlist.entry_filename (entry_num);
+    return atoi (strrchr (filename, '/') + 1);
+}
+
+static void check_playlist (const PlaylistData & playlist, const PlaylistModel & model)
+{
+    int n_entries = model.ids.len ();
+    int n_selected = 0;
+    int64_t total_length = 0, selected_length = 0;
+
+    assert (playlist.n_entries () == n_entries);
+
+    for (int i = 0; i < n_entries; i ++)
+    {
+        int id = model.ids[i];
+
+        assert (entry_id (playlist, i) == id);
+        assert (playlist.entry_tuple (i).get_int (Tuple::Length) == model.lengths[id]);
+        assert (playlist.entry_selected (i) == (bool) model.selected[id]);
+        assert ((playlist.queue_find_entry (i) >= 0) == (model.queue.find (id) >= 0));
+
+        total_length += model.lengths[id];
+
+        if (model.selected[id])
+        {
+            n_selected ++;
+            selected_length += model.lengths[id];
+        }
+    }
+
+    assert (playlist.total_length () == total_length);
+    assert (playlist.n_selected (0, -1) == n_selected);
+    assert (playlist.selected_length () == selected_length);
+
+    assert (playlist.position () == model.index_of (model.position));
+    assert (playlist.focus () == model.index_of (model.focus));
+
+    assert (playlist.n_queued () == model.queue.len ());
+
+    for (int i = 0; i < model.queue.len (); i ++)
+    {
+        int entry_num = model.index_of (model.queue[i]);
+        assert (playlist.queue_get_entry (i) == entry_num);
+        assert (playlist.queue_find_entry (entry_num) == i);
+    }
+}
+
+/* gives an entry a new length, as read by the scanner; this finds the entry by
+ * its number, which is only kept up to date when needed */
+static void rescan_entry (PlaylistData & playlist, PlaylistModel & model, int entry_num)
+{
+    int id = model.ids[entry_num];
+    String filename = playlist.entry_filename (entry_num);
+
+    model.lengths[id] += 1000;
+
+    ScanRequest request (filename, 0, nullptr, nullptr,
+     test_tuple (filename, model.lengths[id]));
+
+    assert (playlist.refresh_entry_from_scan (playlist.entry_at (entry_num), & request));
+}
+
+static void forget_id (PlaylistModel & model, int id)
+{
+    int queued = model.queue.find (id);
+    if (queued >= 0)
+        model.queue.remove (queued, 1);
+
+    if (model.position == id)
+        model.position = -1;
+
+    model.selected[id] = false;
+}
+
+/* the selected entries with the given ids, in playlist order */
+static Index<int> selected_ids (const PlaylistModel & model)
+{
+    Index<int> ids;
+
+    for (int id : model.ids)
+    {
+        if (model.selected[id])
+            ids.append (id);
+    }
+
+    return ids;
+}
+
+static void test_playlist_data ()
+{
+    PlaylistData playlist (nullptr, "Test");
+    PlaylistModel model;
+    int next_id = 0;
+
+    srand (1);
+
+    for (int round = 0; round < 3000; round ++)
+    {
+        int n_entries = model.ids.len ();
+        int entry_num = n_entries ? rand () % n_entries : -1;
+        int id = (entry_num >= 0) ? model.ids[entry_num] : -1;
+
+        switch (rand () % 8)
+        {
+        case 0:
+        {
+            int at = rand () % (n_entries + 1);
+            int count = 1 + rand () % ((n_entries < 100) ? 12 : 4);
+
+            playlist.insert_items (at, make_test_items (next_id, count));
+
+            for (int i = 0; i < count; i ++)
+            {
+                model.ids.insert (at + i, 1);
+                model.ids[at + i] = next_id;
+                model.lengths.append ((next_id + 1) * 1000);
+                model.selected.append (false);
+                next_id ++;
+            }
+
+            break;
+        }
+
+        case 1:
+        {
+            if (entry_num < 0)
+                break;
+
+            int count = aud::min (1 + rand () % 4, n_entries - entry_num);
+            int end = entry_num + count;
+
+            playlist.remove_entries (entry_num, count);
+
+            /* the entry after the removed ones takes the focus */
+            int focus = model.index_of (model.focus);
+            if (focus >= entry_num && focus < end)
+                model.focus = (end < n_entries) ? model.ids[end] :
+                 (entry_num > 0) ? model.ids[entry_num - 1] : -1;
+
+            for (int i = entry_num; i < end; i ++)
+                forget_id (model, model.ids[i]);
+
+            model.ids.remove (entry_num, count);
+            break;
+        }
+
+        case 2:
+            for (int i = 0; i < 3 && id >= 0; i ++)
+            {
+                bool selected = rand () % 2;
+                playlist.select_entry (entry_num, selected);
+                model.selected[id] = selected;
+
+                entry_num = rand () % n_entries;
+                id = model.ids[entry_num];
+            }
+
+            break;
+
+        case 3:
+            if (rand () % 2)
+            {
+                playlist.set_focus (entry_num);
+                model.focus = id;
+            }
+            else
+            {
+                playlist.set_position (entry_num);
+                model.position = id;
+            }
+
+            break;
+
+        case 4:
+            if (rand () % 3 || ! model.queue.len ())
+            {
+                int at = rand () % (model.queue.len () + 2) - 1;
+
+                playlist.queue_insert (at, entry_num);
+
+                if (id >= 0 && model.queue.find (id) < 0)
+                {
+                    if (at < 0)
+                        model.queue.append (id);
+                    else
+                    {
+                        model.queue.insert (at, 1);
+                        model.queue[at] = id;
+                    }
+                }
+            }
+            else
+            {
+                int at = rand () % model.queue.len ();
+                playlist.queue_remove (at, 1);
+                model.queue.remove (at, 1);
+            }
+
+            break;
+
+        case 5:
+        {
+            if (id < 0 || ! model.selected[id])
+                break;
+
+            int distance = rand () % 11 - 5;
+            int moved = playlist.shift_entries (entry_num, distance);
+
+            /* the selected entries end up together, around the entry that is
+             * <distance> unselected entries away from the one given */
+            int center = entry_num, shift = 0;
+
+            if (distance < 0)
+            {
+                while (center > 0 && shift > distance)
+                {
+                    if (! model.selected[model.ids[-- center]])
+                        shift --;
+                }
+            }
+            else if (distance > 0)
+            {
+                center ++;
+
+                while (center < n_entries && shift < distance)
+                {
+                    if (! model.selected[model.ids[center ++]])
+                        shift ++;
+                }
+            }
+
+            assert (moved == shift);
+
+            if (! distance)
+                break;
+
+            Index<int> ids;
+
+            for (int i = 0; i < center; i ++)
+            {
+                if (! model.selected[model.ids[i]])
+                    ids.append (model.ids[i]);
+            }
+
+            for (int other : selected_ids (model))
+                ids.append (other);
+
+            for (int i = center; i < n_entries; i ++)
+            {
+                if (! model.selected[model.ids[i]])
+                    ids.append (model.ids[i]);
+            }
+
+            model.ids = std::move (ids);
+            break;
+        }
+
+        case 6:
+        {
+            /* rarely, so that the selection can build up */
+            if (rand () % 4)
+                break;
+
+            playlist.remove_selected ();
+
+            /* the nearest unselected entry takes the focus, looking down
+             * first */
+            int focus = model.index_of (model.focus);
+            if (focus >= 0 && model.selected[model.focus])
+            {
+                model.focus = -1;
+
+                for (int i = focus + 1; i < n_entries && model.focus < 0; i ++)
+                {
+                    if (! model.selected[model.ids[i]])
+                        model.focus = model.ids[i];
+                }
+
+                for (int i = focus - 1; i >= 0 && model.focus < 0; i --)
+                {
+                    if (! model.selected[model.ids[i]])
+                        model.focus = model.ids[i];
+                }
+            }
+
+            Index<int> ids;
+
+            for (int other : model.ids)
+            {
+                if (model.selected[other])
+                    forget_id (model, other);
+                else
+                    ids.append (other);
+            }
+
+            model.ids = std::move (ids);
+            break;
+        }
+
+        case 7:
+            /* the ids sort in the same order as the filenames */
+            if (rand () % 2)
+            {
+                playlist.sort ({Playlist::Path});
+                model.ids.sort ([] (int a, int b) { return a - b; });
+            }
+            else
+            {
+                playlist.sort_selected ({Playlist::Path});
+
+                Index<int> sorted = selected_ids (model);
+                sorted.sort ([] (int a, int b) { return a - b; });
+
+                int i = 0;
+                for (int & other : model.ids)
+                {
+                    if (model.selected[other])
+                        other = sorted[i ++];
+                }
+            }
+
+            break;
+        }
+
+        if (model.ids.len () && rand () % 2)
+            rescan_entry (playlist, model, rand () % model.ids.len ());
+
+        check_playlist (playlist, model);
+    }
+}
+
+/* shuffle done naively, making the same random choices as PlaylistData: the
+ * n-th entry, in playlist order, of those not played yet */
+struct ShuffleModel
+{
+    int n_entries = 0;
+    Index<int> history;
+    int position = -1;
+};
+
+static bool shuffle_model_next (ShuffleModel & model, bool repeat)
+{
+    if (model.position >= 0 && model.history.len ())
+    {
+        /* the entry after the current one, or the first one if the current
+         * one has not been played in this cycle */
+        int played = model.history.find (model.position);
+        if (played + 1 < model.history.len ())
+        {
+            model.position = model.history[played + 1];
+            return true;
+        }
+    }
+
+    if (model.history.len () == model.n_entries)
+    {
+        if (! repeat)
+            return false;
+
+        model.history.clear ();
+    }
+
+    Index<int> choices;
+
+    for (int i = 0; i < model.n_entries; i ++)
+    {
+        if (model.history.find (i) < 0)
+            choices.append (i);
+    }
+
+    model.position = choices[rand () % choices.len ()];
+    model.history.append (model.position);
+    return true;
+}
+
+static bool shuffle_model_prev (ShuffleModel & model)
+{
+    int played = (model.position >= 0) ?
+     model.history.find (model.position) : model.history.len ();
+
+    if (played < 1)
+        return false;
+
+    model.position = model.history[played - 1];
+    return true;
+}
+
+static void shuffle_model_jump (ShuffleModel & model, int entry_num)
+{
+    int played = model.history.find (entry_num);
+    if (played >= 0)
+        model.history.remove (played, 1);
+
+    model.history.append (entry_num);
+    model.position = entry_num;
+}
+
+static void check_shuffle (const PlaylistData & playlist, const ShuffleModel & model)
+{
+    assert (playlist.position () == model.position);
+
+    Index<int> history = playlist.shuffle_history ();
+    assert (history.len () == model.history.len ());
+
+    for (int i = 0; i < history.len (); i ++)
+        assert (history[i] == model.history[i]);
+}
+
+/* runs the same step on the playlist and the model, with the same random
+ * numbers */
+template<class P, class M>
+static void shuffle_step (const PlaylistData & playlist, ShuffleModel & model,
+ P playlist_step, M model_step)
+{
+    int seed = rand ();
+
+    srand (seed);
+    bool moved = playlist_step ();
+    srand (seed);
+    assert (moved == model_step ());
+
+    check_shuffle (playlist, model);
+}
+
+static void test_playlist_shuffle ()
+{
+    const int n_entries = 100;
+
+    PlaylistData playlist (nullptr, "Test");
+    playlist.insert_items (0, make_test_items (0, n_entries));
+
+    ShuffleModel model;
+    model.n_entries = n_entries;
+
+    auto next = [&] (bool repeat) {
+        shuffle_step (playlist, model, [&] () { return playlist.next_song (repeat); },
+         [&] () { return shuffle_model_next (model, repeat); });
+    };
+
+    test_shuffle = true;
+    srand (1);
+
+    /* each entry is played once, then the cycle ends */
+    {
+        int played[n_entries] {};
+
+        for (int i = 0; i < n_entries; i ++)
+        {
+            next (false);
+            played[playlist.position ()] ++;
+        }
+
+        for (int count : played)
+            assert (count == 1);
+
+        next (false);
+    }
+
+    auto jump = [&] (int entry_num) {
+        shuffle_step (playlist, model,
+         [&] () { playlist.set_position (entry_num); return true; },
+         [&] () { shuffle_model_jump (model, entry_num); return true; });
+    };
+
+    auto prev = [&] () {
+        shuffle_step (playlist, model, [&] () { return playlist.prev_song (); },
+         [&] () { return shuffle_model_prev (model); });
+    };
+
+    /* jumping to entries already played leaves gaps in the history, which are
+     * closed up from time to time; the order is kept in both directions */
+    for (int i = 0; i < 300; i ++)
+        jump (rand () % n_entries);
+
+    for (int i = 0; i < n_entries; i ++)
+        prev ();
+
+    for (int i = 0; i < n_entries; i ++)
+        next (false);
+
+    /* stepping back and forth walks the history, jumping moves the entry to
+     * the end of it, and repeating starts a new cycle once it is used up */
+    for (int round = 0; round < 5000; round ++)
+    {
+        switch (rand () % 8)
+        {
+        case 0:
+        case 1:
+        case 2:
+            prev ();
+            break;
+
+        case 3:
+            jump (rand () % n_entries);
+            break;
+
+        default:
+            next (true);
+            break;
+        }
+    }
+
+    /* each cycle started by repeating plays each entry once */
+    while (model.history.len () < n_entries || model.position != model.history[n_entries - 1])
+        next (true);
+
+    for (int cycle = 0; cycle < 3; cycle ++)
+    {
+        int played[n_entries] {};
+
+        for (int i = 0; i < n_entries; i ++)
+        {
+            next (true);
+            played[playlist.position ()] ++;
+        }
+
+        for (int count : played)
+            assert (count == 1);
+    }
+
+    test_shuffle = false;
+}
+
 static void test_stringbuf ()
 {
     char expect[262145];
@@ -519,11 +2281,28 @@ static void test_str_printf ()
 int main ()
 {
     test_audio_conversion ();
+    test_audio_simd ();
+    test_audio_amplify_convert ();
+    test_equalizer ();
+    test_fft ();
+    test_resampler ();
+    test_pipeline_stats ();
     test_case_conversion ();
     test_numeric_conversion ();
     test_filename_split ();
     test_tuple_formats ();
     test_ringbuf ();
+    test_spsc_ring ();
+    test_block_pool ();
+    test_effects ();
+    test_output ();
+    test_vis_export ();
+    test_bit_index ();
+    test_count_tree ();
+    test_sort_keys ();
+    test_playlist_data ();
+    test_playlist_peek ();
+    test_playlist_shuffle ();
     test_stringbuf ();
     test_str_printf ();
 
@@ -0,0 +1,89 @@
+/*
+ * vis-reader.c - Reference reader for the visualization exporter
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "vis-reader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int vis_reader_open (struct VisReader * reader, const char * name)
+{
+    int fd = shm_open (name, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+
+    void * map = mmap (NULL, sizeof (struct AudVisShm), PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED)
+        return -1;
+
+    reader->shm = (const struct AudVisShm *) map;
+
+    /* the rest of the header is valid once the magic number is set */
+    if (__atomic_load_n (& reader->shm->magic, __ATOMIC_ACQUIRE) != AUD_VIS_SHM_MAGIC ||
+     reader->shm->version != AUD_VIS_SHM_VERSION ||
+     reader->shm->frame_size != sizeof (struct AudVisShmFrame))
+    {
+        munmap (map, sizeof (struct AudVisShm));
+        return -1;
+    }
+
+    reader->next = __atomic_load_n (& reader->shm->write_count, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+void vis_reader_close (struct VisReader * reader)
+{
+    munmap ((void *) reader->shm, sizeof (struct AudVisShm));
+    reader->shm = NULL;
+}
+
+int vis_reader_poll (struct VisReader * reader, struct AudVisShmFrame * frame)
+{
+    while (1)
+    {
+        uint64_t count = __atomic_load_n (& reader->shm->write_count, __ATOMIC_ACQUIRE);
+        if (count <= reader->next)
+            return 0;
+
+        /* skip to the newest frame; older ones are of no use to a display */
+        uint64_t index = count - 1;
+        const struct AudVisShmFrame * slot = & reader->shm->frames[index % reader->shm->slots];
+
+        uint32_t before = __atomic_load_n (& slot->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+            continue; /* being written */
+
+        memcpy (frame, slot, sizeof (struct AudVisShmFrame));
+
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        uint32_t after = __atomic_load_n (& slot->sequence, __ATOMIC_RELAXED);
+
+        /* retry if the frame changed while it was copied, or if the writer has
+         * already gone around the ring and reused the slot */
+        if (after != before || frame->index != index)
+            continue;
+
+        reader->next = index + 1;
+        return 1;
+    }
+}
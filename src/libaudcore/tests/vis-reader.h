@@ -0,0 +1,46 @@
+/*
+ * vis-reader.h - Reference reader for the visualization exporter
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef VIS_READER_H
+#define VIS_READER_H
+
+#include "vis-shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct VisReader {
+    const struct AudVisShm * shm;
+    uint64_t next; /* index of the first frame not yet read */
+};
+
+/* maps the shared memory read-only; returns 0 on success */
+int vis_reader_open (struct VisReader * reader, const char * name);
+void vis_reader_close (struct VisReader * reader);
+
+/* copies the newest frame not yet read into *frame; returns 1 if there was
+ * one, or 0 if no new frame has been written */
+int vis_reader_poll (struct VisReader * reader, struct AudVisShmFrame * frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VIS_READER_H */
@@ -0,0 +1,308 @@
+/*
+ * vis-export.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "internal.h"
+#include "vis-shm.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "audio.h"
+#include "audstrings.h"
+#include "drct.h"
+#include "hook.h"
+#include "interface.h"
+#include "runtime.h"
+#include "visualizer.h"
+
+/* The exporter is an ordinary visualizer, so it runs on the main thread with
+ * the results already computed by vis-runner.cc and adds nothing to the work
+ * done by the audio thread.  Each result is written once, into shared memory;
+ * readers copy it from there directly (see vis-shm.h for the protocol). */
+
+static_assert (AUD_VIS_SHM_MAX_CHANNELS == AUD_MAX_CHANNELS,
+ "AUD_VIS_SHM_MAX_CHANNELS must match AUD_MAX_CHANNELS");
+
+static AudVisShm * shm;
+static String shm_name;
+
+#ifndef _WIN32
+static int shm_fd = -1; /* kept open for the lock */
+
+/* checks whether an existing object was written by a compatible exporter */
+static bool shm_compatible (int fd)
+{
+    struct stat info;
+    if (fstat (fd, & info) || info.st_size != sizeof (AudVisShm))
+        return false;
+
+    void * map = mmap (nullptr, sizeof (AudVisShm), PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    auto old = (const AudVisShm *) map;
+    bool compatible = (old->magic == AUD_VIS_SHM_MAGIC &&
+     old->version == AUD_VIS_SHM_VERSION && old->slots == AUD_VIS_SHM_SLOTS &&
+     old->frame_size == sizeof (AudVisShmFrame));
+
+    munmap (map, sizeof (AudVisShm));
+    return compatible;
+}
+#endif
+
+bool vis_export_open (const char * name)
+{
+    vis_export_close ();
+
+#ifdef _WIN32
+    AUDERR ("Visualization export is not supported on this platform.\n");
+    return false;
+#else
+    /* Readers may still have an object left over from an earlier run mapped,
+     * so it is never cleared while in use: if it is compatible, writing simply
+     * carries on from its write_count; if not, it is unlinked and a new one is
+     * created.  Another exporter using the same name holds a lock on it. */
+    bool created = false;
+    int fd;
+
+    while (1)
+    {
+        fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd >= 0)
+        {
+            created = true;
+            break;
+        }
+
+        if (errno != EEXIST || (fd = shm_open (name, O_RDWR, 0)) < 0)
+        {
+            AUDERR ("Cannot open shared memory %s: %s.\n", name, strerror (errno));
+            return false;
+        }
+
+        if (flock (fd, LOCK_EX | LOCK_NB) < 0 && errno == EWOULDBLOCK)
+        {
+            AUDERR ("Shared memory %s is in use by another exporter.\n", name);
+            close (fd);
+            return false;
+        }
+
+        if (shm_compatible (fd))
+            break;
+
+        close (fd);
+        shm_unlink (name);
+    }
+
+    /* locking is advisory and not supported everywhere; carry on without it */
+    if (created)
+        flock (fd, LOCK_EX | LOCK_NB);
+
+    void * map = MAP_FAILED;
+    if (! created || ! ftruncate (fd, sizeof (AudVisShm)))
+        map = mmap (nullptr, sizeof (AudVisShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        AUDERR ("Cannot map shared memory %s: %s.\n", name, strerror (errno));
+        close (fd);
+        shm_unlink (name);
+        return false;
+    }
+
+    shm = (AudVisShm *) map;
+    shm_fd = fd;
+
+    if (created)
+    {
+        /* a new object is already zero-filled */
+        shm->version = AUD_VIS_SHM_VERSION;
+        shm->slots = AUD_VIS_SHM_SLOTS;
+        shm->frame_size = sizeof (AudVisShmFrame);
+
+        /* a reader that finds the magic number sees the rest of the header */
+        __atomic_store_n (& shm->magic, AUD_VIS_SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        /* a frame left half-written is not published yet, but its sequence
+         * number must be even before it is written again */
+        for (AudVisShmFrame & frame : shm->frames)
+        {
+            uint32_t sequence = frame.sequence;
+            if (sequence & 1)
+                __atomic_store_n (& frame.sequence, sequence + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    shm_name = String (name);
+    AUDINFO ("Exporting visualization data to shared memory %s.\n", name);
+    return true;
+#endif
+}
+
+void vis_export_close ()
+{
+    if (! shm)
+        return;
+
+#ifndef _WIN32
+    /* readers that still have the memory mapped simply see no new frames */
+    munmap (shm, sizeof (AudVisShm));
+    shm_unlink (shm_name);
+    close (shm_fd);
+    shm_fd = -1;
+#endif
+
+    shm = nullptr;
+    shm_name = String ();
+}
+
+static int64_t monotonic_ns ()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void vis_export_publish (const float * pcm, int channels, const float * mono,
+ const float * freq, int64_t position_us)
+{
+    if (! shm)
+        return;
+
+    /* only this thread writes, so no atomic read-modify-write is needed */
+    uint64_t index = shm->write_count;
+    AudVisShmFrame & frame = shm->frames[index % AUD_VIS_SHM_SLOTS];
+    uint32_t sequence = frame.sequence;
+
+    __atomic_store_n (& frame.sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    frame.channels = channels;
+    frame.index = index;
+    frame.clock_ns = monotonic_ns ();
+    frame.position_us = position_us;
+
+    if (channels)
+    {
+        memcpy (frame.mono, mono, sizeof frame.mono);
+        memcpy (frame.freq, freq, sizeof frame.freq);
+        memcpy (frame.pcm, pcm, sizeof (float) * channels * AUD_VIS_SHM_FRAMES);
+    }
+
+    __atomic_store_n (& frame.sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n (& shm->write_count, index + 1, __ATOMIC_RELEASE);
+}
+
+/* vis_send_audio() calls render_mono_pcm(), render_multi_pcm(), and then
+ * render_freq() with the same result, which stays in place until the last
+ * call; so the data is only copied once, into shared memory */
+class VisExporter : public Visualizer
+{
+public:
+    constexpr VisExporter () :
+        Visualizer (MonoPCM | MultiPCM | Freq) {}
+
+    void clear ()
+        { vis_export_publish (nullptr, 0, nullptr, nullptr, aud_drct_get_time_us ()); }
+
+    void render_mono_pcm (const float * pcm)
+        { m_mono = pcm; }
+
+    void render_multi_pcm (const float * pcm, int channels)
+    {
+        m_pcm = pcm;
+        m_channels = channels;
+    }
+
+    void render_freq (const float * freq)
+    {
+        if (m_mono && m_pcm)
+            vis_export_publish (m_pcm, m_channels, m_mono, freq, aud_drct_get_time_us ());
+
+        m_mono = m_pcm = nullptr;
+    }
+
+private:
+    const float * m_mono = nullptr;
+    const float * m_pcm = nullptr;
+    int m_channels = 0;
+};
+
+static VisExporter exporter;
+static bool exporting;
+
+static void vis_export_update (void * = nullptr, void * = nullptr)
+{
+    if (exporting)
+    {
+        aud_visualizer_remove (& exporter);
+        vis_export_close ();
+        exporting = false;
+    }
+
+    /* by default, each instance has its own name, as on D-Bus */
+    String setting = aud_get_str ("vis_export_name");
+    int instance = aud_get_instance ();
+
+    StringBuf name = setting[0] ? str_copy (setting) : (instance == 1) ?
+     str_copy (AUD_VIS_SHM_DEFAULT_NAME) :
+     str_printf (AUD_VIS_SHM_DEFAULT_NAME "-%d", instance);
+
+    if (aud_get_bool ("vis_export") && vis_export_open (name))
+    {
+        aud_visualizer_add (& exporter);
+        exporting = true;
+    }
+}
+
+void vis_export_init ()
+{
+    vis_export_update ();
+    hook_associate ("set vis_export", vis_export_update, nullptr);
+    hook_associate ("set vis_export_name", vis_export_update, nullptr);
+}
+
+void vis_export_cleanup ()
+{
+    hook_dissociate ("set vis_export", vis_export_update);
+    hook_dissociate ("set vis_export_name", vis_export_update);
+
+    if (exporting)
+    {
+        aud_visualizer_remove (& exporter);
+        exporting = false;
+    }
+
+    vis_export_close ();
+}
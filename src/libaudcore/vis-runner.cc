@@ -1,6 +1,7 @@
 /*
  * vis_runner.c
  * Copyright 2009-2012 John Lindgren
+ * Copyright 2026 Audacious developers
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are met:
@@ -19,80 +20,194 @@
 
 #include "internal.h"
 
-#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#include <thread>
+
+#include "audio.h"
 #include "hook.h"
-#include "list.h"
 #include "mainloop.h"
 #include "output.h"
+#include "spsc-ring.h"
 #include "threads.h"
 
+/* The audio thread, the analysis thread, and the main thread are decoupled:
+ *  - The audio thread cuts a 512-frame "node" out of the signal every 33 ms of
+ *    audio and queues it, timestamped, in a lock-free history ring.
+ *  - The analysis thread wakes up at the same rate, picks the node that is due
+ *    to be heard next (using the lock-free playback clock in output.cc), and
+ *    does the mono downmix and FFT.  The results are handed to the main thread
+ *    through a lock-free triple buffer.
+ *  - The main thread only passes the latest results on to the visualizers.
+ * Flushing increments a serial number instead of touching the other threads'
+ * state directly; each thread discards its own stale data when it notices. */
+
 #define INTERVAL 33 /* milliseconds */
 #define FRAMES_PER_NODE 512
+#define HISTORY_SIZE (1 << 19) /* bytes */
 
-struct VisNode : public ListNode
-{
-    VisNode (int channels, int time) :
-        channels (channels),
-        time (time),
-        data (new float[channels * FRAMES_PER_NODE]) {}
-
-    ~VisNode ()
-        { delete[] data; }
+struct VisNode {
+    int time, channels;
+    float data[AUD_MAX_CHANNELS * FRAMES_PER_NODE];
+};
 
-    const int channels;
-    int time;
-    float * data;
+struct VisResult {
+    int time, channels, serial;
+    float pcm[AUD_MAX_CHANNELS * FRAMES_PER_NODE];
+    float mono[FRAMES_PER_NODE];
+    float freq[FRAMES_PER_NODE / 2];
 };
 
+#define FRESH 4
+
+/* control state, protected by mutex */
 static aud::mutex mutex;
+static aud::condvar cond;
 static bool enabled = false;
 static bool playing = false, paused = false;
-static VisNode * current_node = nullptr;
-static int current_frames;
-static List<VisNode> vis_list;
-static List<VisNode> vis_pool;
+static std::thread worker;
+static bool worker_quit;
 static QueuedFunc queued_clear;
 
-static void send_audio (void *)
+/* shared state, accessed atomically */
+static bool active;      /* enabled and playing */
+static bool running;     /* enabled, playing, and not paused */
+static int flush_serial;
+static SPSCRing history; /* audio thread -> analysis thread */
+static VisResult results[3];
+static int middle_result = 1; /* index and FRESH flag */
+
+/* audio thread state; vis_runner_pass_audio() is called only by output.cc,
+ * which serializes the calls */
+static VisNode building;
+static int building_frames = -1; /* -1 if no node is being built */
+static int building_serial;
+static int last_node_time;
+static bool have_last_node;
+
+/* analysis thread state */
+static VisNode pending, current;
+static bool pending_valid;
+static int worker_serial;
+static int back_result = 0;
+
+/* main thread state */
+static int front_result = 2;
+
+static int node_size (int channels)
 {
-    /* call before locking mutex to avoid deadlock */
-    int outputted = output_get_raw_time ();
+    return offsetof (VisNode, data) + sizeof (float) * channels * FRAMES_PER_NODE;
+}
 
-    auto mh = mutex.take ();
+static bool read_node (VisNode & node, int serial)
+{
+    int header = offsetof (VisNode, data);
+    if (history.len () < header)
+        return false;
 
-    if (! enabled || ! playing || paused)
-        return;
+    bool valid = (history.read (& node, header) == header &&
+     node.channels >= 1 && node.channels <= AUD_MAX_CHANNELS);
 
-    VisNode * node = nullptr;
-    VisNode * next;
+    if (valid)
+    {
+        int size = node_size (node.channels) - header;
+        valid = (history.read (node.data, size) == size);
+    }
 
-    while ((next = vis_list.head ()))
+    /* A flush may have discarded the history while we were in the middle of a
+     * node, leaving us out of step with the node boundaries.  The flush serial
+     * is incremented before the history is discarded, so we can detect that
+     * case here and skip ahead to the next boundary (each node is written in
+     * one piece, so the write position is always at a boundary). */
+    if (__atomic_load_n (& flush_serial, __ATOMIC_ACQUIRE) != serial)
+    {
+        history.discard ();
+        return false;
+    }
+
+    return valid;
+}
+
+static void analyze ()
+{
+    int serial = __atomic_load_n (& flush_serial, __ATOMIC_ACQUIRE);
+    if (serial != worker_serial)
+    {
+        worker_serial = serial;
+        pending_valid = false;
+    }
+
+    /* look ahead by one interval, since the main thread will display the
+     * result on its next timer tick */
+    int outputted = output_get_raw_time () + INTERVAL;
+    bool found = false;
+
+    while (pending_valid || (pending_valid = read_node (pending, serial)))
     {
         /* If we are considering a node, stop searching and use it if it is the
          * most recent (that is, the next one is in the future).  Otherwise,
          * consider the next node if it is not in the future by more than the
          * length of an interval. */
-        if (next->time > outputted + (node ? 0 : INTERVAL))
+        if (pending.time > outputted + (found ? 0 : INTERVAL))
             break;
 
-        if (node)
-            vis_pool.prepend (node);
+        current.time = pending.time;
+        current.channels = pending.channels;
+        memcpy (current.data, pending.data, sizeof (float) *
+         pending.channels * FRAMES_PER_NODE);
 
-        node = next;
-        vis_list.remove (node);
+        pending_valid = false;
+        found = true;
     }
 
-    if (! node)
+    if (! found)
         return;
 
-    mh.unlock ();
-    vis_send_audio (node->data, node->channels);
-    mh.lock ();
+    VisResult & result = results[back_result];
+
+    result.time = current.time;
+    result.channels = current.channels;
+    result.serial = serial;
+
+    memcpy (result.pcm, current.data, sizeof (float) * current.channels * FRAMES_PER_NODE);
+    vis_analyze (current.data, current.channels, result.mono, result.freq);
+
+    back_result = __atomic_exchange_n (& middle_result, back_result | FRESH,
+     __ATOMIC_ACQ_REL) & ~FRESH;
+}
 
-    vis_pool.prepend (node);
+static void worker_thread ()
+{
+    auto mh = mutex.take ();
+
+    while (! worker_quit)
+    {
+        cond.wait_for (mh, std::chrono::milliseconds (INTERVAL));
+
+        if (worker_quit || ! __atomic_load_n (& running, __ATOMIC_ACQUIRE))
+            continue;
+
+        mh.unlock ();
+        analyze ();
+        mh.lock ();
+    }
+}
+
+static void send_audio (void *)
+{
+    if (! (__atomic_load_n (& middle_result, __ATOMIC_ACQUIRE) & FRESH))
+        return;
+
+    front_result = __atomic_exchange_n (& middle_result, front_result,
+     __ATOMIC_ACQ_REL) & ~FRESH;
+
+    const VisResult & result = results[front_result];
+    if (result.serial != __atomic_load_n (& flush_serial, __ATOMIC_ACQUIRE))
+        return;
+
+    vis_send_audio (result.pcm, result.channels, result.mono, result.freq);
 }
 
 static void send_clear (void *)
@@ -102,11 +217,8 @@ static void send_clear (void *)
 
 static void flush (aud::mutex::holder &)
 {
-    delete current_node;
-    current_node = nullptr;
-
-    vis_list.clear ();
-    vis_pool.clear ();
+    __atomic_add_fetch (& flush_serial, 1, __ATOMIC_ACQ_REL);
+    history.discard ();
 
     if (enabled)
         queued_clear.queue (send_clear, nullptr);
@@ -128,6 +240,9 @@ static void start_stop (aud::mutex::holder & mh, bool new_playing, bool new_paus
     if (! enabled || ! playing)
         flush (mh);
 
+    __atomic_store_n (& active, enabled && playing, __ATOMIC_RELEASE);
+    __atomic_store_n (& running, enabled && playing && ! paused, __ATOMIC_RELEASE);
+
     if (enabled && playing && ! paused)
         timer_add (TimerRate::Hz30, send_audio);
     else
@@ -142,35 +257,39 @@ void vis_runner_start_stop (bool new_playing, bool new_paused)
 
 void vis_runner_pass_audio (int time, const Index<float> & data, int channels, int rate)
 {
-    auto mh = mutex.take ();
-
-    if (! enabled || ! playing)
+    if (! __atomic_load_n (& active, __ATOMIC_ACQUIRE))
         return;
 
+    /* drop the partly-built node after a flush or a change of format */
+    int serial = __atomic_load_n (& flush_serial, __ATOMIC_ACQUIRE);
+    if (serial != building_serial || (building_frames >= 0 && building.channels != channels))
+    {
+        building_serial = serial;
+        building_frames = -1;
+        have_last_node = false;
+    }
+
     /* We can build a single node from multiple calls; we can also build
-     * multiple nodes from the same call.  If current_node is present, it was
+     * multiple nodes from the same call.  If a node is being built, it was
      * partly built in the last call and needs to be finished. */
 
     int at = 0;
 
     while (1)
     {
-        if (current_node)
-            assert (current_node->channels == channels);
-        else
+        if (building_frames < 0)
         {
             int node_time = time;
 
             /* There is no partly-built node, so start a new one.  Normally
-             * there will be nodes in the queue already; if so, we want to copy
-             * audio data from the signal starting at 30 milliseconds after the
-             * beginning of the most recent node.  If there are no nodes in the
-             * queue, we are at the beginning of the song or had an underrun,
-             * and we want to copy the earliest audio data we have. */
+             * there will be nodes queued already; if so, we want to copy audio
+             * data from the signal starting at 30 milliseconds after the
+             * beginning of the most recent node.  If there are no nodes, we
+             * are at the beginning of the song or had an underrun, and we want
+             * to copy the earliest audio data we have. */
 
-            VisNode * tail = vis_list.tail ();
-            if (tail)
-                node_time = tail->time + INTERVAL;
+            if (have_last_node)
+                node_time = last_node_time + INTERVAL;
 
             at = channels * (int) ((int64_t) (node_time - time) * rate / 1000);
 
@@ -179,18 +298,9 @@ void vis_runner_pass_audio (int time, const Index<float> & data, int channels, i
             if (at >= data.len ())
                 break;
 
-            current_node = vis_pool.head ();
-
-            if (current_node)
-            {
-                assert (current_node->channels == channels);
-                vis_pool.remove (current_node);
-                current_node->time = node_time;
-            }
-            else
-                current_node = new VisNode (channels, node_time);
-
-            current_frames = 0;
+            building.time = node_time;
+            building.channels = channels;
+            building_frames = 0;
         }
 
         /* Copy as much data as we can, limited by how much we have and how much
@@ -198,21 +308,63 @@ void vis_runner_pass_audio (int time, const Index<float> & data, int channels, i
          * wait for more data to be passed in the next call.  If we do fill the
          * node, we loop and start building a new one. */
 
-        int copy = aud::min (data.len () - at, channels * (FRAMES_PER_NODE - current_frames));
-        memcpy (current_node->data + channels * current_frames, & data[at], sizeof (float) * copy);
-        current_frames += copy / channels;
+        int copy = aud::min (data.len () - at, channels * (FRAMES_PER_NODE - building_frames));
+        memcpy (building.data + channels * building_frames, & data[at], sizeof (float) * copy);
+        building_frames += copy / channels;
+        at += copy;
 
-        if (current_frames < FRAMES_PER_NODE)
+        if (building_frames < FRAMES_PER_NODE)
             break;
 
-        vis_list.append (current_node);
-        current_node = nullptr;
+        /* if the analysis thread has fallen far behind, skip this node */
+        int size = node_size (channels);
+        if (history.space () >= size)
+            history.write (& building, size);
+
+        last_node_time = building.time;
+        have_last_node = true;
+        building_frames = -1;
     }
 }
 
+static void stop_worker (aud::mutex::holder & mh)
+{
+    worker_quit = true;
+    cond.notify_all ();
+
+    mh.unlock ();
+    worker.join ();
+    mh.lock ();
+}
+
 void vis_runner_enable (bool enable)
 {
     auto mh = mutex.take ();
+
+    if (enable && ! history.size ())
+        history.alloc (HISTORY_SIZE);
+
     enabled = enable;
     start_stop (mh, playing, paused);
+
+    if (enable && ! worker.joinable ())
+    {
+        worker_quit = false;
+        worker = std::thread (worker_thread);
+    }
+    else if (! enable && worker.joinable ())
+        stop_worker (mh);
+}
+
+void vis_runner_cleanup ()
+{
+    auto mh = mutex.take ();
+
+    if (worker.joinable ())
+        stop_worker (mh);
+
+    /* the output has been shut down, so nothing can write to the history */
+    enabled = false;
+    start_stop (mh, false, false);
+    history.destroy ();
 }
@@ -0,0 +1,83 @@
+/*
+ * vis-shm.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBAUDCORE_VIS_SHM_H
+#define LIBAUDCORE_VIS_SHM_H
+
+/* Layout of the shared memory written by the visualization exporter (enabled
+ * with the "vis_export" setting).  This header is plain C so that external
+ * programs can include it.
+ *
+ * The shared memory object is named by the "vis_export_name" setting, or if
+ * that is empty, AUD_VIS_SHM_DEFAULT_NAME for the first instance of Audacious
+ * and AUD_VIS_SHM_DEFAULT_NAME "-<n>" for instance <n>.  An object left over
+ * from an earlier run is reused if it is compatible, and write_count keeps
+ * increasing from where it was, so readers never see it go backwards.
+ *
+ * The object holds a header followed by a ring of frames.  Each frame is
+ * guarded by its own sequence lock:
+ *  - The writer makes the sequence number odd, fills in the frame, makes the
+ *    sequence number even again, and then advances write_count.
+ *  - A reader loads write_count, picks frame (write_count - 1) % slots, and
+ *    copies it out between two loads of the sequence number.  The copy is good
+ *    if the sequence number was even and did not change, and the frame's index
+ *    is the one expected (otherwise the writer has lapped the reader).
+ * Readers only need to map the object read-only; no system calls or locks are
+ * involved after that, and the writer never waits for any reader.
+ *
+ * A frame with zero channels means that the display should be cleared (for
+ * example, because playback has stopped or the song has changed). */
+
+#include <stdint.h>
+
+#define AUD_VIS_SHM_DEFAULT_NAME "/audacious-vis"
+#define AUD_VIS_SHM_MAGIC 0x53495641 /* "AVIS" */
+#define AUD_VIS_SHM_VERSION 1
+
+#define AUD_VIS_SHM_SLOTS 16
+#define AUD_VIS_SHM_MAX_CHANNELS 10 /* same as AUD_MAX_CHANNELS */
+#define AUD_VIS_SHM_FRAMES 512
+#define AUD_VIS_SHM_BANDS 256
+
+struct AudVisShmFrame {
+    uint32_t sequence;   /* odd while the frame is being written */
+    int32_t channels;    /* 0 for a "clear" frame */
+    uint64_t index;      /* number of frames written before this one */
+    int64_t clock_ns;    /* CLOCK_MONOTONIC time when the frame was written */
+    int64_t position_us; /* playback position of the audio */
+
+    /* 512 frames of mono and interleaved multi-channel audio, and intensity of
+     * frequencies 1/512, 2/512, ..., 256/512 of the sample rate, as passed to
+     * Visualizer::render_mono_pcm(), render_multi_pcm(), and render_freq() */
+    float mono[AUD_VIS_SHM_FRAMES];
+    float freq[AUD_VIS_SHM_BANDS];
+    float pcm[AUD_VIS_SHM_MAX_CHANNELS * AUD_VIS_SHM_FRAMES];
+};
+
+struct AudVisShm {
+    uint32_t magic;       /* AUD_VIS_SHM_MAGIC */
+    uint32_t version;     /* AUD_VIS_SHM_VERSION */
+    uint32_t slots;       /* AUD_VIS_SHM_SLOTS */
+    uint32_t frame_size;  /* sizeof (struct AudVisShmFrame) */
+    uint64_t write_count; /* frames written so far */
+
+    struct AudVisShmFrame frames[AUD_VIS_SHM_SLOTS];
+};
+
+#endif /* LIBAUDCORE_VIS_SHM_H */
@@ -75,33 +75,25 @@ static void pcm_to_mono (const float * data, float * mono, int channels)
         float * set = mono;
         while (set < & mono[512])
         {
-            * set ++ = (data[0] + data[1]) / 2;
+            float sum = 0;
+            for (int c = 0; c < channels; c ++)
+                sum += data[c];
+
+            * set ++ = sum / channels;
             data += channels;
         }
     }
 }
 
-void vis_send_audio (const float * data, int channels)
+/* called from the vis-runner analysis thread */
+void vis_analyze (const float * data, int channels, float mono[512], float freq[256])
 {
-    auto is_active = [] (int type_mask)
-    {
-        for (Visualizer * vis : visualizers)
-        {
-            if ((vis->type_mask & type_mask))
-                return true;
-        }
-
-        return false;
-    };
-
-    float mono[512];
-    float freq[256];
-
-    if (is_active (Visualizer::MonoPCM | Visualizer::Freq))
-        pcm_to_mono (data, mono, channels);
-    if (is_active (Visualizer::Freq))
-        calc_freq (mono, freq);
+    pcm_to_mono (data, mono, channels);
+    calc_freq (mono, freq);
+}
 
+void vis_send_audio (const float * data, int channels, const float * mono, const float * freq)
+{
     for (Visualizer * vis : visualizers)
     {
         if ((vis->type_mask & Visualizer::MonoPCM))
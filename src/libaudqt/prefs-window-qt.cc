@@ -211,7 +211,8 @@ static const PreferencesWidget appearance_page_widgets[] = {
     WidgetCustomQt (iface_create_prefs_box)
 };
 
-static void output_bit_depth_changed ();
+static void output_reopen ();
+static void effects_reset ();
 
 static const PreferencesWidget output_combo_widgets[] = {
     WidgetCombo (N_("Output plugin:"),
@@ -241,11 +242,41 @@ static const PreferencesWidget audio_page_widgets[] = {
     WidgetLabel (N_("<b>Output Settings</b>")),
     WidgetBox ({{output_combo_widgets}, true}),
     WidgetCombo (N_("Bit depth:"),
-        WidgetInt (0, "output_bit_depth", output_bit_depth_changed),
+        WidgetInt (0, "output_bit_depth", output_reopen),
         {{bitdepth_elements}}),
     WidgetSpin (N_("Buffer size:"),
         WidgetInt (0, "output_buffer_size"),
         {100, 10000, 1000, N_("ms")}),
+    WidgetCheck (N_("Decode ahead in a separate output thread"),
+        WidgetBool (0, "output_thread", output_reopen)),
+    WidgetSpin (N_("Decode-ahead buffer:"),
+        WidgetInt (0, "output_thread_buffer"),
+        {100, 10000, 1000, N_("ms")},
+        WIDGET_CHILD),
+    WidgetCheck (N_("Enlarge the buffer after underruns"),
+        WidgetBool (0, "output_buffer_adaptive"),
+        WIDGET_CHILD),
+    WidgetCheck (N_("Use real-time priority for audio threads"),
+        WidgetBool (0, "realtime_audio")),
+    WidgetSpin (N_("Priority:"),
+        WidgetInt (0, "realtime_priority"),
+        {1, 99, 1},
+        WIDGET_CHILD),
+    WidgetCheck (N_("Keep the output open at a fixed format"),
+        WidgetBool (0, "output_fixed_format", output_reopen)),
+    WidgetSpin (N_("Sample rate:"),
+        WidgetInt (0, "output_fixed_rate", output_reopen),
+        {8000, 384000, 50, N_("Hz")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Channels:"),
+        WidgetInt (0, "output_fixed_channels", output_reopen),
+        {1, 10, 1},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Seek-back cache:"),
+        WidgetInt (0, "seek_cache_size"),
+        {0, 262144, 1024, N_("KiB")}),
+    WidgetCheck (N_("Run effects in parallel threads"),
+        WidgetBool (0, "effect_threads", effects_reset)),
     WidgetCheck (N_("Soft clipping"),
         WidgetBool (0, "soft_clipping")),
     WidgetCheck (N_("Use software volume control (not recommended)"),
@@ -553,11 +584,16 @@ static void * iface_create_prefs_box ()
     return iface_prefs_box;
 }
 
-static void output_bit_depth_changed ()
+static void output_reopen ()
 {
     aud_output_reset (OutputReset::ReopenStream);
 }
 
+static void effects_reset ()
+{
+    aud_output_reset (OutputReset::EffectsOnly);
+}
+
 static void create_category (QStackedWidget * notebook, ArrayRef<PreferencesWidget> widgets)
 {
     QWidget * w = new QWidget;